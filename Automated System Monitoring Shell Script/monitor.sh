@@ -4,17 +4,37 @@
 CPU_LIMIT=80
 MEM_LIMIT=80
 DISK_LIMIT=80
+IO_LIMIT=90         # busiest disk's utilization, %
+PRESSURE_LIMIT=20   # % of time tasks stall on CPU, memory or I/O
+NET_LIMIT=0         # received + sent kB/s, 0 = no alert
+
+# with the sampler, an alert needs its smoothed value over the limit for
+# ALERT_SUSTAIN seconds and clears ALERT_HYSTERESIS below it
+ALERT_SUSTAIN=30
+ALERT_HYSTERESIS=5
+DISK_FULL_SECS=3600 # alert when the disk will be full within this time
 
 # log file
 LOG_FILE="system_log.txt"
 
+# binary sample history kept by the sampler (1 s / 1 min / 1 h rollups)
+HISTORY_DIR="history"
+
+# shared memory the sampler publishes live values in while auto or fast
+# monitor runs (read them with ./monread, build: gcc -O2 monread.c -o monread)
+SHM_NAME="/system-monitor"
+
+# native sampler next to this script (build: gcc -O2 sampler.c -o sampler)
+# without it the script falls back to top, free and df
+SAMPLER="$(dirname "$0")/sampler"
+
 # check if log file exists
 if [ ! -f "$LOG_FILE" ]; then
     touch "$LOG_FILE"
 fi
 
-# function to get system status
-get_status() {
+# function to sample with the old command pipeline (about ten processes)
+pipeline_sample() {
     # get CPU %
     CPU=$(top -bn1 | grep "Cpu(s)" | awk '{print $2 + $4}' | cut -d'.' -f1)
 
@@ -23,10 +43,33 @@ get_status() {
 
     # get disk %
     DISK=$(df / | awk 'NR==2 {print $5}' | sed 's/%//')
+}
+
+# function to read one sample into CPU, MEM and DISK
+read_sample() {
+    if [ -x "$SAMPLER" ]; then
+        eval "$("$SAMPLER")"
+    else
+        pipeline_sample
+    fi
+}
+
+# function to get system status
+get_status() {
+    read_sample
 
     echo "CPU: $CPU%"
     echo "Memory: $MEM%"
     echo "Disk: $DISK%"
+
+    # only the sampler measures rates
+    if [ -n "$IO" ]; then
+        echo "Disk I/O: $IO% busy, read $IO_READ kB/s, write $IO_WRITE kB/s"
+        echo "Network: received $NET_RX kB/s, sent $NET_TX kB/s"
+    fi
+    if [ -n "$PSI_CPU" ]; then
+        echo "Pressure: CPU $PSI_CPU%, memory $PSI_MEM%, I/O $PSI_IO%"
+    fi
 }
 
 # function to log activity
@@ -34,10 +77,66 @@ log_status() {
     echo "$(date): CPU:$CPU% MEM:$MEM% DISK:$DISK%" >> "$LOG_FILE"
 }
 
+# function to build the sampler's alert rules from the current thresholds
+alert_args() {
+    ALERT_ARGS=(--alert "CPU:$CPU_LIMIT" --alert "MEM:$MEM_LIMIT" --alert "DISK:$DISK_LIMIT"
+                --alert "IO:$IO_LIMIT" --alert "PSI_CPU:$PRESSURE_LIMIT" --alert "PSI_MEM:$PRESSURE_LIMIT"
+                --alert "PSI_IO:$PRESSURE_LIMIT" --alert "DISK_FULL:$DISK_FULL_SECS"
+                --sustain "$ALERT_SUSTAIN" --hysteresis "$ALERT_HYSTERESIS")
+    if [ "$NET_LIMIT" -gt 0 ]; then
+        ALERT_ARGS+=(--alert "NET_KBS:$NET_LIMIT")
+    fi
+}
+
+# function to describe one sampler alert: alert_text NAME VALUE raised|cleared
+alert_text() {
+    if [ "$1" = "DISK_FULL" ]; then
+        if [ "$3" = "raised" ]; then
+            echo "Disk will be full in $(( ${2%.*} / 60 )) min (filling at $DISK_RATE%/h)"
+        else
+            echo "Disk is no longer filling fast"
+        fi
+        return
+    fi
+
+    case $1 in
+        CPU)     what="CPU";             detail="$2%${TOP:+, top process ${TOP%%,*}}" ;;
+        MEM)     what="Memory usage";    detail="$2%" ;;
+        DISK)    what="Disk usage";      detail="$2%" ;;
+        IO)      what="Disk I/O";        detail="$2% busy" ;;
+        NET_KBS) what="Network traffic"; detail="$2 kB/s" ;;
+        PSI_CPU) what="CPU pressure";    detail="$2% stalled" ;;
+        PSI_MEM) what="Memory pressure"; detail="$2% stalled" ;;
+        PSI_IO)  what="I/O pressure";    detail="$2% stalled" ;;
+        *)       what="$1";              detail="$2" ;;
+    esac
+    if [ "$3" = "raised" ]; then
+        echo "$what is high ($detail)"
+    else
+        echo "$what is back to normal ($detail)"
+    fi
+}
+
 # function to check alerts
 check_alerts() {
+    # the sampler evaluates the rules itself and reports only changes
+    if [ -n "${FIRING+set}" ]; then
+        for item in ${RAISED//,/ }; do
+            echo "ALERT: $(alert_text "${item%%:*}" "${item#*:}" raised)" | tee -a "$LOG_FILE"
+        done
+        for item in ${CLEARED//,/ }; do
+            echo "RECOVERED: $(alert_text "${item%%:*}" "${item#*:}" cleared)" | tee -a "$LOG_FILE"
+        done
+        return
+    fi
+
     if [ "$CPU" -ge "$CPU_LIMIT" ]; then
-        echo "ALERT: CPU is high ($CPU%)" | tee -a "$LOG_FILE"
+        # fast monitor knows the busiest process (pid:name:cpu%:rssKB)
+        if [ -n "$TOP" ]; then
+            echo "ALERT: CPU is high ($CPU%), top process ${TOP%%,*}" | tee -a "$LOG_FILE"
+        else
+            echo "ALERT: CPU is high ($CPU%)" | tee -a "$LOG_FILE"
+        fi
     fi
 
     if [ "$MEM" -ge "$MEM_LIMIT" ]; then
@@ -47,15 +146,46 @@ check_alerts() {
     if [ "$DISK" -ge "$DISK_LIMIT" ]; then
         echo "ALERT: Disk usage is high ($DISK%)" | tee -a "$LOG_FILE"
     fi
+
+    # I/O, network and pressure come from the sampler only
+    if [ -n "$IO" ] && [ "$IO" -ge "$IO_LIMIT" ]; then
+        echo "ALERT: Disk I/O is saturated ($IO% busy, $DISKS)" | tee -a "$LOG_FILE"
+    fi
+
+    if [ -n "$NET_RX" ] && [ "$NET_LIMIT" -gt 0 ] && [ $((NET_RX + NET_TX)) -ge "$NET_LIMIT" ]; then
+        echo "ALERT: Network traffic is high ($NET_RX kB/s in, $NET_TX kB/s out)" | tee -a "$LOG_FILE"
+    fi
+
+    if [ -n "$PSI_CPU" ] && [ "$PSI_CPU" -ge "$PRESSURE_LIMIT" ]; then
+        echo "ALERT: CPU pressure is high (tasks waiting $PSI_CPU% of the time)" | tee -a "$LOG_FILE"
+    fi
+
+    if [ -n "$PSI_MEM" ] && [ "$PSI_MEM" -ge "$PRESSURE_LIMIT" ]; then
+        echo "ALERT: Memory pressure is high (tasks stalled $PSI_MEM% of the time)" | tee -a "$LOG_FILE"
+    fi
+
+    if [ -n "$PSI_IO" ] && [ "$PSI_IO" -ge "$PRESSURE_LIMIT" ]; then
+        echo "ALERT: I/O pressure is high (tasks stalled $PSI_IO% of the time)" | tee -a "$LOG_FILE"
+    fi
 }
 
 # function for periodic monitoring
 auto_monitor() {
     echo "Auto-monitoring every 5 seconds. Press Ctrl+C to stop."
+
+    # one long-lived sampler: no processes forked per tick
+    # samples go to the binary history, only alerts to the text log
+    if [ -x "$SAMPLER" ]; then
+        alert_args
+        "$SAMPLER" --stream --interval 5000 --store "$HISTORY_DIR" --shm "$SHM_NAME" "${ALERT_ARGS[@]}" | while read -r line; do
+            eval "$line"
+            check_alerts
+        done
+        return
+    fi
+
     while true; do
-        CPU=$(top -bn1 | grep "Cpu(s)" | awk '{print $2 + $4}' | cut -d'.' -f1)
-        MEM=$(free | awk '/Mem/ {printf "%.0f", $3/$2 * 100}')
-        DISK=$(df / | awk 'NR==2 {print $5}' | sed 's/%//')
+        pipeline_sample
 
         log_status
         check_alerts
@@ -63,6 +193,82 @@ auto_monitor() {
     done
 }
 
+# function for sub-second monitoring: per-core CPU and the busiest processes
+# only alerts go to the log, a line every 250 ms would flood it
+fast_monitor() {
+    if [ ! -x "$SAMPLER" ]; then
+        echo "Fast monitor needs the sampler, build it with: gcc -O2 sampler.c -o sampler"
+        return
+    fi
+    echo "Fast monitoring every 250 ms. Press Ctrl+C to stop."
+
+    # the sampler slows itself down if it would use more than 2% of a core
+    alert_args
+    "$SAMPLER" --stream --interval 250 --cores --top 5 --budget 2 --shm "$SHM_NAME" "${ALERT_ARGS[@]}" | while read -r line; do
+        eval "$line"
+        echo "CPU:$CPU% MEM:$MEM% cores:[$CORES] sampler:$SELF_CPU% every ${INTERVAL_MS}ms"
+        echo "  top: ${TOP//,/  }"
+        check_alerts
+    done
+}
+
+# function to print min/avg/max from the history: show_history FROM [TO] [LABEL]
+# FROM and TO are epoch seconds, or negative for seconds ago
+show_history() {
+    eval "$("$SAMPLER" --query "$HISTORY_DIR" --from "$1" --to "${2:-0}")"
+    if [ "$SAMPLES" = "0" ]; then
+        echo "${3:-Range}: no samples"
+        return
+    fi
+    echo "${3:-Range} ($SAMPLES samples, $TIER rollups):"
+    echo "  CPU:    min $CPU_MIN%  avg $CPU_AVG%  max $CPU_MAX%"
+    echo "  Memory: min $MEM_MIN%  avg $MEM_AVG%  max $MEM_MAX%"
+    echo "  Disk:   min $DISK_MIN%  avg $DISK_AVG%  max $DISK_MAX%"
+    echo "  Disk I/O: max $IO_MAX% busy, avg $IO_KBS_AVG kB/s, max $IO_KBS_MAX kB/s"
+    echo "  Network:  avg $NET_KBS_AVG kB/s, max $NET_KBS_MAX kB/s"
+    echo "  Pressure: max CPU $PSI_CPU_MAX%  memory $PSI_MEM_MAX%  I/O $PSI_IO_MAX%"
+}
+
+# function to view logs: history summaries, then the latest alerts
+view_logs() {
+    if [ -x "$SAMPLER" ] && [ -d "$HISTORY_DIR" ]; then
+        show_history -3600 0 "Last hour"
+        show_history -86400 0 "Last day"
+        show_history -604800 0 "Last week"
+        echo "Latest log entries:"
+        tail -n 20 "$LOG_FILE"
+    else
+        cat "$LOG_FILE"
+    fi
+}
+
+# function to compare sampling cost: ./monitor.sh --bench [samples]
+bench_sampling() {
+    N=${1:-20}
+
+    start=$(date +%s%N)
+    for ((i = 0; i < N; i++)); do
+        pipeline_sample
+    done
+    end=$(date +%s%N)
+    echo "top/free/df pipeline: $(( (end - start) / N / 1000 )) us per sample"
+
+    if [ ! -x "$SAMPLER" ]; then
+        echo "No sampler binary, build it with: gcc -O2 sampler.c -o sampler"
+        return
+    fi
+
+    start=$(date +%s%N)
+    for ((i = 0; i < N; i++)); do
+        eval "$("$SAMPLER" --interval 0)"
+    done
+    end=$(date +%s%N)
+    echo "sampler, one process per sample: $(( (end - start) / N / 1000 )) us per sample"
+
+    echo -n "sampler, streaming (in-process): "
+    "$SAMPLER" --bench 1000
+}
+
 # function to set new thresholds
 set_thresholds() {
     echo "Enter new CPU limit:"
@@ -71,10 +277,27 @@ set_thresholds() {
     read MEM_LIMIT
     echo "Enter new Disk limit:"
     read DISK_LIMIT
+    echo "Enter new Disk I/O limit (% busy):"
+    read IO_LIMIT
+    echo "Enter new Pressure limit (% stalled):"
+    read PRESSURE_LIMIT
+    echo "Enter new Network limit (kB/s, 0 = off):"
+    read NET_LIMIT
 
     echo "Thresholds updated."
 }
 
+if [ "$1" = "--bench" ]; then
+    bench_sampling "$2"
+    exit 0
+fi
+
+# ./monitor.sh --query FROM [TO]: min/avg/max from the history
+if [ "$1" = "--query" ]; then
+    show_history "${2:--3600}" "${3:-0}"
+    exit 0
+fi
+
 # main menu loop
 while true; do
     echo "====================="
@@ -85,7 +308,8 @@ while true; do
     echo "3. View Logs"
     echo "4. Clear Logs"
     echo "5. Auto Monitor"
-    echo "6. Exit"
+    echo "6. Fast Monitor (per-core, top processes)"
+    echo "7. Exit"
     echo "Choose an option:"
     read choice
 
@@ -97,16 +321,20 @@ while true; do
             set_thresholds
             ;;
         3)
-            cat "$LOG_FILE"
+            view_logs
             ;;
         4)
             > "$LOG_FILE"
+            rm -rf "$HISTORY_DIR"
             echo "Logs cleared."
             ;;
         5)
             auto_monitor
             ;;
         6)
+            fast_monitor
+            ;;
+        7)
             echo "Exiting."
             exit 0
             ;;
@@ -0,0 +1,177 @@
+// Shared-memory export of the sampler's latest values.
+//
+// ./sampler --stream --shm [NAME] keeps one POSIX shared memory object
+// (/dev/shm/system-monitor by default) up to date with every sample it
+// takes: the newest SHM_HISTORY samples, rolling 1/5/15 minute averages
+// and the min/max over the samples kept. Any number of local processes can
+// map it read-only and read the values without locks or system calls.
+//
+// The sampler is the only writer and guards each update with a sequence
+// counter (seqlock): it makes seq odd, writes, then makes it even again.
+// A reader copies what it needs between two reads of seq and retries if
+// seq was odd or changed, so it never sees half an update and never makes
+// the writer wait. A writer killed in the middle of an update leaves seq
+// odd; readers notice it is gone (or stuck for SHM_GIVE_UP_NS) and return
+// SHM_WRITER_GONE instead of spinning forever.
+//
+// Readers include this header and use shm_attach() once, then
+// shm_snapshot() / shm_recent() as often as they like (see monread.c).
+
+#ifndef MONITOR_SHM_H
+#define MONITOR_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SHM_DEFAULT_NAME "/system-monitor"
+#define SHM_MAGIC 0x314e4f4d        // "MON1"
+#define SHM_VERSION 1
+#define SHM_MAX_METRICS 16
+#define SHM_HISTORY 64              // newest samples kept
+#define SHM_WINDOWS 3               // rolling averages
+#define SHM_SPIN_CHECK 1024         // reader retries between checks on the writer
+#define SHM_GIVE_UP_NS 100000000LL  // no update takes this long: the writer died in one
+#define SHM_WRITER_GONE (-2)
+
+static const int shm_window_secs[SHM_WINDOWS] = {60, 300, 900};
+
+typedef struct {
+    int64_t wall_ms;                // sample time, ms since the epoch
+    int32_t v[SHM_MAX_METRICS];
+} ShmSample;
+
+typedef struct {
+    // Rewritten by each new writer in shm_publish_open(), inside the seqlock
+    // like the rest; readers take nmetrics and interval_ms from a snapshot
+    uint32_t magic, version;
+    uint32_t nmetrics;
+    int32_t interval_ms;            // sampling interval the writer was started with
+    char names[SHM_MAX_METRICS][16];
+
+    // Everything below is guarded by seq, on its own cache line
+    uint64_t seq __attribute__((aligned(64)));
+    int32_t writer_pid;             // 0 once the writer has stopped
+    uint64_t count;                 // samples published; newest at (count - 1) % SHM_HISTORY
+    int64_t published_ns;           // CLOCK_MONOTONIC of the last update
+    ShmSample samples[SHM_HISTORY];
+    double avg[SHM_WINDOWS][SHM_MAX_METRICS];   // exponential moving averages
+    int32_t min[SHM_MAX_METRICS], max[SHM_MAX_METRICS];  // over the samples kept
+} ShmRegion;
+
+// What a reader copies out in one consistent read
+typedef struct {
+    uint32_t nmetrics;              // at most SHM_MAX_METRICS
+    int32_t interval_ms;
+    int32_t writer_pid;
+    uint64_t count;
+    int64_t published_ns;
+    ShmSample latest;
+    double avg[SHM_WINDOWS][SHM_MAX_METRICS];
+    int32_t min[SHM_MAX_METRICS], max[SHM_MAX_METRICS];
+} ShmSnapshot;
+
+static inline int64_t shm_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);    // vDSO: no system call
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Maps the region read-only; NULL if there is none or it is not ours
+static inline const ShmRegion *shm_attach(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(ShmRegion))
+        p = mmap(NULL, sizeof(ShmRegion), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    const ShmRegion *r = (const ShmRegion *)p;
+    if (__atomic_load_n(&r->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC || r->version != SHM_VERSION) {
+        munmap(p, sizeof(ShmRegion));
+        return NULL;
+    }
+    return r;
+}
+
+static inline void shm_detach(const ShmRegion *r) {
+    if (r) munmap((void *)r, sizeof(ShmRegion));
+}
+
+// Called every SHM_SPIN_CHECK retries: 0 once the writer is dead or has
+// been in the same update for SHM_GIVE_UP_NS. since starts at 0.
+static inline int shm_keep_trying(const ShmRegion *r, int retries, int64_t *since) {
+    if (retries % SHM_SPIN_CHECK != SHM_SPIN_CHECK - 1) return 1;
+    int64_t now = shm_now_ns();
+    if (*since == 0) *since = now;
+    int32_t pid = __atomic_load_n(&r->writer_pid, __ATOMIC_RELAXED);
+    if (pid > 0 && kill(pid, 0) < 0 && errno == ESRCH) return 0;
+    return now - *since < SHM_GIVE_UP_NS;
+}
+
+static inline uint32_t shm_clamp_metrics(uint32_t n) {
+    return n < SHM_MAX_METRICS ? n : SHM_MAX_METRICS;
+}
+
+// Consistent copy of the newest sample and the aggregates. Returns how many
+// times it had to retry (0 almost always), -1 if nothing is published yet,
+// or SHM_WRITER_GONE if the writer died in the middle of an update.
+static inline int shm_snapshot(const ShmRegion *r, ShmSnapshot *out) {
+    int64_t since = 0;
+    for (int retries = 0; ; retries++) {
+        uint64_t s1 = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {                       // writer in the middle of an update
+            if (!shm_keep_trying(r, retries, &since)) return SHM_WRITER_GONE;
+            continue;
+        }
+        out->nmetrics = shm_clamp_metrics(r->nmetrics);
+        out->interval_ms = r->interval_ms;
+        out->writer_pid = r->writer_pid;
+        out->count = r->count;
+        out->published_ns = r->published_ns;
+        if (out->count > 0) out->latest = r->samples[(out->count - 1) % SHM_HISTORY];
+        memcpy(out->avg, r->avg, sizeof(out->avg));
+        memcpy(out->min, r->min, sizeof(out->min));
+        memcpy(out->max, r->max, sizeof(out->max));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) == s1)
+            return out->count > 0 ? retries : -1;
+    }
+}
+
+// Newest n samples (at most SHM_HISTORY), oldest first; returns how many,
+// or SHM_WRITER_GONE
+static inline int shm_recent(const ShmRegion *r, ShmSample *out, int n) {
+    if (n > SHM_HISTORY) n = SHM_HISTORY;
+    int64_t since = 0;
+    for (int retries = 0; ; retries++) {
+        uint64_t s1 = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            if (!shm_keep_trying(r, retries, &since)) return SHM_WRITER_GONE;
+            continue;
+        }
+        uint64_t count = r->count;
+        int got = count < (uint64_t)n ? (int)count : n;
+        for (int i = 0; i < got; i++)
+            out[i] = r->samples[(count - (uint64_t)got + (uint64_t)i) % SHM_HISTORY];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) == s1) return got;
+    }
+}
+
+// Index of a metric by name (CPU, MEM, ...), or -1
+static inline int shm_metric(const ShmRegion *r, const char *name) {
+    uint32_t n = shm_clamp_metrics(__atomic_load_n(&r->nmetrics, __ATOMIC_RELAXED));
+    for (uint32_t i = 0; i < n; i++)
+        if (strcmp(r->names[i], name) == 0) return (int)i;
+    return -1;
+}
+
+#endif
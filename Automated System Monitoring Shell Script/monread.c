@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "monitor_shm.h"
+
+// Reader for the sampler's shared-memory export (./sampler --stream --shm).
+// Maps the region once, then every read is a plain memory copy: no system
+// calls, no locks, and the sampler never waits for readers.
+//
+// Build: gcc -O2 monread.c -o monread
+// Run:   ./monread [--name NAME]                latest values, averages and min/max, as
+//                                               CPU=.. CPU_AVG1=.. CPU_MIN=.. ... AGE_MS=..
+//        ./monread --metric NAME [--avg 1|5|15] one value only, for scripts; exits 2
+//                                               if the sampler stopped updating it
+//        ./monread --watch MS [--count N]       one line per new sample, checked every MS
+//        ./monread --history N                  newest N samples, oldest first
+//        ./monread --bench [N] [--wait K]       cost of N reads, and the delay between the
+//                                               sampler publishing and a reader seeing it
+//                                               over K samples (spins one core meanwhile)
+
+#define STALE_INTERVALS 3           // no update for this many intervals: writer gone
+
+static const char *avg_names[SHM_WINDOWS] = {"AVG1", "AVG5", "AVG15"};
+
+// Milliseconds since the last update, from the monotonic clock all processes share
+static double age_ms(const ShmSnapshot *s) {
+    return (shm_now_ns() - s->published_ns) / 1e6;
+}
+
+static int is_stale(const ShmSnapshot *s) {
+    if (s->writer_pid == 0) return 1;
+    double limit = (s->interval_ms > 0 ? s->interval_ms : 1000) * STALE_INTERVALS;
+    return age_ms(s) > limit;
+}
+
+static void print_snapshot(const ShmRegion *r, const ShmSnapshot *s) {
+    for (uint32_t f = 0; f < s->nmetrics; f++) {
+        printf("%s=%d ", r->names[f], s->latest.v[f]);
+        for (int w = 0; w < SHM_WINDOWS; w++)
+            printf("%s_%s=%.1f ", r->names[f], avg_names[w], s->avg[w][f]);
+        printf("%s_MIN=%d %s_MAX=%d ", r->names[f], s->min[f], r->names[f], s->max[f]);
+    }
+    printf("SAMPLES=%llu TIME_MS=%lld AGE_MS=%.0f WRITER=%d STALE=%d\n",
+           (unsigned long long)s->count, (long long)s->latest.wall_ms, age_ms(s),
+           s->writer_pid, is_stale(s));
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Read cost, then publish-to-read delay
+static int bench(const ShmRegion *r, int n, int wait) {
+    int64_t *ns = malloc(sizeof(int64_t) * (size_t)(n > wait ? n : wait));
+    if (!ns) {
+        printf("Memory allocation error.\n");
+        return 1;
+    }
+    ShmSnapshot s;
+    long long retries = 0;
+    for (int i = 0; i < n; i++) {
+        int64_t t0 = shm_now_ns();
+        int got = shm_snapshot(r, &s);
+        ns[i] = shm_now_ns() - t0;
+        if (got > 0) retries += got;
+    }
+    qsort(ns, (size_t)n, sizeof(int64_t), cmp_i64);
+    printf("%d snapshots (%zu bytes each): median %lld ns, p99 %lld ns, max %lld ns, %lld retries\n",
+           n, sizeof(ShmSnapshot), (long long)ns[n / 2], (long long)ns[(int)(n * 0.99)],
+           (long long)ns[n - 1], retries);
+
+    if (shm_snapshot(r, &s) < 0 || is_stale(&s)) {
+        printf("No sampler is publishing, skipping the publish-to-read delay.\n");
+        free(ns);
+        return 0;
+    }
+    // Spin on the counter so the delay is not hidden behind a sleep
+    printf("Waiting for %d samples (interval %d ms)...\n", wait, s.interval_ms);
+    uint64_t last = s.count;
+    int64_t give_up = shm_now_ns() + (int64_t)(s.interval_ms * STALE_INTERVALS + 1000) * 1000000LL * wait;
+    int seen = 0;
+    while (seen < wait && shm_now_ns() < give_up) {
+        if (__atomic_load_n(&r->count, __ATOMIC_RELAXED) == last) continue;
+        int64_t now = shm_now_ns();
+        if (shm_snapshot(r, &s) < 0 || s.count == last) continue;
+        last = s.count;
+        ns[seen++] = now - s.published_ns;
+    }
+    if (seen == 0) {
+        printf("No new samples arrived.\n");
+        free(ns);
+        return 1;
+    }
+    qsort(ns, (size_t)seen, sizeof(int64_t), cmp_i64);
+    printf("publish-to-read delay over %d samples: median %lld ns, max %lld ns\n",
+           seen, (long long)ns[seen / 2], (long long)ns[seen - 1]);
+    free(ns);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *name = SHM_DEFAULT_NAME, *metric = NULL;
+    int watch = 0, count = 0, history = 0, bench_n = 0, wait = 10, avg = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) name = argv[++i];
+        else if (strcmp(argv[i], "--metric") == 0 && i + 1 < argc) metric = argv[++i];
+        else if (strcmp(argv[i], "--avg") == 0 && i + 1 < argc) avg = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) watch = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) history = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--wait") == 0 && i + 1 < argc) wait = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bench") == 0) {
+            bench_n = 1000000;
+            if (i + 1 < argc && argv[i + 1][0] != '-') bench_n = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [--name NAME] [--metric NAME [--avg 1|5|15]] [--watch MS [--count N]]\n"
+                   "       [--history N] [--bench [N] [--wait K]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const ShmRegion *r = shm_attach(name);
+    if (!r) {
+        printf("No monitor data in shared memory %s (start: ./sampler --stream --shm).\n", name);
+        return 1;
+    }
+
+    int ret = 0, got;
+    ShmSnapshot s;
+    if (bench_n > 0) {
+        ret = bench(r, bench_n, wait > 0 ? wait : 10);
+    } else if (history > 0) {
+        ShmSample recent[SHM_HISTORY];
+        got = shm_snapshot(r, &s) == SHM_WRITER_GONE ? SHM_WRITER_GONE : shm_recent(r, recent, history);
+        if (got == SHM_WRITER_GONE) {
+            printf("The sampler stopped in the middle of an update.\n");
+            ret = 2;
+        }
+        for (int i = 0; i < got; i++) {
+            printf("TIME_MS=%lld", (long long)recent[i].wall_ms);
+            for (uint32_t f = 0; f < s.nmetrics; f++) printf(" %s=%d", r->names[f], recent[i].v[f]);
+            printf("\n");
+        }
+    } else if (watch > 0) {
+        uint64_t last = 0;
+        for (int printed = 0; count == 0 || printed < count; ) {
+            if (shm_snapshot(r, &s) >= 0 && s.count != last) {
+                last = s.count;
+                print_snapshot(r, &s);
+                fflush(stdout);
+                printed++;
+            }
+            sleep_ms(watch);
+        }
+    } else if ((got = shm_snapshot(r, &s)) == SHM_WRITER_GONE) {
+        printf("The sampler stopped in the middle of an update.\n");
+        ret = 2;
+    } else if (got < 0) {
+        printf("Nothing published yet.\n");
+        ret = 1;
+    } else if (metric) {
+        int f = shm_metric(r, metric);
+        int w = avg == 1 ? 0 : avg == 5 ? 1 : avg == 15 ? 2 : -1;
+        if (f < 0) {
+            printf("Unknown metric %s.\n", metric);
+            ret = 1;
+        } else if (w >= 0) {
+            printf("%.1f\n", s.avg[w][f]);
+        } else {
+            printf("%d\n", s.latest.v[f]);
+        }
+        if (is_stale(&s)) ret = 2;
+    } else {
+        print_snapshot(r, &s);
+    }
+
+    shm_detach(r);
+    return ret;
+}
@@ -0,0 +1,1586 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <time.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <signal.h>
+#include <sys/resource.h>
+
+#include "monitor_shm.h"
+
+// Native sampler for monitor.sh.
+// Reads /proc/stat, /proc/meminfo and statvfs() directly instead of forking
+// top, free, df and friends. CPU% comes from the difference between two
+// reads of /proc/stat, so it covers the whole interval instead of a single
+// top snapshot. Disk I/O (/proc/diskstats), network (/proc/net/dev) and
+// pressure stall (/proc/pressure/*) are rates over the same interval.
+//
+// Build: gcc -O2 sampler.c -o sampler
+// Run:   ./sampler [--interval MS] [--path DIR]        one sample, as CPU=.. MEM=.. DISK=..
+//                                                      (--interval 0: no wait, CPU% meaningless)
+//        ./sampler --stream [--interval MS] [--count N] one line per interval until killed
+//        ./sampler --bench [N]                          cost of one sample in microseconds
+// Extra fields: --cores (CORES=per-core CPU%), --top N (TOP=pid:comm:cpu%:rssKB,...)
+//               --budget PCT stretches the interval if sampling would cost more
+//               than PCT% of one core (default 2)
+// History: ./sampler --stream --store DIR [--retain N]    also keep 1 s / 1 min / 1 h rollups
+//          ./sampler --query DIR [--from T] [--to T] [--tier 1s|1m|1h]
+//                                                      min/avg/max over [from, to); T is epoch
+//                                                      seconds, or negative = seconds ago
+// Alerts:  --alert METRIC:LIMIT[:SUSTAIN[:HYST]] (stream mode, repeatable), METRIC is one of
+//          the history fields (CPU, MEM, ..., PSI_IO) or DISK_FULL with LIMIT in seconds.
+//          Adds FIRING, RAISED, CLEARED, DISK_RATE (%/h) and DISK_TTF (s, -1 = not filling).
+//          --sustain S (30), --hysteresis H (5), --smooth S (EWMA time constant, 10),
+//          --window S (disk rate window, 600)
+// Export:  --shm [NAME] (stream mode) publishes every sample in shared memory
+//          (default /system-monitor) for other processes; see monitor_shm.h and monread.c
+
+#define DEFAULT_INTERVAL_MS 200     // one-shot mode: time between the two /proc/stat reads
+#define READ_BUF_SIZE 8192          // initial size; grows for big /proc/stat files
+#define STAT_BUF_SIZE 1024          // one /proc/PID/stat line
+#define MAX_CPUS 1024
+#define MAX_TOP 32
+#define RESCAN_MS 1000              // how often /proc is listed for new pids
+#define DEFAULT_BUDGET_PCT 2.0
+#define MAX_DEVICES 32              // disks and network interfaces each
+
+// Jiffies from the "cpu" line of /proc/stat
+typedef struct {
+    unsigned long long busy;        // user + nice + system + irq + softirq + steal
+    unsigned long long total;       // busy + idle + iowait
+} CpuTimes;
+
+// Cumulative counters of one disk (sectors read, written, ms busy) or
+// network interface (bytes received, sent)
+typedef struct {
+    char name[32];
+    unsigned long long a, b, busy_ms;
+} DevCounters;
+
+// Rates of one device over the last interval
+typedef struct {
+    char name[32];
+    int read_kbs, write_kbs, util; // network: read = received, write = sent
+} DevRates;
+
+typedef struct {
+    int cpu, mem, disk;             // percent, rounded like top, free and df
+    double disk_exact;              // disk percent unrounded, for its rate of change
+    int io;                         // busiest disk's utilization, percent
+    int io_read, io_write;          // all disks, kB/s
+    int net_rx, net_tx;             // all interfaces but lo, kB/s
+    int psi_cpu, psi_mem, psi_io;   // share of time some task stalled, percent; -1 without PSI
+    double sample_us;               // time spent reading and parsing this sample
+    double self_cpu;                // stream mode: sampler's own CPU, % of one core
+    int interval_ms;                // stream mode: interval actually used
+} Sample;
+
+// Cached state of one process. /proc/PID/schedstat stays open, so a sample
+// is one cheap pread() per process; a dead process makes the pread fail.
+// The costlier /proc/PID/stat (name, RSS) is only re-read after it ran.
+typedef struct {
+    int pid;
+    int fd;                         // -1 once the fd budget is used up: reopened per sample
+    unsigned long long runtime_ns;  // CPU time at the last read
+    unsigned long long delta_ns;    // CPU time used during the last interval
+    long rss_kb;
+    unsigned seen;                  // scan generation that last listed this pid
+    char comm[16];
+} ProcEntry;
+
+// pid -> slot in procs (1-based, 0 = not tracked). Indexed directly by pid;
+// calloc'd pages only become real memory where pids actually live.
+typedef struct {
+    ProcEntry *procs;
+    int count, cap;
+    int *slot_of_pid;
+    int pid_max;
+    int fd_budget;                  // open fds we allow ourselves
+    int open_fds;
+    int schedstat;                  // 0: kernel without schedstat, CPU time comes from stat
+    double ns_per_tick;
+    unsigned scan_gen;
+    double last_scan_us;
+    long page_kb;
+} ProcTable;
+
+// Files stay open between samples; each read is pread() from offset 0
+typedef struct {
+    int stat_fd;
+    int meminfo_fd;
+    const char *disk_path;
+    CpuTimes last;
+    CpuTimes last_core[MAX_CPUS];
+    int ncores;
+    int core_pct[MAX_CPUS];
+    int want_cores;
+    int top_n;                      // 0 = no per-process sampling
+    ProcTable pt;
+    int top[MAX_TOP];               // indexes into pt.procs, busiest first
+    int ntop;
+    double last_us;                 // when the processes were last read
+    double wall_ns;                 // length of the last interval
+
+    int diskstats_fd, netdev_fd;
+    int psi_fd[3];                  // cpu, memory, io; -1 without PSI
+    unsigned long long psi_total[3];    // stall time in us
+    char disk_names[MAX_DEVICES][32];   // whole disks from /sys/block, no loop or ram
+    int ndisk_names;
+    DevCounters disks[MAX_DEVICES], nets[MAX_DEVICES];
+    int ndisks, nnets;
+    DevRates disk_rates[MAX_DEVICES], net_rates[MAX_DEVICES];
+    double last_sample_us;
+} Sampler;
+
+// Whole-number metrics shared by the history and the alert rules
+#define NUM_METRICS 9
+const char *metric_names[NUM_METRICS] = {"CPU", "MEM", "DISK", "IO", "IO_KBS", "NET_KBS",
+                                         "PSI_CPU", "PSI_MEM", "PSI_IO"};
+
+// Without PSI the pressure metrics read 0
+void sample_metrics(const Sample *s, int v[NUM_METRICS]) {
+    v[0] = s->cpu;
+    v[1] = s->mem;
+    v[2] = s->disk;
+    v[3] = s->io;
+    v[4] = s->io_read + s->io_write;
+    v[5] = s->net_rx + s->net_tx;
+    v[6] = s->psi_cpu > 0 ? s->psi_cpu : 0;
+    v[7] = s->psi_mem > 0 ? s->psi_mem : 0;
+    v[8] = s->psi_io > 0 ? s->psi_io : 0;
+}
+
+char *read_buf;
+size_t read_buf_size;
+char stat_buf[STAT_BUF_SIZE];
+
+// --- HELPERS ---
+
+double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Whole file into read_buf, NUL-terminated; returns bytes read or -1.
+// The buffer doubles until the file fits (/proc/stat on a many-core machine
+// is far larger than one page) and keeps its size for the next read.
+int read_proc(int fd) {
+    size_t len = 0;
+    for (;;) {
+        if (len + 1 >= read_buf_size) {
+            size_t size = read_buf_size ? read_buf_size * 2 : READ_BUF_SIZE;
+            char *grown = realloc(read_buf, size);
+            if (!grown) return -1;
+            read_buf = grown;
+            read_buf_size = size;
+        }
+        ssize_t n = pread(fd, read_buf + len, read_buf_size - 1 - len, (off_t)len);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        len += (size_t)n;
+    }
+    read_buf[len] = '\0';
+    return (int)len;
+}
+
+// Copy len bytes of a kernel-supplied name (process, disk, interface) into
+// dst, replacing anything but [A-Za-z0-9._-] with '_'. monitor.sh evals our
+// output, and interface names in particular may contain $, ; or backticks.
+void copy_safe_name(char *dst, const char *src, int len) {
+    for (int i = 0; i < len; i++) {
+        char c = src[i];
+        dst[i] = (isalnum((unsigned char)c) || c == '.' || c == '-' || c == '_') ? c : '_';
+    }
+    dst[len] = '\0';
+}
+
+// Parse "cpu  user nice system idle iowait irq softirq steal ..." at p
+const char *parse_cpu_line(const char *p, CpuTimes *t) {
+    unsigned long long v[8] = {0};
+    while (*p && *p != ' ') p++;
+    for (int i = 0; i < 8; i++) {
+        char *end;
+        v[i] = strtoull(p, &end, 10);
+        if (end == p) break;
+        p = end;
+    }
+    t->busy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+    t->total = t->busy + v[3] + v[4];
+    while (*p && *p != '\n') p++;
+    return *p ? p + 1 : p;
+}
+
+int percent_of(unsigned long long part, unsigned long long whole) {
+    if (whole == 0) return 0;
+    return (int)((part * 100 + whole / 2) / whole);
+}
+
+// --- ALERTS ---
+// Each rule watches one metric through an EWMA. It fires once the EWMA has
+// stayed at or over the limit for the sustain time, and clears once it has
+// stayed under limit - hysteresis just as long. Disk use also goes into a
+// sliding window whose running least-squares sums give its rate of change,
+// and from that the time until the disk is full. Every step is O(1) per
+// sample, so the rules keep up with sub-second sampling.
+
+#define MAX_RULES 16
+#define WINDOW_CAP 4096             // samples in the sliding window
+#define RULE_DISK_FULL -1           // metric of the time-to-full rule
+#define DEFAULT_SUSTAIN 30.0
+#define DEFAULT_HYSTERESIS 5.0
+#define DEFAULT_SMOOTH 10.0
+#define DEFAULT_WINDOW 600.0
+
+// Ring of (time, value) with running sums for a linear fit
+typedef struct {
+    double t[WINDOW_CAP], v[WINDOW_CAP];
+    int head, count;                // oldest sample at head
+    int pushes;                     // since the sums were last rebuilt
+    double st, sv, stt, stv;
+} Window;
+
+typedef struct {
+    int metric;                     // index into metric_names, or RULE_DISK_FULL
+    double limit;                   // metric units; seconds for RULE_DISK_FULL
+    double sustain, hyst;
+    double ewma;
+    double since;                   // when the pending change started to hold, -1 if none
+    int firing;
+} AlertRule;
+
+typedef struct {
+    AlertRule rules[MAX_RULES];
+    int nrules;
+    double smooth, window_secs;
+    double t0, last_t;              // engine start (window times are relative to it), last sample
+    Window disk;
+    double disk_rate;               // percent per hour
+    double disk_ttf;                // seconds until 100%, -1 if not filling
+    char raised[512], cleared[512]; // "NAME:value,..." for this sample
+} AlertEngine;
+
+void window_push(Window *w, double t, double v, double span) {
+    // Drop what slid out of the window, or the oldest sample if full
+    while (w->count > 0 && (w->count == WINDOW_CAP || w->t[w->head] < t - span)) {
+        double ot = w->t[w->head], ov = w->v[w->head];
+        w->st -= ot;
+        w->sv -= ov;
+        w->stt -= ot * ot;
+        w->stv -= ot * ov;
+        w->head = (w->head + 1) % WINDOW_CAP;
+        w->count--;
+    }
+    int i = (w->head + w->count) % WINDOW_CAP;
+    w->t[i] = t;
+    w->v[i] = v;
+    w->count++;
+    w->st += t;
+    w->sv += v;
+    w->stt += t * t;
+    w->stv += t * v;
+
+    // Subtracting evicted samples slowly loses precision; rebuild the sums
+    // once per WINDOW_CAP pushes, which stays O(1) amortized
+    if (++w->pushes == WINDOW_CAP) {
+        w->pushes = 0;
+        w->st = w->sv = w->stt = w->stv = 0;
+        for (int k = 0; k < w->count; k++) {
+            int j = (w->head + k) % WINDOW_CAP;
+            w->st += w->t[j];
+            w->sv += w->v[j];
+            w->stt += w->t[j] * w->t[j];
+            w->stv += w->t[j] * w->v[j];
+        }
+    }
+}
+
+// Least-squares slope in value units per second; 0 until the window holds
+// a tenth of its span, so a few samples cannot project a full disk
+double window_slope(const Window *w, double span) {
+    if (w->count < 3) return 0;
+    double first = w->t[w->head], last = w->t[(w->head + w->count - 1) % WINDOW_CAP];
+    if (last - first < span / 10) return 0;
+    double n = w->count;
+    double denom = n * w->stt - w->st * w->st;
+    if (denom <= 0) return 0;
+    return (n * w->stv - w->st * w->sv) / denom;
+}
+
+// "METRIC:LIMIT[:SUSTAIN[:HYST]]", e.g. CPU:80:30:5
+int alert_add(AlertEngine *ae, const char *spec, double sustain, double hyst) {
+    if (ae->nrules == MAX_RULES) return -1;
+    char name[32];
+    double limit, rule_sustain = sustain, rule_hyst = hyst;
+    int n = sscanf(spec, "%31[^:]:%lf:%lf:%lf", name, &limit, &rule_sustain, &rule_hyst);
+    if (n < 2) return -1;
+    int metric = -2;
+    for (int m = 0; m < NUM_METRICS; m++)
+        if (strcmp(name, metric_names[m]) == 0) metric = m;
+    if (strcmp(name, "DISK_FULL") == 0) metric = RULE_DISK_FULL;
+    if (metric == -2) return -1;
+
+    AlertRule *r = &ae->rules[ae->nrules++];
+    memset(r, 0, sizeof(*r));
+    r->metric = metric;
+    r->limit = limit;
+    r->sustain = rule_sustain;
+    r->hyst = rule_hyst;
+    r->since = -1;
+    return 0;
+}
+
+void append_event(char *list, size_t size, const char *name, double value) {
+    size_t len = strlen(list);
+    snprintf(list + len, size - len, "%s%s:%.1f", len ? "," : "", name, value);
+}
+
+// Feed one sample through every rule at time t (seconds)
+void alert_update(AlertEngine *ae, const Sample *s, double t) {
+    if (ae->t0 == 0) ae->t0 = t;
+    double dt = ae->last_t > 0 ? t - ae->last_t : 0;
+    ae->last_t = t;
+    ae->raised[0] = ae->cleared[0] = '\0';
+
+    window_push(&ae->disk, t - ae->t0, s->disk_exact, ae->window_secs);
+    double slope = window_slope(&ae->disk, ae->window_secs);
+    ae->disk_rate = slope * 3600;
+    ae->disk_ttf = slope > 1e-9 ? (100 - s->disk_exact) / slope : -1;
+
+    int v[NUM_METRICS];
+    sample_metrics(s, v);
+    // Time-based smoothing: the same time constant at any interval
+    double alpha = dt > 0 ? dt / (ae->smooth + dt) : 1;
+
+    for (int i = 0; i < ae->nrules; i++) {
+        AlertRule *r = &ae->rules[i];
+        const char *name;
+        double value;
+        int over, under;
+        if (r->metric == RULE_DISK_FULL) {
+            // Fires when full within limit seconds, clears when it would take twice as long
+            name = "DISK_FULL";
+            value = ae->disk_ttf;
+            over = ae->disk_ttf >= 0 && ae->disk_ttf < r->limit;
+            under = ae->disk_ttf < 0 || ae->disk_ttf >= 2 * r->limit;
+        } else {
+            name = metric_names[r->metric];
+            r->ewma += alpha * (v[r->metric] - r->ewma);
+            value = r->ewma;
+            over = r->ewma >= r->limit;
+            under = r->ewma < r->limit - r->hyst;
+        }
+
+        if (r->firing ? under : over) {
+            if (r->since < 0) r->since = t;
+            if (t - r->since >= r->sustain) {
+                r->firing = !r->firing;
+                r->since = -1;
+                if (r->firing) append_event(ae->raised, sizeof(ae->raised), name, value);
+                else append_event(ae->cleared, sizeof(ae->cleared), name, value);
+            }
+        } else {
+            r->since = -1;
+        }
+    }
+}
+
+// FIRING lists every active rule; RAISED and CLEARED only this sample's changes
+void print_alerts(const AlertEngine *ae) {
+    printf(" FIRING=");
+    int first = 1;
+    for (int i = 0; i < ae->nrules; i++) {
+        const AlertRule *r = &ae->rules[i];
+        if (!r->firing) continue;
+        printf("%s%s", first ? "" : ",", r->metric == RULE_DISK_FULL ? "DISK_FULL" : metric_names[r->metric]);
+        first = 0;
+    }
+    printf(" RAISED=%s CLEARED=%s DISK_RATE=%.2f DISK_TTF=%.0f", ae->raised, ae->cleared, ae->disk_rate,
+           ae->disk_ttf);
+}
+
+// --- SAMPLING ---
+
+int proc_table_init(ProcTable *pt);
+void proc_table_destroy(ProcTable *pt);
+void sample_procs(Sampler *s);
+
+int sampler_open(Sampler *s, const char *disk_path) {
+    if (s->top_n > 0 && proc_table_init(&s->pt) < 0) return -1;
+    s->stat_fd = open("/proc/stat", O_RDONLY);
+    s->meminfo_fd = open("/proc/meminfo", O_RDONLY);
+    s->diskstats_fd = open("/proc/diskstats", O_RDONLY);
+    s->netdev_fd = open("/proc/net/dev", O_RDONLY);
+    const char *psi_files[3] = {"/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io"};
+    for (int i = 0; i < 3; i++) s->psi_fd[i] = open(psi_files[i], O_RDONLY);
+
+    // Partitions and virtual devices would count the same I/O twice
+    s->ndisk_names = 0;
+    DIR *d = opendir("/sys/block");
+    struct dirent *de;
+    while (d && (de = readdir(d)) != NULL && s->ndisk_names < MAX_DEVICES) {
+        if (de->d_name[0] == '.' || strncmp(de->d_name, "loop", 4) == 0 || strncmp(de->d_name, "ram", 3) == 0)
+            continue;
+        snprintf(s->disk_names[s->ndisk_names++], 32, "%.31s", de->d_name);
+    }
+    if (d) closedir(d);
+
+    s->disk_path = disk_path;
+    if (s->stat_fd < 0 || s->meminfo_fd < 0) {
+        printf("Cannot open /proc files.\n");
+        return -1;
+    }
+    s->last.busy = s->last.total = 0;
+    return 0;
+}
+
+void sampler_close(Sampler *s) {
+    if (s->top_n > 0) proc_table_destroy(&s->pt);
+    if (s->diskstats_fd >= 0) close(s->diskstats_fd);
+    if (s->netdev_fd >= 0) close(s->netdev_fd);
+    for (int i = 0; i < 3; i++)
+        if (s->psi_fd[i] >= 0) close(s->psi_fd[i]);
+    if (s->stat_fd >= 0) close(s->stat_fd);
+    if (s->meminfo_fd >= 0) close(s->meminfo_fd);
+}
+
+// Aggregate line first, then one "cpuN" line per core
+int read_cpu(Sampler *s, CpuTimes *t) {
+    if (read_proc(s->stat_fd) < 0) return -1;
+    const char *p = parse_cpu_line(read_buf, t);
+    if (!s->want_cores && !s->top_n) return 0;
+
+    int n = 0;
+    while (n < MAX_CPUS && strncmp(p, "cpu", 3) == 0 && isdigit((unsigned char)p[3])) {
+        CpuTimes c;
+        p = parse_cpu_line(p, &c);
+        s->core_pct[n] = percent_of(c.busy - s->last_core[n].busy, c.total - s->last_core[n].total);
+        s->last_core[n] = c;
+        n++;
+    }
+    s->ncores = n;
+    return 0;
+}
+
+// --- DISK, NETWORK AND PRESSURE ---
+
+int is_whole_disk(const Sampler *s, const char *name) {
+    for (int i = 0; i < s->ndisk_names; i++)
+        if (strcmp(s->disk_names[i], name) == 0) return 1;
+    return 0;
+}
+
+int per_sec(unsigned long long delta, double scale, double secs) {
+    return secs > 0 ? (int)(delta * scale / secs + 0.5) : 0;
+}
+
+// Rates for the counters in cur against the same-named entries in last.
+// A device that just appeared counts from zero, so it reports 0 this time.
+void device_rates(const DevCounters *cur, int ncur, const DevCounters *last, int nlast,
+                  DevRates *out, double scale, double secs) {
+    for (int i = 0; i < ncur; i++) {
+        const DevCounters *prev = NULL;
+        for (int j = 0; j < nlast && !prev; j++)
+            if (strcmp(last[j].name, cur[i].name) == 0) prev = &last[j];
+        memcpy(out[i].name, cur[i].name, sizeof(out[i].name));
+        out[i].read_kbs = out[i].write_kbs = out[i].util = 0;
+        if (!prev) continue;
+        out[i].read_kbs = per_sec(cur[i].a - prev->a, scale, secs);
+        out[i].write_kbs = per_sec(cur[i].b - prev->b, scale, secs);
+        out[i].util = per_sec(cur[i].busy_ms - prev->busy_ms, 0.1, secs);   // ms per s -> %
+        if (out[i].util > 100) out[i].util = 100;
+    }
+}
+
+// "major minor name reads merged sectors ms writes merged sectors ms inflight io_ms ..."
+void read_disks(Sampler *s, Sample *out, double secs) {
+    DevCounters cur[MAX_DEVICES];
+    int n = 0;
+    if (s->diskstats_fd >= 0 && read_proc(s->diskstats_fd) >= 0) {
+        for (const char *p = read_buf; *p && n < MAX_DEVICES; ) {
+            char name[32];
+            unsigned long long v[11];
+            if (sscanf(p, "%*u %*u %31s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu", name,
+                       &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9]) == 11 &&
+                is_whole_disk(s, name)) {
+                copy_safe_name(cur[n].name, name, (int)strlen(name));
+                cur[n].a = v[2];
+                cur[n].b = v[6];
+                cur[n].busy_ms = v[9];
+                n++;
+            }
+            p = strchr(p, '\n');
+            if (!p) break;
+            p++;
+        }
+    }
+    device_rates(cur, n, s->disks, s->ndisks, s->disk_rates, 512.0 / 1024, secs);  // sectors -> kB
+    memcpy(s->disks, cur, n * sizeof(DevCounters));
+    s->ndisks = n;
+
+    out->io = out->io_read = out->io_write = 0;
+    for (int i = 0; i < n; i++) {
+        if (s->disk_rates[i].util > out->io) out->io = s->disk_rates[i].util;
+        out->io_read += s->disk_rates[i].read_kbs;
+        out->io_write += s->disk_rates[i].write_kbs;
+    }
+}
+
+// "  eth0: rx_bytes packets errs drop fifo frame compressed multicast tx_bytes ..."
+void read_nets(Sampler *s, Sample *out, double secs) {
+    DevCounters cur[MAX_DEVICES];
+    int n = 0;
+    if (s->netdev_fd >= 0 && read_proc(s->netdev_fd) >= 0) {
+        for (const char *p = read_buf; *p && n < MAX_DEVICES; ) {
+            const char *colon = strchr(p, ':'), *eol = strchr(p, '\n');
+            if (colon && (!eol || colon < eol)) {
+                while (*p == ' ') p++;
+                int len = (int)(colon - p);
+                unsigned long long v[9];
+                if (len > 0 && len < 32 && !(len == 2 && strncmp(p, "lo", 2) == 0) &&
+                    sscanf(colon + 1, "%llu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0], &v[1], &v[2],
+                           &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) == 9) {
+                    copy_safe_name(cur[n].name, p, len);
+                    cur[n].a = v[0];
+                    cur[n].b = v[8];
+                    cur[n].busy_ms = 0;
+                    n++;
+                }
+            }
+            if (!eol) break;
+            p = eol + 1;
+        }
+    }
+    device_rates(cur, n, s->nets, s->nnets, s->net_rates, 1.0 / 1024, secs);
+    memcpy(s->nets, cur, n * sizeof(DevCounters));
+    s->nnets = n;
+
+    out->net_rx = out->net_tx = 0;
+    for (int i = 0; i < n; i++) {
+        out->net_rx += s->net_rates[i].read_kbs;
+        out->net_tx += s->net_rates[i].write_kbs;
+    }
+}
+
+// "some avg10=.. avg60=.. avg300=.. total=US": the share of the interval in
+// which at least one task was stalled, from the growth of total
+void read_pressure(Sampler *s, Sample *out, double secs) {
+    int *pct[3] = {&out->psi_cpu, &out->psi_mem, &out->psi_io};
+    for (int i = 0; i < 3; i++) {
+        *pct[i] = -1;
+        if (s->psi_fd[i] < 0 || read_proc(s->psi_fd[i]) < 0) continue;
+        const char *p = strstr(read_buf, "total=");
+        if (!p) continue;
+        unsigned long long total = strtoull(p + 6, NULL, 10);
+        *pct[i] = per_sec(total - s->psi_total[i], 1e-4, secs);   // us per s -> %
+        if (*pct[i] > 100) *pct[i] = 100;
+        s->psi_total[i] = total;
+    }
+}
+
+// --- PROCESS TABLE ---
+
+int proc_table_init(ProcTable *pt) {
+    memset(pt, 0, sizeof(*pt));
+    pt->pid_max = 4194304;
+    FILE *f = fopen("/proc/sys/kernel/pid_max", "r");
+    if (f) {
+        if (fscanf(f, "%d", &pt->pid_max) != 1) pt->pid_max = 4194304;
+        fclose(f);
+    }
+    pt->slot_of_pid = calloc((size_t)pt->pid_max + 1, sizeof(int));
+    pt->cap = 1024;
+    pt->procs = malloc(pt->cap * sizeof(ProcEntry));
+    if (!pt->slot_of_pid || !pt->procs) {
+        printf("Memory allocation error.\n");
+        return -1;
+    }
+
+    // Use as many fds as the hard limit allows, keeping some headroom
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        getrlimit(RLIMIT_NOFILE, &rl);
+        pt->fd_budget = rl.rlim_cur > 64 ? (int)(rl.rlim_cur - 64) : 0;
+    }
+    pt->schedstat = access("/proc/self/schedstat", R_OK) == 0;
+    pt->ns_per_tick = 1e9 / sysconf(_SC_CLK_TCK);
+    pt->page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    return 0;
+}
+
+void proc_table_destroy(ProcTable *pt) {
+    for (int i = 0; i < pt->count; i++)
+        if (pt->procs[i].fd >= 0) close(pt->procs[i].fd);
+    free(pt->procs);
+    free(pt->slot_of_pid);
+}
+
+// Swap-remove entry i, keeping slot_of_pid in step
+void proc_remove(ProcTable *pt, int i) {
+    ProcEntry *e = &pt->procs[i];
+    if (e->fd >= 0) {
+        close(e->fd);
+        pt->open_fds--;
+    }
+    pt->slot_of_pid[e->pid] = 0;
+    int last = --pt->count;
+    if (i != last) {
+        pt->procs[i] = pt->procs[last];
+        pt->slot_of_pid[pt->procs[i].pid] = i + 1;
+    }
+}
+
+// Whole /proc/PID/NAME into stat_buf, through fd if we hold one
+int proc_file(int pid, int fd, const char *name) {
+    ssize_t n;
+    if (fd >= 0) {
+        n = pread(fd, stat_buf, sizeof(stat_buf) - 1, 0);
+    } else {
+        char path[48];
+        snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+        fd = open(path, O_RDONLY);
+        if (fd < 0) return -1;
+        n = read(fd, stat_buf, sizeof(stat_buf) - 1);
+        close(fd);
+    }
+    if (n <= 0) return -1;
+    stat_buf[n] = '\0';
+    return 0;
+}
+
+// Name, RSS and (without schedstat) CPU time from /proc/PID/stat.
+// Returns CPU time in ns, or -1 if the process is gone.
+long long proc_read_stat(ProcTable *pt, ProcEntry *e, int fd) {
+    if (proc_file(e->pid, fd, "stat") < 0) return -1;
+
+    // "pid (comm) state ppid ..." - comm may itself contain ')' or spaces
+    char *open_paren = strchr(stat_buf, '(');
+    char *close_paren = strrchr(stat_buf, ')');
+    if (!open_paren || !close_paren || close_paren < open_paren) return -1;
+    int len = (int)(close_paren - open_paren - 1);
+    if (len > (int)sizeof(e->comm) - 1) len = sizeof(e->comm) - 1;
+    copy_safe_name(e->comm, open_paren + 1, len);
+
+    // Fields after comm start at field 3 (state); utime is 14, stime 15, rss 24
+    unsigned long long f[25] = {0};
+    char *p = close_paren + 2;
+    for (int field = 3; field <= 24 && *p; field++) {
+        char *end;
+        f[field] = strtoull(p, &end, 10);
+        if (end == p) {                         // the state letter
+            while (*p && *p != ' ') p++;
+        } else {
+            p = end;
+        }
+        while (*p == ' ') p++;
+    }
+    e->rss_kb = (long)f[24] * pt->page_kb;
+    return (long long)((f[14] + f[15]) * pt->ns_per_tick);
+}
+
+// CPU time in ns: first field of schedstat, or utime + stime from stat
+long long proc_read_cpu(ProcTable *pt, ProcEntry *e) {
+    if (!pt->schedstat) return proc_read_stat(pt, e, e->fd);
+    if (proc_file(e->pid, e->fd, "schedstat") < 0) return -1;
+    return (long long)strtoull(stat_buf, NULL, 10);
+}
+
+// Track a pid we have not seen before; its first interval counts from now
+void proc_add(ProcTable *pt, int pid) {
+    if (pt->count == pt->cap) {
+        ProcEntry *grown = realloc(pt->procs, pt->cap * 2 * sizeof(ProcEntry));
+        if (!grown) return;
+        pt->procs = grown;
+        pt->cap *= 2;
+    }
+    ProcEntry *e = &pt->procs[pt->count];
+    memset(e, 0, sizeof(*e));
+    e->pid = pid;
+    e->fd = -1;
+    e->seen = pt->scan_gen;
+    if (pt->open_fds < pt->fd_budget) {
+        char path[48];
+        snprintf(path, sizeof(path), "/proc/%d/%s", pid, pt->schedstat ? "schedstat" : "stat");
+        e->fd = open(path, O_RDONLY);
+        if (e->fd >= 0) pt->open_fds++;
+    }
+    long long ns = proc_read_cpu(pt, e);
+    if (ns < 0 || (pt->schedstat && proc_read_stat(pt, e, -1) < 0)) {
+        if (e->fd >= 0) {
+            close(e->fd);
+            pt->open_fds--;
+        }
+        return;
+    }
+    e->runtime_ns = (unsigned long long)ns;
+    pt->slot_of_pid[pid] = ++pt->count;
+}
+
+// List /proc for new and vanished pids. Between scans only the cached
+// entries are read, which is what keeps thousands of pids cheap.
+void proc_scan(ProcTable *pt) {
+    DIR *d = opendir("/proc");
+    if (!d) return;
+    pt->scan_gen++;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (!isdigit((unsigned char)de->d_name[0])) continue;
+        int pid = atoi(de->d_name);
+        if (pid <= 0 || pid > pt->pid_max) continue;
+        int slot = pt->slot_of_pid[pid];
+        if (slot) pt->procs[slot - 1].seen = pt->scan_gen;
+        else proc_add(pt, pid);
+    }
+    closedir(d);
+    for (int i = pt->count - 1; i >= 0; i--)
+        if (pt->procs[i].seen != pt->scan_gen) proc_remove(pt, i);
+}
+
+// Busier first: more CPU time, then larger RSS
+int proc_busier(const ProcEntry *a, const ProcEntry *b) {
+    if (a->delta_ns != b->delta_ns) return a->delta_ns > b->delta_ns;
+    return a->rss_kb > b->rss_kb;
+}
+
+// Refresh every tracked process and keep the top N in a small min-heap
+// (root = least busy of the current top), O(P log N) per sample
+void sample_procs(Sampler *s) {
+    ProcTable *pt = &s->pt;
+    if (now_us() - pt->last_scan_us >= RESCAN_MS * 1000.0) {
+        proc_scan(pt);
+        pt->last_scan_us = now_us();
+    }
+
+    int heap[MAX_TOP], n = 0;
+    for (int i = pt->count - 1; i >= 0; i--) {
+        ProcEntry *e = &pt->procs[i];
+        long long ns = proc_read_cpu(pt, e);
+        if (ns >= 0 && (unsigned long long)ns < e->runtime_ns) ns = -1;   // pid reused under us
+        if (ns >= 0) {
+            e->delta_ns = (unsigned long long)ns - e->runtime_ns;
+            e->runtime_ns = (unsigned long long)ns;
+            // Name and RSS only change while a process runs
+            if (e->delta_ns > 0 && pt->schedstat && proc_read_stat(pt, e, -1) < 0) ns = -1;
+        }
+        if (ns < 0) {
+            proc_remove(pt, i);     // moves the last entry (already read) into i
+            continue;
+        }
+        int k;
+        if (n < s->top_n) {
+            k = n++;
+        } else if (proc_busier(e, &pt->procs[heap[0]])) {
+            k = 0;                  // replace the root, then sift down
+            for (;;) {
+                int c = 2 * k + 1;
+                if (c >= n) break;
+                if (c + 1 < n && proc_busier(&pt->procs[heap[c]], &pt->procs[heap[c + 1]])) c++;
+                if (!proc_busier(e, &pt->procs[heap[c]])) break;
+                heap[k] = heap[c];
+                k = c;
+            }
+            heap[k] = i;
+            continue;
+        } else {
+            continue;
+        }
+        while (k > 0 && proc_busier(&pt->procs[heap[(k - 1) / 2]], e)) {  // sift up
+            heap[k] = heap[(k - 1) / 2];
+            k = (k - 1) / 2;
+        }
+        heap[k] = i;
+    }
+
+    // Heap -> busiest first
+    s->ntop = n;
+    while (n > 0) {
+        s->top[n - 1] = heap[0];
+        int last = heap[--n];
+        int k = 0;
+        for (;;) {
+            int c = 2 * k + 1;
+            if (c >= n) break;
+            if (c + 1 < n && proc_busier(&pt->procs[heap[c]], &pt->procs[heap[c + 1]])) c++;
+            if (!proc_busier(&pt->procs[last], &pt->procs[heap[c]])) break;
+            heap[k] = heap[c];
+            k = c;
+        }
+        heap[k] = last;
+    }
+}
+
+int read_sample(Sampler *s, Sample *out) {
+    double t0 = now_us();
+
+    CpuTimes now;
+    if (read_cpu(s, &now) < 0) return -1;
+    unsigned long long dtotal = now.total - s->last.total;
+    unsigned long long dbusy = now.busy - s->last.busy;
+    out->cpu = percent_of(dbusy, dtotal);
+    s->last = now;
+    if (s->top_n > 0) {
+        double t = now_us();
+        s->wall_ns = (t - s->last_us) * 1000.0;
+        s->last_us = t;
+        sample_procs(s);
+    }
+
+    // Used memory as free(1) computes it: MemTotal - MemAvailable
+    if (read_proc(s->meminfo_fd) < 0) return -1;
+    unsigned long long mem_total = 0, mem_avail = 0;
+    const char *p = strstr(read_buf, "MemTotal:");
+    if (p) mem_total = strtoull(p + 9, NULL, 10);
+    p = strstr(read_buf, "MemAvailable:");
+    if (p) mem_avail = strtoull(p + 13, NULL, 10);
+    out->mem = percent_of(mem_total - mem_avail, mem_total);
+
+    // Used / (used + available to users), rounded up like df
+    struct statvfs vfs;
+    out->disk = 0;
+    out->disk_exact = 0;
+    if (statvfs(s->disk_path, &vfs) == 0) {
+        unsigned long long used = (unsigned long long)(vfs.f_blocks - vfs.f_bfree);
+        unsigned long long usable = used + vfs.f_bavail;
+        if (usable) out->disk = (int)((used * 100 + usable - 1) / usable);
+        if (usable) out->disk_exact = used * 100.0 / usable;
+    }
+
+    // First read: secs = 0, so every rate is 0 and only the baseline is kept
+    double secs = s->last_sample_us > 0 ? (t0 - s->last_sample_us) / 1e6 : 0;
+    s->last_sample_us = t0;
+    read_disks(s, out, secs);
+    read_nets(s, out, secs);
+    read_pressure(s, out, secs);
+
+    out->sample_us = now_us() - t0;
+    return 0;
+}
+
+// Set by SIGTERM/SIGINT/SIGHUP/SIGPIPE so stream mode can close its history
+volatile sig_atomic_t stop_requested;
+
+void request_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+void sleep_ms(int ms) {
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+// Sampler's own user + system CPU time
+double self_cpu_us() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec * 1e6 + ru.ru_utime.tv_usec + ru.ru_stime.tv_sec * 1e6 + ru.ru_stime.tv_usec;
+}
+
+// One line of shell assignments; CORES and TOP are comma lists without spaces
+void print_sample(const Sampler *sp, const Sample *s, const AlertEngine *ae, int stream) {
+    printf("CPU=%d MEM=%d DISK=%d IO=%d IO_READ=%d IO_WRITE=%d NET_RX=%d NET_TX=%d", s->cpu, s->mem,
+           s->disk, s->io, s->io_read, s->io_write, s->net_rx, s->net_tx);
+    if (s->psi_cpu >= 0) printf(" PSI_CPU=%d PSI_MEM=%d PSI_IO=%d", s->psi_cpu, s->psi_mem, s->psi_io);
+    printf(" SAMPLE_US=%.0f", s->sample_us);
+    if (stream) printf(" SELF_CPU=%.2f INTERVAL_MS=%d", s->self_cpu, s->interval_ms);
+    // Per device: DISKS=name:read kB/s:write kB/s:util%, NETS=name:rx kB/s:tx kB/s
+    printf(" DISKS=");
+    for (int i = 0; i < sp->ndisks; i++)
+        printf("%s%s:%d:%d:%d", i ? "," : "", sp->disk_rates[i].name, sp->disk_rates[i].read_kbs,
+               sp->disk_rates[i].write_kbs, sp->disk_rates[i].util);
+    printf(" NETS=");
+    for (int i = 0; i < sp->nnets; i++)
+        printf("%s%s:%d:%d", i ? "," : "", sp->net_rates[i].name, sp->net_rates[i].read_kbs,
+               sp->net_rates[i].write_kbs);
+    if (sp->want_cores) {
+        printf(" CORES=");
+        for (int i = 0; i < sp->ncores; i++) printf(i ? ",%d" : "%d", sp->core_pct[i]);
+    }
+    if (sp->top_n > 0) {
+        // CPU% of one core, like top
+        printf(" PROCS=%d TOP=", sp->pt.count);
+        for (int i = 0; i < sp->ntop; i++) {
+            const ProcEntry *e = &sp->pt.procs[sp->top[i]];
+            double pct = sp->wall_ns > 0 ? e->delta_ns * 100.0 / sp->wall_ns : 0;
+            printf("%s%d:%s:%.1f:%ld", i ? "," : "", e->pid, e->comm, pct, e->rss_kb);
+        }
+    }
+    if (ae && ae->nrules > 0) print_alerts(ae);
+    printf("\n");
+    fflush(stdout);
+}
+
+// --- TIME-SERIES STORE ---
+// Samples are kept in DIR as 1-second, 1-minute and 1-hour rollups. Each
+// tier is a run of fixed-size segment files named TIER-FIRSTTS.seg: a
+// header with the segment's span and a min/sum/max summary, then records
+// whose time and values are zigzag varint deltas from the previous record.
+// Only the newest retain segments of each tier are kept.
+
+#define TS_FIELDS NUM_METRICS
+#define TS_TIERS 3
+#define TS_SEGMENT_SIZE 65536
+#define TS_HEADER_SIZE 256          // records start here
+#define TS_MAX_RECORD 256
+#define TS_RETAIN 32                // segments kept per tier
+#define TS_MAGIC 0x32475354         // "TSG2"
+
+const int tier_secs[TS_TIERS] = {1, 60, 3600};
+const char *tier_names[TS_TIERS] = {"1s", "1m", "1h"};
+
+// One rollup bucket. Sums are in hundredths so averages survive rollups.
+typedef struct {
+    int64_t ts;                     // bucket start, epoch seconds
+    uint32_t n;                     // samples folded in
+    int32_t min[TS_FIELDS], max[TS_FIELDS];
+    int64_t sum[TS_FIELDS];         // sum of sample values * 100
+} TsBucket;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t tier;
+    uint32_t used;                  // bytes of records after the header
+    uint32_t records;
+    int64_t first_ts, last_ts;
+    TsBucket total;                 // every record folded in, for whole-segment queries
+} TsHeader;
+
+_Static_assert(sizeof(TsHeader) <= TS_HEADER_SIZE, "segment header overlaps the records");
+
+// Last record, the base for the next delta
+typedef struct {
+    int64_t ts;
+    int32_t min[TS_FIELDS], avg[TS_FIELDS], max[TS_FIELDS];   // avg in hundredths
+} TsPrev;
+
+typedef struct {
+    int fd;                         // newest segment, -1 until the first write
+    TsHeader hdr;
+    TsPrev prev;
+    TsBucket open;                  // bucket still collecting samples (n = 0: none)
+} TsTier;
+
+typedef struct {
+    char dir[256];
+    int retain;
+    int recovering;                 // rebuilding open buckets: no cascading
+    TsTier tier[TS_TIERS];
+} TsStore;
+
+uint8_t seg_buf[TS_SEGMENT_SIZE];
+
+int put_varint(uint8_t *p, int64_t v) {
+    uint64_t z = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);   // zigzag: small magnitudes stay short
+    int n = 0;
+    while (z >= 0x80) {
+        p[n++] = (uint8_t)(z | 0x80);
+        z >>= 7;
+    }
+    p[n++] = (uint8_t)z;
+    return n;
+}
+
+int get_varint(const uint8_t **p, const uint8_t *end, int64_t *v) {
+    uint64_t z = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t b = *(*p)++;
+        z |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// A single sample (n = 1) only stores its value; rollups store min, avg, max
+int ts_encode(TsPrev *prev, const TsBucket *b, uint8_t *out) {
+    int len = put_varint(out, b->ts - prev->ts);
+    len += put_varint(out + len, b->n);
+    prev->ts = b->ts;
+    for (int f = 0; f < TS_FIELDS; f++) {
+        int32_t avg = (int32_t)((b->sum[f] + b->n / 2) / b->n);
+        if (b->n == 1) {
+            len += put_varint(out + len, b->min[f] - prev->max[f]);
+        } else {
+            len += put_varint(out + len, b->min[f] - prev->min[f]);
+            len += put_varint(out + len, avg - prev->avg[f]);
+            len += put_varint(out + len, b->max[f] - prev->max[f]);
+        }
+        prev->min[f] = b->min[f];
+        prev->avg[f] = avg;
+        prev->max[f] = b->max[f];
+    }
+    return len;
+}
+
+int ts_decode(TsPrev *prev, const uint8_t **p, const uint8_t *end, TsBucket *b) {
+    int64_t dts, n, v;
+    if (get_varint(p, end, &dts) < 0 || get_varint(p, end, &n) < 0 || n <= 0) return -1;
+    b->ts = prev->ts += dts;
+    b->n = (uint32_t)n;
+    for (int f = 0; f < TS_FIELDS; f++) {
+        if (n == 1) {
+            if (get_varint(p, end, &v) < 0) return -1;
+            prev->min[f] = prev->max[f] = (int32_t)(prev->max[f] + v);
+            prev->avg[f] = prev->max[f] * 100;
+        } else {
+            if (get_varint(p, end, &v) < 0) return -1;
+            prev->min[f] += (int32_t)v;
+            if (get_varint(p, end, &v) < 0) return -1;
+            prev->avg[f] += (int32_t)v;
+            if (get_varint(p, end, &v) < 0) return -1;
+            prev->max[f] += (int32_t)v;
+        }
+        b->min[f] = prev->min[f];
+        b->max[f] = prev->max[f];
+        b->sum[f] = (int64_t)prev->avg[f] * b->n;
+    }
+    return 0;
+}
+
+void bucket_merge(TsBucket *into, const TsBucket *b) {
+    if (into->n == 0) {
+        int64_t ts = into->ts;
+        *into = *b;
+        into->ts = ts;
+        return;
+    }
+    into->n += b->n;
+    for (int f = 0; f < TS_FIELDS; f++) {
+        if (b->min[f] < into->min[f]) into->min[f] = b->min[f];
+        if (b->max[f] > into->max[f]) into->max[f] = b->max[f];
+        into->sum[f] += b->sum[f];
+    }
+}
+
+int cmp_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Start times of a tier's segments, oldest first; caller frees
+int ts_list(const char *dir, int tier, int64_t **starts) {
+    *starts = NULL;
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+    int count = 0, cap = 0;
+    size_t plen = strlen(tier_names[tier]);
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, tier_names[tier], plen) != 0 || de->d_name[plen] != '-') continue;
+        char *end;
+        long long start = strtoll(de->d_name + plen + 1, &end, 10);
+        if (strcmp(end, ".seg") != 0) continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 64;
+            int64_t *grown = realloc(*starts, cap * sizeof(int64_t));
+            if (!grown) break;
+            *starts = grown;
+        }
+        (*starts)[count++] = start;
+    }
+    closedir(d);
+    qsort(*starts, count, sizeof(int64_t), cmp_int64);
+    return count;
+}
+
+void ts_path(char *buf, size_t size, const char *dir, int tier, int64_t start) {
+    snprintf(buf, size, "%s/%s-%lld.seg", dir, tier_names[tier], (long long)start);
+}
+
+// Header and records of a segment; records land in seg_buf
+int ts_read_segment(int fd, TsHeader *hdr) {
+    if (pread(fd, hdr, sizeof(*hdr), 0) != (ssize_t)sizeof(*hdr) || hdr->magic != TS_MAGIC ||
+        hdr->used > TS_SEGMENT_SIZE - TS_HEADER_SIZE)
+        return -1;
+    if (pread(fd, seg_buf, hdr->used, TS_HEADER_SIZE) != (ssize_t)hdr->used) return -1;
+    return 0;
+}
+
+// Drop the oldest segments beyond the retain count
+void ts_rotate(TsStore *st, int tier) {
+    int64_t *starts;
+    int count = ts_list(st->dir, tier, &starts);
+    for (int i = 0; i < count - st->retain; i++) {
+        char path[320];
+        ts_path(path, sizeof(path), st->dir, tier, starts[i]);
+        unlink(path);
+    }
+    free(starts);
+}
+
+// Append one finished bucket to a tier, starting a new segment when full
+int ts_write(TsStore *st, int tier, const TsBucket *b) {
+    TsTier *t = &st->tier[tier];
+    if (t->fd < 0 || t->hdr.used + TS_MAX_RECORD > TS_SEGMENT_SIZE - TS_HEADER_SIZE) {
+        if (t->fd >= 0) close(t->fd);
+        char path[320];
+        ts_path(path, sizeof(path), st->dir, tier, b->ts);
+        t->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (t->fd < 0) return -1;
+        memset(&t->hdr, 0, sizeof(t->hdr));
+        memset(&t->prev, 0, sizeof(t->prev));
+        t->hdr.magic = TS_MAGIC;
+        t->hdr.tier = tier;
+        ts_rotate(st, tier);
+    }
+
+    uint8_t rec[TS_MAX_RECORD];
+    int len = ts_encode(&t->prev, b, rec);
+    if (pwrite(t->fd, rec, len, TS_HEADER_SIZE + t->hdr.used) != len) return -1;
+    if (t->hdr.records == 0) t->hdr.first_ts = b->ts;
+    t->hdr.last_ts = b->ts;
+    t->hdr.records++;
+    t->hdr.used += len;
+    bucket_merge(&t->hdr.total, b);
+    if (pwrite(t->fd, &t->hdr, sizeof(t->hdr), 0) != (ssize_t)sizeof(t->hdr)) return -1;
+    return 0;
+}
+
+// Fold b into the tier's open bucket. A bucket that is closed by a later
+// one is written out and folded into the next tier up.
+void ts_add(TsStore *st, int tier, const TsBucket *b) {
+    TsTier *t = &st->tier[tier];
+    int64_t start = b->ts - b->ts % tier_secs[tier];
+    if (t->open.n > 0 && t->open.ts != start) {
+        TsBucket done = t->open;
+        ts_write(st, tier, &done);
+        if (tier + 1 < TS_TIERS && !st->recovering) ts_add(st, tier + 1, &done);
+        t->open.n = 0;
+    }
+    t->open.ts = start;
+    bucket_merge(&t->open, b);
+}
+
+// Rebuild a coarser tier's open bucket from the finer records it has not
+// absorbed yet. Those can span several finer segments, so every segment
+// that may hold one is read, oldest first.
+void ts_recover_tier(TsStore *st, int tier) {
+    TsTier *finer = &st->tier[tier - 1], *t = &st->tier[tier];
+    if (finer->hdr.records == 0) return;
+    int64_t after = t->hdr.records ? t->hdr.last_ts + tier_secs[tier]
+                                   : finer->hdr.last_ts - finer->hdr.last_ts % tier_secs[tier];
+    int64_t *starts;
+    int count = ts_list(st->dir, tier - 1, &starts);
+    int first = count;
+    while (first > 0 && starts[first - 1] > after) first--;
+    if (first > 0) first--;                     // the segment that was open at 'after'
+    for (int i = first; i < count; i++) {
+        char path[320];
+        ts_path(path, sizeof(path), st->dir, tier - 1, starts[i]);
+        int fd = open(path, O_RDONLY);
+        TsHeader hdr;
+        if (fd >= 0 && ts_read_segment(fd, &hdr) == 0 && hdr.records > 0 && hdr.last_ts >= after) {
+            const uint8_t *p = seg_buf, *end = seg_buf + hdr.used;
+            TsPrev prev = {0};
+            TsBucket b;
+            while (p < end && ts_decode(&prev, &p, end, &b) == 0)
+                if (b.ts >= after) ts_add(st, tier, &b);
+        }
+        if (fd >= 0) close(fd);
+    }
+    free(starts);
+}
+
+// Continue the newest segment of each tier, then rebuild the open buckets
+// of the coarser tiers from finer records they have not absorbed yet
+int ts_store_open(TsStore *st, const char *dir, int retain) {
+    memset(st, 0, sizeof(*st));
+    snprintf(st->dir, sizeof(st->dir), "%s", dir);
+    st->retain = retain > 0 ? retain : TS_RETAIN;
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        printf("Cannot create %s.\n", dir);
+        return -1;
+    }
+
+    for (int tier = 0; tier < TS_TIERS; tier++) {
+        TsTier *t = &st->tier[tier];
+        t->fd = -1;
+        int64_t *starts;
+        int count = ts_list(dir, tier, &starts);
+        if (count > 0) {
+            char path[320];
+            ts_path(path, sizeof(path), dir, tier, starts[count - 1]);
+            int fd = open(path, O_RDWR);
+            if (fd >= 0 && ts_read_segment(fd, &t->hdr) == 0) {
+                const uint8_t *p = seg_buf, *end = seg_buf + t->hdr.used;
+                TsBucket b;
+                while (p < end && ts_decode(&t->prev, &p, end, &b) == 0) {}
+                t->fd = fd;
+            } else if (fd >= 0) {
+                close(fd);                      // damaged: the next write starts a fresh segment
+            }
+        }
+        free(starts);
+    }
+
+    st->recovering = 1;
+    for (int tier = 1; tier < TS_TIERS; tier++) ts_recover_tier(st, tier);
+    st->recovering = 0;
+    return 0;
+}
+
+// The open second is written out; the coarser open buckets are rebuilt
+// from it by the next open
+void ts_store_close(TsStore *st) {
+    if (st->tier[0].open.n > 0) ts_write(st, 0, &st->tier[0].open);
+    for (int tier = 0; tier < TS_TIERS; tier++)
+        if (st->tier[tier].fd >= 0) close(st->tier[tier].fd);
+}
+
+void ts_store_append(TsStore *st, int64_t now, const Sample *s) {
+    int v[TS_FIELDS];
+    sample_metrics(s, v);
+    TsBucket b = {now, 1, {0}, {0}, {0}};
+    for (int f = 0; f < TS_FIELDS; f++) {
+        b.min[f] = b.max[f] = v[f];
+        b.sum[f] = v[f] * 100;
+    }
+    ts_add(st, 0, &b);
+}
+
+// min/avg/max of every field over [from, to). Segments outside the range
+// are skipped by name, segments inside it are answered from their header,
+// and only the ones on the edges are decoded.
+int ts_query(const char *dir, int64_t from, int64_t to, int tier) {
+    int64_t *starts = NULL;
+    int count = 0;
+    if (tier < 0) {
+        // Finest tier that keeps the work small and still reaches back to
+        // from; failing that, whichever reaches back furthest (a young
+        // history may only have finer tiers yet)
+        int64_t span = to - from;
+        int best = span <= 2 * 3600 ? 0 : span <= 4 * 86400 ? 1 : 2;
+        int64_t oldest = INT64_MAX;
+        for (int k = 0; k < TS_TIERS; k++) {
+            int t = best + k < TS_TIERS ? best + k : TS_TIERS - 1 - k;   // coarser first, then finer
+            int64_t *s;
+            int n = ts_list(dir, t, &s);
+            if (n > 0 && s[0] < oldest) {
+                free(starts);
+                starts = s;
+                count = n;
+                tier = t;
+                oldest = s[0];
+            } else {
+                free(s);
+            }
+            if (oldest <= from) break;
+        }
+        if (tier < 0) tier = best;
+    } else {
+        count = ts_list(dir, tier, &starts);
+    }
+
+    TsBucket total = {0};
+    int decoded = 0, skipped = 0;
+    for (int i = 0; i < count; i++) {
+        // Segment i ends where segment i + 1 begins
+        if (starts[i] >= to || (i + 1 < count && starts[i + 1] <= from)) {
+            skipped++;
+            continue;
+        }
+        char path[320];
+        ts_path(path, sizeof(path), dir, tier, starts[i]);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) continue;
+        TsHeader hdr;
+        if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || hdr.magic != TS_MAGIC) {
+            close(fd);
+            continue;
+        }
+        if (hdr.records > 0 && hdr.first_ts >= from && hdr.last_ts < to) {
+            bucket_merge(&total, &hdr.total);
+        } else if (ts_read_segment(fd, &hdr) == 0) {
+            const uint8_t *p = seg_buf, *end = seg_buf + hdr.used;
+            TsPrev prev = {0};
+            TsBucket b;
+            while (p < end && ts_decode(&prev, &p, end, &b) == 0)
+                if (b.ts >= from && b.ts < to) bucket_merge(&total, &b);
+            decoded++;
+        }
+        close(fd);
+    }
+    free(starts);
+
+    printf("FROM=%lld TO=%lld TIER=%s SAMPLES=%u SEGMENTS=%d DECODED=%d", (long long)from, (long long)to,
+           tier_names[tier], total.n, count - skipped, decoded);
+    for (int f = 0; f < TS_FIELDS; f++) {
+        if (total.n == 0) printf(" %s_MIN= %s_AVG= %s_MAX=", metric_names[f], metric_names[f], metric_names[f]);
+        else printf(" %s_MIN=%d %s_AVG=%.1f %s_MAX=%d", metric_names[f], total.min[f], metric_names[f],
+                    total.sum[f] / 100.0 / total.n, metric_names[f], total.max[f]);
+    }
+    printf("\n");
+    return 0;
+}
+
+// --- SHARED MEMORY EXPORT ---
+// One writer per region. Everything a sample changes is worked out first,
+// so readers only wait for a copy of a few hundred bytes. Errors go to
+// stderr because stdout carries the samples.
+
+_Static_assert(NUM_METRICS <= SHM_MAX_METRICS, "too many metrics for the shared region");
+
+ShmRegion *shm_publish_open(const char *name, int interval_ms) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open shared memory %s.\n", name);
+        return NULL;
+    }
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, sizeof(ShmRegion)) == 0)
+        p = mmap(NULL, sizeof(ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "Cannot map shared memory %s.\n", name);
+        return NULL;
+    }
+    ShmRegion *r = p;
+    int pid = r->writer_pid;
+    if (r->magic == SHM_MAGIC && pid > 0 && pid != getpid() && kill(pid, 0) == 0) {
+        fprintf(stderr, "Sampler %d already publishes to %s, not exporting.\n", pid, name);
+        munmap(p, sizeof(ShmRegion));
+        return NULL;
+    }
+
+    // Readers of an older run keep their mapping and just see it restart
+    uint64_t seq = __atomic_load_n(&r->seq, __ATOMIC_RELAXED) | 1;
+    __atomic_store_n(&r->seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->version = SHM_VERSION;
+    r->nmetrics = NUM_METRICS;
+    r->interval_ms = interval_ms;
+    for (int f = 0; f < NUM_METRICS; f++) snprintf(r->names[f], sizeof(r->names[f]), "%s", metric_names[f]);
+    r->writer_pid = getpid();
+    r->count = 0;
+    r->published_ns = 0;
+    memset(r->samples, 0, sizeof(r->samples));
+    memset(r->avg, 0, sizeof(r->avg));
+    memset(r->min, 0, sizeof(r->min));
+    memset(r->max, 0, sizeof(r->max));
+    __atomic_store_n(&r->seq, seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    return r;
+}
+
+// dt: seconds since the previous sample, for the moving averages
+void shm_publish(ShmRegion *r, const Sample *s, double dt) {
+    int v[NUM_METRICS];
+    sample_metrics(s, v);
+    ShmSample smp;
+    memset(&smp, 0, sizeof(smp));
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    smp.wall_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+    // Only this process writes the region, so it can read it unguarded
+    double avg[SHM_WINDOWS][SHM_MAX_METRICS] = {{0}};
+    int32_t mn[SHM_MAX_METRICS] = {0}, mx[SHM_MAX_METRICS] = {0};
+    uint64_t count = r->count;
+    int kept = count < SHM_HISTORY ? (int)count : SHM_HISTORY - 1;   // the oldest is overwritten
+    for (int f = 0; f < NUM_METRICS; f++) {
+        smp.v[f] = mn[f] = mx[f] = v[f];
+        for (int i = 1; i <= kept; i++) {
+            int32_t old = r->samples[(count - (uint64_t)i) % SHM_HISTORY].v[f];
+            if (old < mn[f]) mn[f] = old;
+            if (old > mx[f]) mx[f] = old;
+        }
+        for (int w = 0; w < SHM_WINDOWS; w++) {
+            double alpha = count == 0 ? 1.0 : dt / (shm_window_secs[w] + dt);
+            avg[w][f] = r->avg[w][f] + alpha * (v[f] - r->avg[w][f]);
+        }
+    }
+
+    uint64_t seq = r->seq;
+    __atomic_store_n(&r->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->samples[count % SHM_HISTORY] = smp;
+    memcpy(r->avg, avg, sizeof(avg));
+    memcpy(r->min, mn, sizeof(mn));
+    memcpy(r->max, mx, sizeof(mx));
+    r->count = count + 1;
+    r->published_ns = shm_now_ns();
+    __atomic_store_n(&r->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// The region stays for readers, marked as no longer updated
+void shm_publish_close(ShmRegion *r) {
+    uint64_t seq = r->seq;
+    __atomic_store_n(&r->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->writer_pid = 0;
+    __atomic_store_n(&r->seq, seq + 2, __ATOMIC_RELEASE);
+    munmap(r, sizeof(ShmRegion));
+}
+
+// --- BENCHMARK ---
+
+int bench(Sampler *s, int n) {
+    Sample smp;
+    double t0 = now_us(), worst = 0;
+    for (int i = 0; i < n; i++) {
+        if (read_sample(s, &smp) < 0) return 1;
+        if (smp.sample_us > worst) worst = smp.sample_us;
+    }
+    double total = now_us() - t0;
+    printf("%d samples in %.0f us: %.1f us per sample, worst %.1f us\n", n, total, total / n, worst);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int interval = -1, count = 0, stream = 0, bench_n = 0, cores = 0, top_n = 0;
+    double budget = DEFAULT_BUDGET_PCT;
+    const char *path = "/", *store_dir = NULL, *query_dir = NULL, *shm_name = NULL;
+    int retain = TS_RETAIN, tier = -1;
+    const char *alert_specs[MAX_RULES];
+    int nalert_specs = 0;
+    double sustain = DEFAULT_SUSTAIN, hyst = DEFAULT_HYSTERESIS, smooth = DEFAULT_SMOOTH, window = DEFAULT_WINDOW;
+    long long from = -3600, to = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stream") == 0) stream = 1;
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) interval = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) path = argv[++i];
+        else if (strcmp(argv[i], "--cores") == 0) cores = 1;
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) top_n = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) budget = atof(argv[++i]);
+        else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) store_dir = argv[++i];
+        else if (strcmp(argv[i], "--retain") == 0 && i + 1 < argc) retain = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--query") == 0 && i + 1 < argc) query_dir = argv[++i];
+        else if (strcmp(argv[i], "--shm") == 0) {
+            shm_name = SHM_DEFAULT_NAME;
+            if (i + 1 < argc && argv[i + 1][0] == '/') shm_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--alert") == 0 && i + 1 < argc && nalert_specs < MAX_RULES)
+            alert_specs[nalert_specs++] = argv[++i];
+        else if (strcmp(argv[i], "--sustain") == 0 && i + 1 < argc) sustain = atof(argv[++i]);
+        else if (strcmp(argv[i], "--hysteresis") == 0 && i + 1 < argc) hyst = atof(argv[++i]);
+        else if (strcmp(argv[i], "--smooth") == 0 && i + 1 < argc) smooth = atof(argv[++i]);
+        else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) window = atof(argv[++i]);
+        else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) from = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) to = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--tier") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            for (tier = TS_TIERS - 1; tier >= 0 && strcmp(name, tier_names[tier]) != 0; tier--) {}
+        }
+        else if (strcmp(argv[i], "--bench") == 0) {
+            bench_n = 1000;
+            if (i + 1 < argc && argv[i + 1][0] != '-') bench_n = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [--stream] [--interval MS] [--count N] [--path DIR] [--bench [N]]\n"
+                   "       [--cores] [--top N] [--budget PCT] [--store DIR] [--retain N]\n"
+                   "       [--alert METRIC:LIMIT[:SUSTAIN[:HYST]]]... [--sustain S] [--hysteresis H]\n"
+                   "       [--smooth S] [--window S] [--shm [NAME]]\n"
+                   "       %s --query DIR [--from T] [--to T] [--tier 1s|1m|1h]\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (query_dir) {
+        long long now = (long long)time(NULL);
+        if (from <= 0) from += now;
+        if (to == 0) to = now + 1;              // up to and including the current second
+        else if (to < 0) to += now;
+        return ts_query(query_dir, from, to, tier);
+    }
+    if (top_n < 0) top_n = 0;
+    if (top_n > MAX_TOP) top_n = MAX_TOP;
+    if (budget <= 0) budget = DEFAULT_BUDGET_PCT;
+
+    static Sampler s;
+    s.want_cores = cores;
+    s.top_n = top_n;
+    if (sampler_open(&s, path) < 0) {
+        sampler_close(&s);
+        return 1;
+    }
+
+    // First read only sets the CPU baseline
+    Sample smp;
+    if (read_sample(&s, &smp) < 0) {
+        printf("Cannot read sample.\n");
+        sampler_close(&s);
+        return 1;
+    }
+
+    int ret = 0;
+    if (bench_n > 0) {
+        ret = bench(&s, bench_n);
+    } else if (stream) {
+        if (interval <= 0) interval = 5000;
+        // Keep our own CPU under budget% of one core: if a sample costs
+        // more, stretch the interval; ease back once it is cheap again
+        int current = interval;
+        double wall0 = now_us(), self0 = self_cpu_us();
+        static TsStore store;
+        static AlertEngine alerts;
+        alerts.smooth = smooth > 0 ? smooth : DEFAULT_SMOOTH;
+        alerts.window_secs = window > 0 ? window : DEFAULT_WINDOW;
+        for (int i = 0; i < nalert_specs; i++) {
+            if (alert_add(&alerts, alert_specs[i], sustain, hyst) < 0) {
+                printf("Bad alert rule: %s\n", alert_specs[i]);
+                sampler_close(&s);
+                return 1;
+            }
+        }
+        if (store_dir && ts_store_open(&store, store_dir, retain) < 0) {
+            sampler_close(&s);
+            return 1;
+        }
+        // Without the export the samples still stream; another sampler may own it
+        ShmRegion *shm = shm_name ? shm_publish_open(shm_name, interval) : NULL;
+        // Being killed must still write the open second and release the
+        // export; no SA_RESTART, so the signal also cuts the sleep short
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = request_stop;
+        sigemptyset(&sa.sa_mask);
+        int stop_signals[] = { SIGTERM, SIGINT, SIGHUP, SIGPIPE };
+        for (int i = 0; i < 4; i++) sigaction(stop_signals[i], &sa, NULL);
+        for (int i = 0; count == 0 || i < count; i++) {
+            sleep_ms(current);
+            if (stop_requested) break;
+            if (read_sample(&s, &smp) < 0) {
+                ret = 1;
+                break;
+            }
+            double wall1 = now_us(), self1 = self_cpu_us();
+            smp.self_cpu = (self1 - self0) * 100.0 / (wall1 - wall0);
+            smp.interval_ms = current;
+            if (store_dir) ts_store_append(&store, (int64_t)time(NULL), &smp);
+            if (alerts.nrules > 0) alert_update(&alerts, &smp, wall1 / 1e6);
+            if (shm) shm_publish(shm, &smp, (wall1 - wall0) / 1e6);
+            print_sample(&s, &smp, &alerts, 1);
+            if (stop_requested) break;
+            wall0 = wall1;
+            self0 = self_cpu_us();      // printing counts towards the next interval
+
+            double cost_ms = smp.self_cpu * current / 100.0;
+            int needed = (int)(cost_ms * 100.0 / budget) + 1;
+            if (needed > current) current = needed;
+            else if (current > interval) current = needed > interval ? needed : interval;
+            if (current > 60000) current = 60000;
+        }
+        if (store_dir) ts_store_close(&store);
+        if (shm) shm_publish_close(shm);
+    } else {
+        if (interval < 0) interval = DEFAULT_INTERVAL_MS;
+        if (interval > 0) sleep_ms(interval);
+        if (read_sample(&s, &smp) < 0) ret = 1;
+        else print_sample(&s, &smp, NULL, 0);
+    }
+
+    sampler_close(&s);
+    return ret;
+}
@@ -0,0 +1,265 @@
+// Shared micro-benchmark harness for the five projects.
+//
+// Each bench_*.c / bench_*.cpp includes a project's source with its main()
+// renamed, then times the project's own functions through bench_run():
+// warmup runs, then repeated timed runs, reported as min/median/p99/mean
+// wall time and, where perf_event_open is allowed, median CPU cycles and
+// instructions. Setup (fresh unsorted data, a rewound input file) runs
+// outside the timed region.
+//
+// Results are JSON lines on stdout, one per benchmark, so two runs can be
+// compared with ./run.sh --compare OLD NEW. A short human summary goes to
+// stderr. Everything the projects print themselves goes to /dev/null.
+//
+// Options every bench binary takes:
+//   --repeats N    timed runs per benchmark (default 30)
+//   --warmup N     untimed runs first (default 3)
+//   --filter STR   only benchmarks whose name contains STR
+//   --scale F      multiply dataset sizes by F (default 1)
+// BENCH_COMMIT in the environment tags each result (run.sh sets it).
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+#define BENCH_DEFAULT_REPEATS 30
+#define BENCH_DEFAULT_WARMUP 3
+
+typedef void (*BenchFn)(void *ctx);
+
+typedef struct {
+    const char *project;
+    const char *commit;
+    const char *filter;
+    int repeats;
+    int warmup;
+    double scale;
+    FILE *out;              // results; the real stdout
+    int cycles_fd;          // -1 when hardware counters are not available
+    int insns_fd;
+    int ran;
+} BenchSuite;
+
+// --- TIMING ---
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline int bench_perf_open(uint64_t config) {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // This thread only: worker threads a benchmark starts are not counted
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)config;
+    return -1;
+#endif
+}
+
+static inline uint64_t bench_perf_read(int fd) {
+    uint64_t v = 0;
+    if (fd < 0 || read(fd, &v, sizeof(v)) != (ssize_t)sizeof(v)) return 0;
+    return v;
+}
+
+static inline int bench_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of a sorted array
+static inline uint64_t bench_pct(const uint64_t *sorted, int n, double p) {
+    int i = (int)(p * n + 0.999999) - 1;
+    if (i < 0) i = 0;
+    if (i >= n) i = n - 1;
+    return sorted[i];
+}
+
+// --- SUITE ---
+
+static inline void bench_init(BenchSuite *b, const char *project, int argc, char **argv) {
+    memset(b, 0, sizeof(*b));
+    b->project = project;
+    b->repeats = BENCH_DEFAULT_REPEATS;
+    b->warmup = BENCH_DEFAULT_WARMUP;
+    b->scale = 1.0;
+    b->commit = getenv("BENCH_COMMIT");
+    if (!b->commit || !b->commit[0]) b->commit = "unknown";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) b->repeats = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) b->warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) b->filter = argv[++i];
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) b->scale = atof(argv[++i]);
+        else fprintf(stderr, "Unknown option %s.\n", argv[i]);
+    }
+    if (b->repeats < 1) b->repeats = BENCH_DEFAULT_REPEATS;
+    if (b->warmup < 0) b->warmup = 0;
+    if (b->scale <= 0) b->scale = 1.0;
+
+    // Keep the real stdout for results and silence the projects' own output
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    b->out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!b->out) b->out = stderr;
+    if (!freopen("/dev/null", "w", stdout)) fprintf(stderr, "Cannot silence stdout.\n");
+
+#ifdef __linux__
+    b->cycles_fd = bench_perf_open(PERF_COUNT_HW_CPU_CYCLES);
+    b->insns_fd = b->cycles_fd >= 0 ? bench_perf_open(PERF_COUNT_HW_INSTRUCTIONS) : -1;
+#else
+    b->cycles_fd = b->insns_fd = -1;
+#endif
+    if (b->cycles_fd < 0)
+        fprintf(stderr, "%s: no hardware counters (perf_event_open), timing only\n", project);
+}
+
+// Dataset size scaled by --scale, never below 1
+static inline long bench_size(const BenchSuite *b, long n) {
+    long v = (long)(n * b->scale);
+    return v < 1 ? 1 : v;
+}
+
+// Runs setup (untimed, may be NULL) then fn, warmup + repeats times.
+// items is the work done by one call of fn, for the per-item figure.
+static inline void bench_run(BenchSuite *b, const char *name, long items,
+                             BenchFn setup, BenchFn fn, void *ctx) {
+    if (b->filter && !strstr(name, b->filter)) return;
+    int n = b->repeats;
+    uint64_t *ns = (uint64_t *)malloc(sizeof(uint64_t) * (size_t)n * 3);
+    if (!ns) {
+        fprintf(stderr, "%s: out of memory\n", name);
+        return;
+    }
+    uint64_t *cycles = ns + n, *insns = ns + 2 * n;
+
+    for (int i = 0; i < b->warmup; i++) {
+        if (setup) setup(ctx);
+        fn(ctx);
+    }
+    double total = 0;
+    for (int i = 0; i < n; i++) {
+        if (setup) setup(ctx);
+        uint64_t c0 = bench_perf_read(b->cycles_fd), i0 = bench_perf_read(b->insns_fd);
+        uint64_t t0 = bench_now_ns();
+        fn(ctx);
+        uint64_t t1 = bench_now_ns();
+        cycles[i] = bench_perf_read(b->cycles_fd) - c0;
+        insns[i] = bench_perf_read(b->insns_fd) - i0;
+        ns[i] = t1 - t0;
+        total += (double)ns[i];
+    }
+    qsort(ns, (size_t)n, sizeof(uint64_t), bench_cmp_u64);
+    qsort(cycles, (size_t)n, sizeof(uint64_t), bench_cmp_u64);
+    qsort(insns, (size_t)n, sizeof(uint64_t), bench_cmp_u64);
+    uint64_t med = bench_pct(ns, n, 0.5), p99 = bench_pct(ns, n, 0.99);
+    double per_item = items > 0 ? (double)med / items : (double)med;
+
+    fprintf(b->out, "{\"project\":\"%s\",\"bench\":\"%s\",\"commit\":\"%s\",\"items\":%ld,"
+                    "\"repeats\":%d,\"min_ns\":%llu,\"median_ns\":%llu,\"p99_ns\":%llu,"
+                    "\"mean_ns\":%.0f,\"ns_per_item\":%.3f,",
+            b->project, name, b->commit, items, n, (unsigned long long)ns[0],
+            (unsigned long long)med, (unsigned long long)p99, total / n, per_item);
+    if (b->cycles_fd >= 0)
+        fprintf(b->out, "\"cycles\":%llu,\"instructions\":%llu}\n",
+                (unsigned long long)bench_pct(cycles, n, 0.5),
+                (unsigned long long)bench_pct(insns, n, 0.5));
+    else
+        fprintf(b->out, "\"cycles\":null,\"instructions\":null}\n");
+    fflush(b->out);
+
+    fprintf(stderr, "%-12s %-28s median %12.3f us  p99 %12.3f us  %10.1f ns/item\n",
+            b->project, name, med / 1e3, p99 / 1e3, per_item);
+    free(ns);
+    b->ran++;
+}
+
+static inline int bench_finish(BenchSuite *b) {
+    if (b->cycles_fd >= 0) close(b->cycles_fd);
+    if (b->insns_fd >= 0) close(b->insns_fd);
+    if (b->out && b->out != stderr) fclose(b->out);
+    return 0;
+}
+
+// --- DATASETS ---
+// Deterministic (xorshift64*), so every commit measures the same data
+
+static inline uint64_t bench_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 2685821657736338717ULL;
+}
+
+static inline void bench_fill_ints(int *data, long n, uint64_t seed, int range) {
+    uint64_t s = seed | 1;
+    for (long i = 0; i < n; i++) data[i] = (int)(bench_rand(&s) % (uint64_t)range);
+}
+
+// Pronounceable "Firstname Lastname" from syllables
+static inline void bench_name(char *buf, size_t size, uint64_t *state) {
+    static const char *syl[] = { "ka", "ri", "mo", "na", "te", "lu", "si", "do",
+                                 "be", "ra", "no", "vi", "ga", "el", "an", "to" };
+    size_t len = 0;
+    for (int word = 0; word < 2; word++) {
+        int parts = 2 + (int)(bench_rand(state) % 3);
+        for (int p = 0; p < parts && len + 3 < size; p++) {
+            const char *s = syl[bench_rand(state) % 16];
+            buf[len++] = p == 0 ? (char)(s[0] - 'a' + 'A') : s[0];
+            buf[len++] = s[1];
+        }
+        if (word == 0 && len + 1 < size) buf[len++] = ' ';
+    }
+    buf[len] = '\0';
+}
+
+// path in TMPDIR (or /tmp) named after the process, so parallel runs do not clash
+static inline void bench_temp_path(char *buf, size_t size, const char *name) {
+    const char *dir = getenv("TMPDIR");
+    if (!dir || !dir[0]) dir = "/tmp";
+    snprintf(buf, size, "%s/bench-%d-%s", dir, (int)getpid(), name);
+}
+
+// One integer per line, the dynamicmath save format
+static inline int bench_write_ints(const char *path, long n, uint64_t seed) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    uint64_t s = seed | 1;
+    for (long i = 0; i < n; i++) fprintf(f, "%d\n", (int)(bench_rand(&s) % 2000001) - 1000000);
+    return fclose(f);
+}
+
+// Interactive functions read their answers from stdin; feed them a fixed text
+static inline void bench_feed_stdin(const char *text) {
+    static FILE *fed;
+    if (fed) fclose(fed);
+    fed = fmemopen((void *)text, strlen(text), "r");
+    if (fed) stdin = fed;
+}
+
+#endif
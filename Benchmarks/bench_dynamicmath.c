@@ -0,0 +1,112 @@
+// Benchmarks for Dynamic Math and Data Processing Engine/dynamicmath.c
+//
+// Build: gcc -O2 bench_dynamicmath.c -o build/bench_dynamicmath
+
+#include "bench.h"
+
+#define main dynamicmath_main
+#include "../Dynamic Math and Data Processing Engine/dynamicmath.c"
+#undef main
+
+typedef struct {
+    int *data;
+    int *pristine;          // unsorted copy restored before every run
+    int size;
+    int sink;
+    char path[256];
+    char out_path[256];
+    char answer[300];       // what the interactive prompt reads
+} MathBench;
+
+static void restore(void *ctx) {
+    MathBench *m = ctx;
+    memcpy(m->data, m->pristine, sizeof(int) * (size_t)m->size);
+}
+
+static void run_sort_asc(void *ctx) {
+    MathBench *m = ctx;
+    sortAsc(m->data, m->size);
+}
+
+static void run_sort_run(void *ctx) {
+    MathBench *m = ctx;
+    sortRun(m->data, m->size, 0);
+}
+
+static void run_search(void *ctx) {
+    MathBench *m = ctx;
+    // Misses scan the whole array, the worst case
+    for (int i = 0; i < 100; i++) m->sink += searchVal(m->data, m->size, -1 - i);
+}
+
+static void run_ops(void *ctx) {
+    MathBench *m = ctx;
+    m->sink += sum(m->data, m->size) + minimum(m->data, m->size) + maximum(m->data, m->size);
+    m->sink += (int)average(m->data, m->size);
+}
+
+static void feed_path(void *ctx) {
+    MathBench *m = ctx;
+    bench_feed_stdin(m->answer);
+}
+
+static void run_load(void *ctx) {
+    MathBench *m = ctx;
+    m->data = loadFile(m->data, &m->size);
+}
+
+static void run_stream_stats(void *ctx) {
+    MathBench *m = ctx;
+    streamStats(m->path);
+}
+
+static void run_external_sort(void *ctx) {
+    MathBench *m = ctx;
+    // 1 MB budget so the file is split into runs and merged
+    externalSort(m->path, m->out_path, 0, 1, NULL);
+}
+
+int main(int argc, char **argv) {
+    BenchSuite b;
+    bench_init(&b, "dynamicmath", argc, argv);
+    MathBench m;
+    memset(&m, 0, sizeof(m));
+
+    // In-memory operations: the bubble sort is O(n^2), so keep it small
+    long n = bench_size(&b, 2000);
+    m.size = (int)n;
+    m.data = malloc(sizeof(int) * (size_t)n);
+    m.pristine = malloc(sizeof(int) * (size_t)n);
+    if (!m.data || !m.pristine) {
+        fprintf(stderr, "Memory allocation error.\n");
+        return 1;
+    }
+    bench_fill_ints(m.pristine, n, 1, 1000000);
+    restore(&m);
+    bench_run(&b, "sortAsc", n, restore, run_sort_asc, &m);
+    bench_run(&b, "sortRun", n, restore, run_sort_run, &m);
+    bench_run(&b, "searchVal_miss", n * 100, restore, run_search, &m);
+    bench_run(&b, "sum_min_max_avg", n, restore, run_ops, &m);
+    free(m.pristine);
+
+    // File paths: loadFile grows the array one value at a time
+    long rows = bench_size(&b, 200000);
+    bench_temp_path(m.path, sizeof(m.path), "ints.txt");
+    bench_temp_path(m.out_path, sizeof(m.out_path), "sorted.txt");
+    if (bench_write_ints(m.path, rows, 2) != 0) {
+        fprintf(stderr, "Cannot write %s.\n", m.path);
+        return 1;
+    }
+    snprintf(m.answer, sizeof(m.answer), "%s\n", m.path);
+    bench_run(&b, "loadFile", rows, feed_path, run_load, &m);
+    bench_run(&b, "streamStats", rows, NULL, run_stream_stats, &m);
+
+    long big = bench_size(&b, 1000000);
+    if (bench_write_ints(m.path, big, 3) == 0)
+        bench_run(&b, "externalSort_1MB", big, NULL, run_external_sort, &m);
+
+    unlink(m.path);
+    unlink(m.out_path);
+    free(m.data);
+    return bench_finish(&b);
+}
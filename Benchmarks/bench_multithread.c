@@ -0,0 +1,157 @@
+// Benchmarks for Multi-threaded Web Scraper/multithread.c
+//
+// Every request goes to a loopback stand-in server (the scraper's own
+// --bench-stream server), so the numbers do not depend on the network.
+//
+// Build: gcc -O2 -pthread bench_multithread.c -o build/bench_multithread
+
+#include "bench.h"
+#include <dirent.h>
+#include <limits.h>
+#include <signal.h>
+
+#define main multithread_main
+#include "../Multi-threaded Web Scraper/multithread.c"
+#undef main
+
+#define BENCH_THREADS 4
+#define BENCH_URLS 64               // URLs per fetch_url run
+
+typedef struct {
+    int listen_fd;
+    BenchServer server;
+    pthread_t tid;
+    char url[64];
+} StandIn;
+
+typedef struct {
+    StandIn *site;
+    int nthreads;
+    char dir[256];
+} FetchBench;
+
+// Serves body_size bytes to every connection until stand_in_stop()
+static int stand_in_start(StandIn *si, long long body_size) {
+    si->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (si->listen_fd < 0 || bind(si->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(si->listen_fd, 128) < 0 ||
+        getsockname(si->listen_fd, (struct sockaddr *)&addr, &alen) < 0) {
+        perror("Stand-in server");
+        return -1;
+    }
+    si->server.listen_fd = si->listen_fd;
+    si->server.body_size = body_size;
+    si->server.connections = INT_MAX;
+    snprintf(si->url, sizeof(si->url), "http://127.0.0.1:%d/page", ntohs(addr.sin_port));
+    return pthread_create(&si->tid, NULL, bench_server, &si->server) == 0 ? 0 : -1;
+}
+
+static void stand_in_stop(StandIn *si) {
+    // Wakes the blocked accept() with an error, which ends the server loop
+    shutdown(si->listen_fd, SHUT_RDWR);
+    pthread_join(si->tid, NULL);
+    close(si->listen_fd);
+}
+
+// A distinct query string per URL, as a crawl would produce
+static void queue_urls(void *ctx) {
+    FetchBench *fb = ctx;
+    static int serial;
+    char url[128];
+    for (int i = 0; i < BENCH_URLS; i++) {
+        snprintf(url, sizeof(url), "%s?n=%d", fb->site->url, serial++);
+        sched_add(&sched, url, 0);
+    }
+}
+
+static void run_workers_once(void *ctx) {
+    FetchBench *fb = ctx;
+    run_workers(fb->nthreads);
+}
+
+static void run_fetch_memory(void *ctx) {
+    FetchBench *fb = ctx;
+    char *data = NULL;
+    size_t len = 0;
+    int status;
+    ReqTiming timing;
+    if (fetch_to_memory(fb->site->url, &data, &len, &status, &timing) == 0) free(data);
+}
+
+static void run_fetch_files(void *ctx) {
+    FetchBench *fb = ctx;
+    FetchResult res;
+    if (fetch_to_files(fb->site->url, OUT_SPLICE, &res) == 0) {
+        char name[64];
+        snprintf(name, sizeof(name), "output_%s.txt", res.key);
+        unlink(name);
+        snprintf(name, sizeof(name), "output_%s.hdr", res.key);
+        unlink(name);
+    }
+}
+
+static void remove_outputs(const char *dir) {
+    DIR *d = opendir(dir);
+    struct dirent *de;
+    char path[512];
+    while (d && (de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, "output_", 7) != 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        unlink(path);
+    }
+    if (d) closedir(d);
+}
+
+int main(int argc, char **argv) {
+    BenchSuite b;
+    bench_init(&b, "multithread", argc, argv);
+    signal(SIGPIPE, SIG_IGN);
+
+    FetchBench fb;
+    memset(&fb, 0, sizeof(fb));
+    fb.nthreads = BENCH_THREADS;
+
+    // Output files land in a scratch directory
+    bench_temp_path(fb.dir, sizeof(fb.dir), "scrape");
+    if (mkdir(fb.dir, 0755) < 0 || chdir(fb.dir) < 0) {
+        fprintf(stderr, "Cannot use %s.\n", fb.dir);
+        return 1;
+    }
+
+    // No politeness limits: the stand-in is local and the point is the
+    // cost of the fetch path itself
+    if (pool_init(fb.nthreads) < 0 || metrics_init(fb.nthreads, 0, NULL, 0) < 0) {
+        fprintf(stderr, "Memory allocation error.\n");
+        return 1;
+    }
+    sched_init(&sched, 1e9, 1e9, fb.nthreads);
+
+    StandIn page, large;
+    if (stand_in_start(&page, 16 * 1024) < 0 ||
+        stand_in_start(&large, (long long)bench_size(&b, 4) * 1024 * 1024) < 0)
+        return 1;
+
+    fb.site = &page;
+    bench_run(&b, "fetch_to_memory_16KB", 1, NULL, run_fetch_memory, &fb);
+    bench_run(&b, "fetch_to_files_16KB", 1, NULL, run_fetch_files, &fb);
+    quiet = 1;
+    bench_run(&b, "fetch_url_memory_x64", BENCH_URLS, queue_urls, run_workers_once, &fb);
+    quiet = 0;
+    bench_run(&b, "fetch_url_files_x64", BENCH_URLS, queue_urls, run_workers_once, &fb);
+    remove_outputs(".");
+
+    fb.site = &large;
+    bench_run(&b, "fetch_to_files_large", 1, NULL, run_fetch_files, &fb);
+
+    stand_in_stop(&page);
+    stand_in_stop(&large);
+    sched_destroy(&sched);
+    pool_destroy();
+    if (chdir("/") == 0) rmdir(fb.dir);
+    return bench_finish(&b);
+}
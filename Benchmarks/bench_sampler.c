@@ -0,0 +1,148 @@
+// Benchmarks for Automated System Monitoring Shell Script/sampler.c
+//
+// Build: gcc -O2 bench_sampler.c -o build/bench_sampler
+
+#include "bench.h"
+
+#define main sampler_main
+#include "../Automated System Monitoring Shell Script/sampler.c"
+#undef main
+
+typedef struct {
+    Sampler *sampler;
+    Sample smp;
+    AlertEngine alerts;
+    TsStore store;
+    ShmRegion *shm;
+    const ShmRegion *reader;
+    double t;
+    int64_t now;
+    uint64_t rng;
+    char dir[256];
+} SamplerBench;
+
+static void run_read_sample(void *ctx) {
+    SamplerBench *sb = ctx;
+    for (int i = 0; i < 100; i++) read_sample(sb->sampler, &sb->smp);
+}
+
+static void run_read_sample_top(void *ctx) {
+    SamplerBench *sb = ctx;
+    for (int i = 0; i < 10; i++) read_sample(sb->sampler, &sb->smp);
+}
+
+// Synthetic load that wanders across the limits, so rules keep changing state
+static void next_sample(SamplerBench *sb, Sample *s) {
+    memset(s, 0, sizeof(*s));
+    s->cpu = 60 + (int)(bench_rand(&sb->rng) % 41);
+    s->mem = 70 + (int)(bench_rand(&sb->rng) % 20);
+    s->disk_exact = 50.0 + (double)sb->now / 3600.0;
+    s->disk = (int)s->disk_exact;
+    s->io = (int)(bench_rand(&sb->rng) % 100);
+    s->psi_cpu = s->psi_mem = s->psi_io = (int)(bench_rand(&sb->rng) % 30);
+}
+
+static void run_alert_update(void *ctx) {
+    SamplerBench *sb = ctx;
+    Sample s;
+    for (int i = 0; i < 10000; i++) {
+        next_sample(sb, &s);
+        sb->t += 0.25;
+        sb->now++;
+        alert_update(&sb->alerts, &s, sb->t);
+    }
+}
+
+static void run_ts_append(void *ctx) {
+    SamplerBench *sb = ctx;
+    Sample s;
+    for (int i = 0; i < 10000; i++) {
+        next_sample(sb, &s);
+        ts_store_append(&sb->store, sb->now++, &s);
+    }
+}
+
+static void run_ts_query(void *ctx) {
+    SamplerBench *sb = ctx;
+    ts_query(sb->dir, 0, sb->now, -1);
+}
+
+static void run_shm_publish(void *ctx) {
+    SamplerBench *sb = ctx;
+    Sample s;
+    for (int i = 0; i < 1000; i++) {
+        next_sample(sb, &s);
+        shm_publish(sb->shm, &s, 0.25);
+    }
+}
+
+static void run_shm_snapshot(void *ctx) {
+    SamplerBench *sb = ctx;
+    ShmSnapshot snap;
+    for (int i = 0; i < 1000; i++) shm_snapshot(sb->reader, &snap);
+}
+
+static void remove_dir(const char *dir) {
+    DIR *d = opendir(dir);
+    struct dirent *de;
+    char path[512];
+    while (d && (de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        unlink(path);
+    }
+    if (d) closedir(d);
+    rmdir(dir);
+}
+
+int main(int argc, char **argv) {
+    BenchSuite b;
+    bench_init(&b, "sampler", argc, argv);
+    static SamplerBench sb;
+    static Sampler plain, top;
+    sb.rng = 11;
+
+    top.top_n = 5;
+    if (sampler_open(&plain, "/") < 0 || sampler_open(&top, "/") < 0) {
+        fprintf(stderr, "Cannot open /proc files.\n");
+        return 1;
+    }
+    read_sample(&plain, &sb.smp);
+    read_sample(&top, &sb.smp);
+    sb.sampler = &plain;
+    bench_run(&b, "read_sample", 100, NULL, run_read_sample, &sb);
+    sb.sampler = &top;
+    bench_run(&b, "read_sample_top5", 10, NULL, run_read_sample_top, &sb);
+    sampler_close(&plain);
+    sampler_close(&top);
+
+    sb.alerts.smooth = DEFAULT_SMOOTH;
+    sb.alerts.window_secs = DEFAULT_WINDOW;
+    const char *rules[] = { "CPU:80", "MEM:85", "IO:90", "PSI_IO:20", "DISK_FULL:3600" };
+    for (int i = 0; i < 5; i++) alert_add(&sb.alerts, rules[i], DEFAULT_SUSTAIN, DEFAULT_HYSTERESIS);
+    bench_run(&b, "alert_update", 10000, NULL, run_alert_update, &sb);
+
+    bench_temp_path(sb.dir, sizeof(sb.dir), "history");
+    sb.now = 1700000000;
+    if (ts_store_open(&sb.store, sb.dir, TS_RETAIN) == 0) {
+        bench_run(&b, "ts_store_append", 10000, NULL, run_ts_append, &sb);
+        ts_store_close(&sb.store);
+        bench_run(&b, "ts_query", 1, NULL, run_ts_query, &sb);
+    }
+    remove_dir(sb.dir);
+
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/bench-%d", (int)getpid());
+    sb.shm = shm_publish_open(shm_name, 250);
+    sb.reader = sb.shm ? shm_attach(shm_name) : NULL;
+    if (sb.reader) {
+        bench_run(&b, "shm_publish", 1000, NULL, run_shm_publish, &sb);
+        bench_run(&b, "shm_snapshot", 1000, NULL, run_shm_snapshot, &sb);
+        shm_detach(sb.reader);
+    }
+    if (sb.shm) {
+        shm_publish_close(sb.shm);
+        shm_unlink(shm_name);
+    }
+    return bench_finish(&b);
+}
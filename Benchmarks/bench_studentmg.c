@@ -0,0 +1,126 @@
+// Benchmarks for Student Management System/studentmg.c
+//
+// Build: gcc -O2 -pthread bench_studentmg.c -o build/bench_studentmg
+
+#include "bench.h"
+
+#define main studentmg_main
+#include "../Student Management System/studentmg.c"
+#undef main
+
+typedef struct {
+    Student *students;
+    int count;
+    Student *pristine;      // unsorted copy for sort_by_name
+    int pristine_count;
+    int sink;
+    uint64_t rng;
+    char dir[256];
+    char path[512];
+} StudentBench;
+
+// Roster file in the save_to_file format (id|name|grade), ids shuffled
+static int write_roster(const char *path, long n, uint64_t seed) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    uint64_t s = seed | 1;
+    for (long i = 0; i < n; i++) {
+        char name[NAME_LEN];
+        bench_name(name, sizeof(name), &s);
+        long id = 1 + (long)((uint64_t)i * 2654435761u % (uint64_t)n);
+        fprintf(f, "%ld|%s|%.2f\n", id, name, (double)(bench_rand(&s) % 10001) / 100.0);
+    }
+    return fclose(f);
+}
+
+static void run_load(void *ctx) {
+    StudentBench *sb = ctx;
+    sb->students = load_from_file(sb->students, &sb->count, sb->path);
+}
+
+static void run_find_by_id(void *ctx) {
+    StudentBench *sb = ctx;
+    // Random ids, about half of them missing
+    for (int i = 0; i < 100; i++)
+        sb->sink += find_by_id(sb->students, sb->count, 1 + (int)(bench_rand(&sb->rng) % (uint64_t)(2 * sb->count)));
+}
+
+static void feed_name(void *ctx) {
+    (void)ctx;
+    bench_feed_stdin("rAmo\n");
+}
+
+static void run_search_by_name(void *ctx) {
+    StudentBench *sb = ctx;
+    search_by_name(sb->students, sb->count);
+}
+
+static void run_count_below(void *ctx) {
+    StudentBench *sb = ctx;
+    for (int i = 0; i < 1000; i++)
+        sb->sink += grade_index_count_before((float)(bench_rand(&sb->rng) % 10001) / 100.0f, INT_MIN);
+}
+
+static void restore(void *ctx) {
+    StudentBench *sb = ctx;
+    memcpy(sb->pristine, sb->students, sizeof(Student) * (size_t)sb->pristine_count);
+}
+
+static void run_sort_by_name(void *ctx) {
+    StudentBench *sb = ctx;
+    sort_by_name(sb->pristine, sb->pristine_count);
+}
+
+int main(int argc, char **argv) {
+    BenchSuite b;
+    bench_init(&b, "studentmg", argc, argv);
+    StudentBench sb;
+    memset(&sb, 0, sizeof(sb));
+    sb.rng = 7;
+
+    // Autosave writes FILENAME_DEFAULT into the current directory, so
+    // everything lands in a scratch directory
+    bench_temp_path(sb.dir, sizeof(sb.dir), "studentmg");
+    if (mkdir(sb.dir, 0755) < 0 || chdir(sb.dir) < 0) {
+        fprintf(stderr, "Cannot use %s.\n", sb.dir);
+        return 1;
+    }
+
+    long n = bench_size(&b, 100000);
+    snprintf(sb.path, sizeof(sb.path), "%s/roster.txt", sb.dir);
+    if (write_roster(sb.path, n, 5) != 0) {
+        fprintf(stderr, "Cannot write %s.\n", sb.path);
+        return 1;
+    }
+    bench_run(&b, "load_from_file", n, NULL, run_load, &sb);
+    if (sb.count != n) fprintf(stderr, "studentmg: loaded %d of %ld records\n", sb.count, n);
+
+    // Scaling of the parallel loader (files under LOAD_MIN_CHUNK per thread
+    // get fewer threads than asked for)
+    for (int t = 1; t <= 16; t *= 2) {
+        char name[32];
+        snprintf(name, sizeof(name), "load_from_file_t%d", t);
+        load_thread_limit = t;
+        bench_run(&b, name, n, NULL, run_load, &sb);
+    }
+    load_thread_limit = 0;
+
+    bench_run(&b, "find_by_id", 100, NULL, run_find_by_id, &sb);
+    bench_run(&b, "search_by_name", sb.count, feed_name, run_search_by_name, &sb);
+    bench_run(&b, "grade_count_below", 1000, NULL, run_count_below, &sb);
+
+    // Bubble sort of the first 2000 records: a sort_by_name run on the whole
+    // roster would take minutes
+    sb.pristine_count = sb.count < (int)bench_size(&b, 2000) ? sb.count : (int)bench_size(&b, 2000);
+    sb.pristine = malloc(sizeof(Student) * (size_t)sb.pristine_count);
+    if (sb.pristine)
+        bench_run(&b, "sort_by_name", sb.pristine_count, restore, run_sort_by_name, &sb);
+
+    unlink(sb.path);
+    unlink(FILENAME_DEFAULT);
+    if (chdir("/") == 0) rmdir(sb.dir);
+    free(sb.pristine);
+    free(sb.students);
+    grade_index_clear();
+    return bench_finish(&b);
+}
@@ -0,0 +1,105 @@
+// Benchmarks for Smart Traffic Control and Monitoring System/smarttraffic.cpp
+//
+// Builds the sketch through the host simulator, so the plans, stub Arduino
+// layer and arrival generator are the ones ./traffic_sim uses.
+//
+// Build: g++ -O2 -std=c++17 bench_traffic.cpp -o build/bench_traffic
+
+#include "bench.h"
+
+#define main simulator_main
+#include "../Smart Traffic Control and Monitoring System/host/simulator.cpp"
+#undef main
+
+const int BENCH_INTERSECTIONS = 64;
+
+struct TrafficBench {
+  std::vector<Intersection> ixs;
+  std::vector<uint64_t> trace[SIM_LANES];
+  uint64_t durationUs = 0;
+  uint32_t rng = 2463534242u;
+  unsigned long sink = 0;
+};
+
+static uint32_t nextRand(TrafficBench *tb) {
+  tb->rng ^= tb->rng << 13;
+  tb->rng ^= tb->rng >> 17;
+  tb->rng ^= tb->rng << 5;
+  return tb->rng;
+}
+
+static void setupFourWay(Intersection *ix, uint8_t id) {
+  setupIntersection(ix, id, FOUR_WAY_PLAN, sizeof(FOUR_WAY_PLAN) / sizeof(FOUR_WAY_PLAN[0]));
+  for (int i = 0; i < 8; i++) addLane(ix, NO_PIN, NO_PIN, NO_PIN, NO_PIN);
+  startPhase(ix, 0);
+}
+
+// Queues of 0-30 vehicles and arrival gaps of 2-60 s on every lane
+static void randomQueues(void *ctx) {
+  TrafficBench *tb = (TrafficBench *)ctx;
+  for (Intersection &ix : tb->ixs) {
+    for (uint8_t i = 0; i < ix.laneCount; i++) {
+      ix.lanes[i].vehicleCount = (uint16_t)(nextRand(tb) % 31);
+      ix.lanes[i].meanGap = (uint16_t)(2000 + nextRand(tb) % 58000);
+    }
+  }
+}
+
+static void runDynamicTiming(void *ctx) {
+  TrafficBench *tb = (TrafficBench *)ctx;
+  for (Intersection &ix : tb->ixs) {
+    for (uint8_t p = 0; p < ix.phaseCount; p++) {
+      for (uint8_t i = 0; i < ix.laneCount; i++) {
+        dynamicTiming(&ix, &ix.lanes[i], p);
+        tb->sink += ix.lanes[i].greenDuration;
+      }
+    }
+  }
+}
+
+// 100 controller steps of 100 ms for every intersection, ~600 veh/h per lane
+static void runUpdateSignals(void *ctx) {
+  TrafficBench *tb = (TrafficBench *)ctx;
+  const uint32_t arrivalThreshold = (uint32_t)(0xFFFFFFFFu / 60);
+  for (int step = 0; step < 100; step++) {
+    sim::now_us += 100000;
+    for (Intersection &ix : tb->ixs) {
+      for (uint8_t i = 0; i < ix.laneCount; i++)
+        if (nextRand(tb) < arrivalThreshold) vehicleDetected(&ix.lanes[i], millis());
+      updateSignals(&ix);
+    }
+  }
+}
+
+static void runSimulation(void *ctx) {
+  TrafficBench *tb = (TrafficBench *)ctx;
+  RunResult r = runOnce(tb->trace, tb->durationUs, true);
+  tb->sink += (unsigned long)r.loops;
+}
+
+int main(int argc, char **argv) {
+  BenchSuite b;
+  bench_init(&b, "traffic", argc, argv);
+  TrafficBench tb;
+  traceTransitions = false;
+  sim::reset();
+
+  tb.ixs.resize((size_t)bench_size(&b, BENCH_INTERSECTIONS));
+  for (size_t n = 0; n < tb.ixs.size(); n++) setupFourWay(&tb.ixs[n], (uint8_t)n);
+  long calls = (long)tb.ixs.size() * 4 * 8;
+
+  adaptiveTiming = true;
+  bench_run(&b, "dynamicTiming_adaptive", calls, randomQueues, runDynamicTiming, &tb);
+  adaptiveTiming = false;
+  bench_run(&b, "dynamicTiming_formula", calls, randomQueues, runDynamicTiming, &tb);
+  adaptiveTiming = true;
+  bench_run(&b, "updateSignals", (long)tb.ixs.size() * 100, nullptr, runUpdateSignals, &tb);
+
+  // One simulated hour of the four-way junction, 300 veh/h per lane
+  std::mt19937_64 rng(42);
+  tb.durationUs = (uint64_t)(bench_size(&b, 3600)) * 1000000ULL;
+  for (int i = 0; i < SIM_LANES; i++) poissonTrace(tb.trace[i], 300, tb.durationUs, rng);
+  bench_run(&b, "simulate_hour_four_way", 1, nullptr, runSimulation, &tb);
+
+  return bench_finish(&b);
+}
@@ -0,0 +1,88 @@
+#!/bin/bash
+
+# Builds and runs every project's benchmarks and compares two runs.
+#
+# ./run.sh [bench options]             results/COMMIT.jsonl for the checked-out commit
+# ./run.sh --compare OLD NEW [PCT]     median time of each benchmark, NEW against OLD;
+#                                      exits 1 if any is more than PCT% slower (default 10)
+#                                      or missing from NEW
+#
+# A benchmark binary that fails makes ./run.sh exit 1 after the others have run
+#
+# Bench options go to every binary: --repeats N, --warmup N, --filter STR, --scale F
+
+cd "$(dirname "$0")" || exit 1
+
+BUILD_DIR="build"
+RESULTS_DIR="results"
+THRESHOLD=10
+
+# function to compare two result files by project and benchmark name
+compare_results() {
+    awk -v limit="${3:-$THRESHOLD}" '
+    function field(line, key,    m) {
+        if (match(line, "\"" key "\":[^,}]*")) {
+            m = substr(line, RSTART + length(key) + 3, RLENGTH - length(key) - 3)
+            gsub(/"/, "", m)
+            return m
+        }
+        return ""
+    }
+    FNR == 1 { file++ }
+    {
+        key = field($0, "project") "/" field($0, "bench")
+        if (file == 1) { old[key] = field($0, "median_ns"); next }
+        seen[key] = 1
+        if (!(key in old)) { printf "%-44s %14s %14.0f %9s\n", key, "-", field($0, "median_ns"), "new"; next }
+        new = field($0, "median_ns")
+        change = old[key] > 0 ? (new - old[key]) * 100 / old[key] : 0
+        flag = change > limit ? "  SLOWER" : change < -limit ? "  faster" : ""
+        if (change > limit) slower++
+        printf "%-44s %14.0f %14.0f %+8.1f%%%s\n", key, old[key], new, change, flag
+    }
+    BEGIN { printf "%-44s %14s %14s %9s\n", "benchmark", "old ns", "new ns", "change" }
+    END {
+        # a benchmark that crashed or was dropped has no line in NEW
+        for (key in old) if (!(key in seen)) { printf "%-44s %14.0f %14s %9s\n", key, old[key], "-", "MISSING"; missing++ }
+        if (missing) printf "%d benchmark(s) missing from the new results\n", missing
+        if (slower) printf "%d benchmark(s) more than %s%% slower\n", slower, limit
+        if (slower || missing) exit 1
+        print "No regressions over " limit "%"
+    }' "$1" "$2"
+}
+
+if [ "$1" = "--compare" ]; then
+    if [ ! -f "$2" ] || [ ! -f "$3" ]; then
+        echo "Usage: ./run.sh --compare OLD.jsonl NEW.jsonl [PCT]"
+        exit 1
+    fi
+    compare_results "$2" "$3" "$4"
+    exit $?
+fi
+
+# tag results with the commit; uncommitted changes are marked dirty
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if ! git diff --quiet HEAD -- .. 2>/dev/null; then
+    COMMIT="$COMMIT-dirty"
+fi
+export BENCH_COMMIT="$COMMIT"
+
+mkdir -p "$BUILD_DIR" "$RESULTS_DIR"
+echo "Building benchmarks..."
+gcc -O2 bench_dynamicmath.c -o "$BUILD_DIR/bench_dynamicmath" &&
+gcc -O2 -pthread bench_studentmg.c -o "$BUILD_DIR/bench_studentmg" &&
+gcc -O2 bench_sampler.c -o "$BUILD_DIR/bench_sampler" &&
+gcc -O2 -pthread bench_multithread.c -o "$BUILD_DIR/bench_multithread" &&
+g++ -O2 -std=c++17 bench_traffic.cpp -o "$BUILD_DIR/bench_traffic" || exit 1
+
+OUT="$RESULTS_DIR/$COMMIT.jsonl"
+> "$OUT"
+FAILED=0
+for bench in dynamicmath studentmg sampler multithread traffic; do
+    if ! "./$BUILD_DIR/bench_$bench" "$@" >> "$OUT"; then
+        echo "bench_$bench failed"
+        FAILED=1
+    fi
+done
+echo "Results in Benchmarks/$OUT"
+exit $FAILED
@@ -1,5 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+
+/* out-of-core mode: files bigger than memory are streamed, never loaded */
+#define IO_CHUNK 65536              /* bytes per buffered read or write */
+#define DEFAULT_MEM_MB 64           /* memory budget of the external sort */
+#define MERGE_BUFFER 65536          /* bytes of read buffer per run while merging */
+#define MAX_FANIN 256               /* runs merged at once */
 
 /* function pointer types */
 typedef int (*intOperation)(int*, int);
@@ -235,7 +245,519 @@ void show(int *data, int size) {
     printf("\n");
 }
 
-int main() {
+/* buffered text reader for files larger than memory */
+typedef struct {
+    FILE *f;
+    char buf[IO_CHUNK];
+    size_t len, pos;
+    long long bytes;
+    long long line;                 /* for error messages */
+} TextReader;
+
+/* next character, or -1 at end of file */
+int peekChar(TextReader *r) {
+    if (r->pos == r->len) {
+        r->len = fread(r->buf, 1, sizeof(r->buf), r->f);
+        r->pos = 0;
+        r->bytes += r->len;
+        if (r->len == 0) return -1;
+    }
+    return (unsigned char)r->buf[r->pos];
+}
+
+/* next integer; 1 on success, 0 at end of file, -1 (with a message) at
+   anything that is not an int, so a corrupt file is never half processed */
+int readNext(TextReader *r, int *v) {
+    int c;
+    while ((c = peekChar(r)) == ' ' || c == '\n' || c == '\r' || c == '\t') {
+        if (c == '\n') r->line++;
+        r->pos++;
+    }
+    if (c < 0) return 0;
+
+    char token[32];
+    int n = 0;
+    while ((c = peekChar(r)) > ' ') {
+        if (n < (int)sizeof(token) - 1) token[n++] = (char)c;
+        r->pos++;
+    }
+    token[n] = '\0';
+    const char *p = token + (token[0] == '-' || token[0] == '+');
+    long long x = 0;
+    int digits = 0;
+    while (*p >= '0' && *p <= '9' && x <= INT_MAX) {
+        x = x * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (token[0] == '-') x = -x;
+    if (!digits || *p || x < INT_MIN || x > INT_MAX) {
+        printf("Line %lld: \"%s\" is not an integer.\n", r->line, token);
+        return -1;
+    }
+    *v = (int)x;
+    return 1;
+}
+
+/* buffered writer: text lines like saveFile, or raw ints for sorted runs */
+typedef struct {
+    FILE *f;
+    int text;
+    char buf[IO_CHUNK];
+    size_t len;
+    long long bytes;
+    int failed;                     /* a write came up short, e.g. disk full */
+} ValueWriter;
+
+void startWriter(ValueWriter *w, FILE *f, int text) {
+    w->f = f;
+    w->text = text;
+    w->len = 0;
+    w->bytes = 0;
+    w->failed = 0;
+}
+
+void flushWriter(ValueWriter *w) {
+    if (fwrite(w->buf, 1, w->len, w->f) != w->len) w->failed = 1;
+    w->bytes += w->len;
+    w->len = 0;
+}
+
+/* everything written so far is in the file; -1 if any of it did not make
+   it, so a full temp dir never passes for a shorter sorted file */
+int finishWriter(ValueWriter *w) {
+    flushWriter(w);
+    if (fflush(w->f) != 0 || ferror(w->f)) w->failed = 1;
+    return w->failed ? -1 : 0;
+}
+
+void writeValue(ValueWriter *w, int v) {
+    if (w->len + 16 > sizeof(w->buf)) flushWriter(w);
+    if (!w->text) {
+        memcpy(w->buf + w->len, &v, sizeof(int));
+        w->len += sizeof(int);
+        return;
+    }
+    char digits[12];
+    int n = 0;
+    unsigned int u = v < 0 ? 0u - (unsigned int)v : (unsigned int)v;
+    do {
+        digits[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) w->buf[w->len++] = '-';
+    while (n) w->buf[w->len++] = digits[--n];
+    w->buf[w->len++] = '\n';
+}
+
+double seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* stats of a file in one pass and constant memory; 0 on success, -1 on failure */
+int streamStats(const char *name) {
+    FILE *f = fopen(name, "r");
+    if (!f) {
+        printf("Cannot open file.\n");
+        return -1;
+    }
+    TextReader *r = malloc(sizeof(TextReader));
+    if (!r) {
+        printf("Memory allocation error.\n");
+        fclose(f);
+        return -1;
+    }
+    r->f = f;
+    r->len = r->pos = 0;
+    r->bytes = 0;
+    r->line = 1;
+
+    double t0 = seconds();
+    long long count = 0, total = 0, next;
+    long double carry = 0;          /* total moves here before it would overflow */
+    int v, lo = 0, hi = 0, got;
+    while ((got = readNext(r, &v)) > 0) {
+        if (count == 0 || v < lo) lo = v;
+        if (count == 0 || v > hi) hi = v;
+        if (__builtin_add_overflow(total, v, &next)) {
+            carry += total;
+            next = v;
+        }
+        total = next;
+        count++;
+    }
+    double t = seconds() - t0;
+
+    if (got < 0) {
+        printf("Stopped after %lld values.\n", count);
+    } else if (count == 0) {
+        printf("No values in file.\n");
+    } else {
+        printf("Count = %lld\n", count);
+        if (carry == 0) printf("Sum = %lld\n", total);
+        else printf("Sum = %.0Lf\n", carry + total);
+        printf("Average = %.2f\n", (double)((carry + total) / count));
+        printf("Minimum = %d\n", lo);
+        printf("Maximum = %d\n", hi);
+    }
+    printf("Read %.1f MB in %.2f s.\n", r->bytes / 1e6, t);
+    free(r);
+    fclose(f);
+    return got < 0 ? -1 : 0;
+}
+
+/* counters reported after an external sort */
+typedef struct {
+    long long values, runs, passes;
+    long long inputBytes, tempWritten, tempRead, outputBytes;
+} SortStats;
+
+/* in-place quicksort for runs; qsort may allocate a second copy of the
+   run, which would double the memory budget */
+void sortRun(int *data, long n, int desc) {
+    while (n > 16) {
+        /* median of three as pivot */
+        int a = data[0], b = data[n / 2], c = data[n - 1];
+        int pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+        long i = 0, j = n - 1;
+        while (i <= j) {
+            if (desc) {
+                while (data[i] > pivot) i++;
+                while (data[j] < pivot) j--;
+            } else {
+                while (data[i] < pivot) i++;
+                while (data[j] > pivot) j--;
+            }
+            if (i <= j) {
+                int t = data[i];
+                data[i] = data[j];
+                data[j] = t;
+                i++;
+                j--;
+            }
+        }
+        /* recurse into the smaller side, loop on the larger: O(log n) stack */
+        if (j + 1 < n - i) {
+            sortRun(data, j + 1, desc);
+            data += i;
+            n -= i;
+        } else {
+            sortRun(data + i, n - i, desc);
+            n = j + 1;
+        }
+    }
+    for (long i = 1; i < n; i++) {
+        int v = data[i];
+        long j = i - 1;
+        while (j >= 0 && (desc ? data[j] < v : data[j] > v)) {
+            data[j + 1] = data[j];
+            j--;
+        }
+        data[j + 1] = v;
+    }
+}
+
+/* anonymous temp file in dir: unlinked at once, gone when closed */
+FILE *tempRun(const char *dir) {
+    char path[300];
+    snprintf(path, sizeof(path), "%s/dynamicmathXXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd < 0) return NULL;
+    unlink(path);
+    FILE *f = fdopen(fd, "w+b");
+    if (!f) close(fd);
+    return f;
+}
+
+/* one sorted run being merged */
+typedef struct {
+    FILE *f;
+    int *buf;
+    size_t len, pos, cap;
+} RunReader;
+
+int runNext(RunReader *r, SortStats *st, int *v) {
+    if (r->pos == r->len) {
+        r->len = fread(r->buf, sizeof(int), r->cap, r->f);
+        r->pos = 0;
+        st->tempRead += r->len * sizeof(int);
+        if (r->len == 0) return 0;
+    }
+    *v = r->buf[r->pos++];
+    return 1;
+}
+
+/* heap entry: current head value of a run */
+typedef struct {
+    int value;
+    int run;
+} HeapItem;
+
+/* a comes out of the merge before b */
+int heapBefore(HeapItem a, HeapItem b, int desc) {
+    return desc ? a.value > b.value : a.value < b.value;
+}
+
+void siftDown(HeapItem *heap, int n, int i, int desc) {
+    HeapItem item = heap[i];
+    while (2 * i + 1 < n) {
+        int c = 2 * i + 1;
+        if (c + 1 < n && heapBefore(heap[c + 1], heap[c], desc)) c++;
+        if (!heapBefore(heap[c], item, desc)) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = item;
+}
+
+/* k-way merge of sorted runs into out through a min-heap (max-heap when desc) */
+int mergeRuns(FILE **runs, int k, ValueWriter *out, int desc, size_t memBytes, SortStats *st) {
+    size_t cap = memBytes / k / sizeof(int);
+    if (cap < 1024) cap = 1024;
+    RunReader *readers = calloc(k, sizeof(RunReader));
+    HeapItem *heap = malloc(k * sizeof(HeapItem));
+    int *bufs = malloc((size_t)k * cap * sizeof(int));
+    if (!readers || !heap || !bufs) {
+        free(readers);
+        free(heap);
+        free(bufs);
+        printf("Memory allocation error.\n");
+        return -1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < k; i++) {
+        rewind(runs[i]);
+        readers[i].f = runs[i];
+        readers[i].buf = bufs + (size_t)i * cap;
+        readers[i].cap = cap;
+        if (runNext(&readers[i], st, &heap[n].value)) heap[n++].run = i;
+    }
+    for (int i = n / 2 - 1; i >= 0; i--) siftDown(heap, n, i, desc);
+
+    while (n > 0) {
+        writeValue(out, heap[0].value);
+        if (!runNext(&readers[heap[0].run], st, &heap[0].value)) heap[0] = heap[--n];
+        siftDown(heap, n, 0, desc);
+    }
+
+    /* a run that could not be read back ended early, not at its end */
+    int ret = 0;
+    for (int i = 0; i < k; i++)
+        if (ferror(runs[i])) ret = -1;
+    if (ret < 0) printf("Cannot read temp file.\n");
+    free(readers);
+    free(heap);
+    free(bufs);
+    return ret;
+}
+
+/* sort a file of any size into outName using about memMb of memory:
+   sorted runs of memMb are spilled to temp files in tmpDir, then merged */
+int externalSort(const char *inName, const char *outName, int desc, int memMb, const char *tmpDir) {
+    size_t memBytes = (size_t)(memMb > 0 ? memMb : DEFAULT_MEM_MB) * 1024 * 1024;
+    size_t runCap = memBytes / sizeof(int);
+    SortStats st = {0};
+    double t0 = seconds();
+
+    FILE *in = fopen(inName, "r");
+    if (!in) {
+        printf("Cannot open file.\n");
+        return -1;
+    }
+    TextReader *r = malloc(sizeof(TextReader));
+    ValueWriter *w = malloc(sizeof(ValueWriter));
+    int *run = malloc(runCap * sizeof(int));
+    FILE **runs = NULL;
+    int nruns = 0, capRuns = 0, ret = -1;
+    if (!r || !w || !run) {
+        printf("Memory allocation error.\n");
+        goto done;
+    }
+    r->f = in;
+    r->len = r->pos = 0;
+    r->bytes = 0;
+    r->line = 1;
+
+    /* pass 0: fill memory, sort, spill */
+    int eof = 0;
+    while (!eof) {
+        size_t n = 0;
+        int got = 1;
+        while (n < runCap && (got = readNext(r, &run[n])) > 0) n++;
+        if (got < 0) goto done;
+        eof = n < runCap;
+        if (n == 0 && nruns > 0) break;
+        sortRun(run, (long)n, desc);
+        st.values += n;
+
+        if (eof && nruns == 0) {
+            /* everything fit: no temp files at all */
+            FILE *out = fopen(outName, "w");
+            if (!out) {
+                printf("Cannot open file.\n");
+                goto done;
+            }
+            startWriter(w, out, 1);
+            for (size_t i = 0; i < n; i++) writeValue(w, run[i]);
+            int failed = finishWriter(w);
+            if (fclose(out) != 0 || failed) {
+                printf("Cannot write %s.\n", outName);
+                remove(outName);
+                goto done;
+            }
+            st.outputBytes = w->bytes;
+            st.runs = 1;
+            ret = 0;
+            goto done;
+        }
+
+        if (nruns == capRuns) {
+            capRuns = capRuns ? capRuns * 2 : 16;
+            FILE **tmp = realloc(runs, capRuns * sizeof(FILE *));
+            if (!tmp) {
+                printf("Memory allocation error.\n");
+                goto done;
+            }
+            runs = tmp;
+        }
+        FILE *f = tempRun(tmpDir);
+        if (!f) {
+            printf("Cannot create temp file in %s.\n", tmpDir);
+            goto done;
+        }
+        runs[nruns++] = f;
+        startWriter(w, f, 0);
+        for (size_t i = 0; i < n; i++) writeValue(w, run[i]);
+        if (finishWriter(w) < 0) {
+            printf("Cannot write temp file in %s.\n", tmpDir);
+            goto done;
+        }
+        st.tempWritten += w->bytes;
+    }
+    st.runs = nruns;
+    free(run);
+    run = NULL;
+
+    /* merge passes: each run needs a read buffer, so at most
+       memory / MERGE_BUFFER runs are merged at once */
+    int fanin = (int)(memBytes / MERGE_BUFFER);
+    if (fanin > MAX_FANIN) fanin = MAX_FANIN;
+    if (fanin < 2) fanin = 2;
+    while (nruns > fanin) {
+        int merged = 0;
+        for (int i = 0; i < nruns; i += fanin) {
+            int k = nruns - i < fanin ? nruns - i : fanin;
+            FILE *f = tempRun(tmpDir);
+            if (!f) {
+                printf("Cannot create temp file in %s.\n", tmpDir);
+                goto done;
+            }
+            startWriter(w, f, 0);
+            if (mergeRuns(runs + i, k, w, desc, memBytes, &st) < 0) {
+                fclose(f);
+                goto done;
+            }
+            if (finishWriter(w) < 0) {
+                printf("Cannot write temp file in %s.\n", tmpDir);
+                fclose(f);
+                goto done;
+            }
+            st.tempWritten += w->bytes;
+            /* consumed slots are NULL, so a failure later in this pass
+               never closes them twice */
+            for (int j = i; j < i + k; j++) {
+                fclose(runs[j]);
+                runs[j] = NULL;
+            }
+            runs[merged++] = f;
+        }
+        nruns = merged;
+        st.passes++;
+    }
+
+    FILE *out = fopen(outName, "w");
+    if (!out) {
+        printf("Cannot open file.\n");
+        goto done;
+    }
+    startWriter(w, out, 1);
+    int merged = mergeRuns(runs, nruns, w, desc, memBytes, &st) == 0;
+    int written = finishWriter(w) == 0;
+    if (fclose(out) != 0) written = 0;
+    if (merged && !written) printf("Cannot write %s.\n", outName);
+    if (!merged || !written) remove(outName);       /* never leave a truncated result */
+    if (merged && written) {
+        st.outputBytes = w->bytes;
+        st.passes++;
+        ret = 0;
+    }
+
+done:
+    if (ret == 0) {
+        st.inputBytes = r->bytes;
+        printf("Sorted %lld values %s in %.2f s: %lld runs, %lld merge passes, %d MB memory.\n", st.values,
+               desc ? "descending" : "ascending", seconds() - t0, st.runs, st.passes, (int)(memBytes >> 20));
+        printf("I/O: input %.1f MB, temp written %.1f MB, temp read %.1f MB, output %.1f MB.\n",
+               st.inputBytes / 1e6, st.tempWritten / 1e6, st.tempRead / 1e6, st.outputBytes / 1e6);
+    }
+    for (int i = 0; i < nruns; i++)
+        if (runs[i]) fclose(runs[i]);
+    free(runs);
+    free(run);
+    free(w);
+    free(r);
+    fclose(in);
+    return ret;
+}
+
+/* menu: stats of a file without loading it */
+void statsFromFile() {
+    char name[260];
+    printf("Enter filename: ");
+    if (scanf("%259s", name) != 1) return;
+    streamStats(name);
+}
+
+/* menu: sort a file that may not fit in memory */
+void sortFile() {
+    char in[260], out[260];
+    int order, mem;
+    printf("Enter filename to sort: ");
+    if (scanf("%259s", in) != 1) return;
+    printf("Enter output filename: ");
+    if (scanf("%259s", out) != 1) return;
+    printf("Order: 1 ascending 2 descending\nChoice: ");
+    if (scanf("%d", &order) != 1) return;
+    printf("Memory budget in MB: ");
+    if (scanf("%d", &mem) != 1) return;
+    const char *tmp = getenv("TMPDIR");
+    externalSort(in, out, order == 2, mem, tmp ? tmp : "/tmp");
+}
+
+int main(int argc, char **argv) {
+    /* command line out-of-core mode:
+       dynamicmath --stats FILE
+       dynamicmath --sort IN OUT [--desc] [--mem MB] [--tmp DIR] */
+    if (argc >= 3 && strcmp(argv[1], "--stats") == 0) {
+        return streamStats(argv[2]) == 0 ? 0 : 1;
+    }
+    if (argc >= 4 && strcmp(argv[1], "--sort") == 0) {
+        int desc = 0, mem = DEFAULT_MEM_MB;
+        const char *tmp = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--desc") == 0) desc = 1;
+            else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) mem = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--tmp") == 0 && i + 1 < argc) tmp = argv[++i];
+        }
+        return externalSort(argv[2], argv[3], desc, mem, tmp) == 0 ? 0 : 1;
+    }
+    if (argc > 1) {
+        printf("Usage: %s [--stats FILE | --sort IN OUT [--desc] [--mem MB] [--tmp DIR]]\n", argv[0]);
+        return 1;
+    }
+
     int *data = NULL;
     int size = 0;
     int c;
@@ -252,7 +774,9 @@ int main() {
         printf("8 Search value\n");
         printf("9 Save to file\n");
         printf("10 Load from file\n");
-        printf("11 Exit\n");
+        printf("11 Stats from file (streamed)\n");
+        printf("12 Sort file (external)\n");
+        printf("13 Exit\n");
         printf("Choice: ");
 
         if (scanf("%d", &c) != 1) {
@@ -291,7 +815,9 @@ int main() {
         }
         else if (c == 9) saveFile(data, size);
         else if (c == 10) data = loadFile(data, &size);
-        else if (c == 11) break;
+        else if (c == 11) statsFromFile();
+        else if (c == 12) sortFile();
+        else if (c == 13) break;
         else printf("Invalid choice.\n");
     }
 
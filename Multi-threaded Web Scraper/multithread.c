@@ -1,100 +1,2465 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <strings.h>
 #include <pthread.h>
 #include <netdb.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
 
-#define BUFFER_SIZE 4096
-#define NUM_THREADS 3
+#define BUFFER_SIZE 4096                 // old per-recv size, kept as the benchmark baseline
+#define POOL_BUFFER_SIZE (256 * 1024)    // reusable buffer for headers and the copy fallback
+#define PIPE_SIZE (1024 * 1024)          // pipe capacity used for splice
+#define NUM_THREADS 3                    // default number of fetch workers
+#define MAX_THREADS 256
+#define NUM_DEFAULT_URLS 3
 
 // Use ONLY HTTP URLs (HTTPS will fail with raw sockets)
-char *urls[NUM_THREADS] = {
+char *urls[NUM_DEFAULT_URLS] = {
     "http://example.org",
     "http://httpbin.org/html",
     "http://jsonplaceholder.typicode.com/posts"
 };
 
-void *fetch_url(void *arg) {
-    int thread_id = *(int *)arg;
-    char *url = urls[thread_id];
+// How the response body is moved from the socket to its file
+typedef enum {
+    OUT_SPLICE,     // socket -> pipe -> file inside the kernel, falls back to OUT_BUFFERED
+    OUT_BUFFERED,   // recv into a large pooled buffer, then write()
+    OUT_LEGACY      // 4 KB stack buffer + fwrite (the original path, benchmark only)
+} OutputMode;
+
+typedef struct {
+    char host[256];
+    char path[1024];
+    int port;
+} Url;
+
+// Phase timestamps of one request (monotonic seconds, 0 = phase not reached)
+typedef struct {
+    double start, resolved, connected, first_byte, done;
+    double write_sec;           // time spent writing the response out
+} ReqTiming;
 
-    printf("Thread %d: fetching %s...\n", thread_id, url);
+typedef struct {
+    int status;                 // HTTP status code, 0 if the status line was unreadable
+    long long header_bytes;
+    long long body_bytes;
+    int spliced;                // 1 if the body went through splice
+    int is_html;                // Content-Type is text/html
+    char key[17];               // hex URL key used in the file names
+    ReqTiming timing;
+} FetchResult;
 
-    char host[256], path[1024];
-    int port = 80;
+// --- BUFFER POOL ---
+// Large buffers are shared between threads instead of living on each stack.
 
-    // Parse URL manually
-    sscanf(url, "http://%255[^/]/%1023[^\n]", host, path);
+typedef struct {
+    char **slots;
+    int free_count;
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+} BufferPool;
 
-    // Create socket
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        perror("Socket error");
-        pthread_exit(NULL);
+static BufferPool pool;
+
+// One buffer per worker is enough: a worker never holds two at once
+static int pool_init(int count) {
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.available, NULL);
+    pool.free_count = 0;
+    pool.slots = malloc(sizeof(char *) * (size_t)count);
+    if (!pool.slots) return -1;
+    for (int i = 0; i < count; i++) {
+        char *b = malloc(POOL_BUFFER_SIZE);
+        if (!b) return -1;
+        pool.slots[pool.free_count++] = b;
     }
+    return 0;
+}
 
-    // Resolve host
-    struct hostent *server = gethostbyname(host);
-    if (!server) {
-        printf("Thread %d: Failed to resolve host.\n", thread_id);
-        close(sock);
-        pthread_exit(NULL);
+static char *pool_acquire(void) {
+    pthread_mutex_lock(&pool.lock);
+    while (pool.free_count == 0)
+        pthread_cond_wait(&pool.available, &pool.lock);
+    char *b = pool.slots[--pool.free_count];
+    pthread_mutex_unlock(&pool.lock);
+    return b;
+}
+
+static void pool_release(char *b) {
+    pthread_mutex_lock(&pool.lock);
+    pool.slots[pool.free_count++] = b;
+    pthread_cond_signal(&pool.available);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static void pool_destroy(void) {
+    for (int i = 0; i < pool.free_count; i++)
+        free(pool.slots[i]);
+    free(pool.slots);
+    pool.slots = NULL;
+    pool.free_count = 0;
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.available);
+}
+
+// --- HELPERS ---
+
+// Parse http://host[:port][/path]; returns 0 on success
+static int parse_url(const char *url, Url *out) {
+    if (strncmp(url, "http://", 7) != 0) return -1;
+    const char *p = url + 7;
+
+    size_t n = strcspn(p, ":/");
+    if (n == 0 || n >= sizeof(out->host)) return -1;
+    memcpy(out->host, p, n);
+    out->host[n] = '\0';
+    p += n;
+
+    out->port = 80;
+    if (*p == ':') {
+        out->port = atoi(p + 1);
+        p += 1 + strspn(p + 1, "0123456789");
+        if (out->port <= 0 || out->port > 65535) return -1;
+    }
+    if (*p == '/') p++;
+    snprintf(out->path, sizeof(out->path), "%s", p);
+    return 0;
+}
+
+// FNV-1a hash of the URL, so the same URL always maps to the same files
+static uint64_t url_hash(const char *url) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)url; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void url_key(const char *url, char key[17]) {
+    snprintf(key, 17, "%016llx", (unsigned long long)url_hash(url));
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// write_all for sockets: a peer that hung up is an error, not SIGPIPE
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// True if the Content-Type header of a response says HTML
+static int header_is_html(const char *hdr, size_t len) {
+    const char *end = hdr + len;
+    for (const char *line = hdr; line < end; ) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) eol = end;
+        if (eol - line > 13 && strncasecmp(line, "content-type:", 13) == 0) {
+            for (const char *p = line + 13; p + 9 <= eol; p++)
+                if (strncasecmp(p, "text/html", 9) == 0) return 1;
+            return 0;
+        }
+        line = eol + 1;
     }
+    return 0;
+}
 
-    // Connect
-    struct sockaddr_in serv;
-    serv.sin_family = AF_INET;
-    serv.sin_port = htons(port);
-    memcpy(&serv.sin_addr.s_addr, server->h_addr, server->h_length);
+// Resolve and connect; returns the socket, -1 if the host does not resolve,
+// -2 if the connection fails
+static int connect_to(const Url *u, ReqTiming *t) {
+    char port[8];
+    snprintf(port, sizeof(port), "%d", u->port);
 
-    if (connect(sock, (struct sockaddr *)&serv, sizeof(serv)) < 0) {
-        printf("Thread %d: Connection failed.\n", thread_id);
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    // getaddrinfo is thread-safe, gethostbyname is not
+    if (getaddrinfo(u->host, port, &hints, &res) != 0 || !res) return -1;
+    t->resolved = now_sec();
+
+    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
         close(sock);
-        pthread_exit(NULL);
+        sock = -1;
     }
+    freeaddrinfo(res);
+    if (sock < 0) return -2;
+    t->connected = now_sec();
+    return sock;
+}
 
-    // Send GET request
-    char request[2048];
-    snprintf(request, sizeof(request),
-             "GET /%s HTTP/1.1\r\n"
-             "Host: %s\r\n"
-             "Connection: close\r\n\r\n",
-             path, host);
+// --- BODY STREAMING ---
+
+// Moves the rest of the socket into fd with splice.
+// Returns bytes moved, -2 if splice is not supported for these fds, -1 on error.
+// Time spent in the pipe -> file half is added to *write_sec.
+static long long stream_splice(int sock, int fd, double *write_sec) {
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) < 0) return -2;
+    fcntl(p[1], F_SETPIPE_SZ, PIPE_SIZE);
 
-    send(sock, request, strlen(request), 0);
+    long long total = 0;
+    for (;;) {
+        ssize_t n = splice(sock, NULL, p[1], NULL, PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (total == 0 && (errno == EINVAL || errno == ENOSYS)) total = -2;
+            else total = -1;
+            break;
+        }
+        double w0 = now_sec();
+        while (n > 0) {
+            ssize_t m = splice(p[0], NULL, fd, NULL, (size_t)n, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (m <= 0) {
+                if (m < 0 && errno == EINTR) continue;
+                close(p[0]);
+                close(p[1]);
+                return -1;
+            }
+            n -= m;
+            total += m;
+        }
+        *write_sec += now_sec() - w0;
+    }
+    close(p[0]);
+    close(p[1]);
+    return total;
+}
+
+// Copies the rest of the socket into fd through a pooled buffer
+static long long stream_buffered(int sock, int fd, char *buf, double *write_sec) {
+    long long total = 0;
+    ssize_t n;
+    while ((n = recv(sock, buf, POOL_BUFFER_SIZE, 0)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        double w0 = now_sec();
+        if (write_all(fd, buf, (size_t)n) < 0) return -1;
+        *write_sec += now_sec() - w0;
+        total += n;
+    }
+    return total;
+}
 
-    // Save response to file
-    char filename[32];
-    sprintf(filename, "output_%d.txt", thread_id);
+// The original loop: small recv + stdio, headers and body in one file
+static long long stream_legacy(int sock, const char *filename) {
     FILE *fp = fopen(filename, "w");
+    if (!fp) return -1;
 
     char buffer[BUFFER_SIZE];
+    long long total = 0;
     int bytes;
-
     while ((bytes = recv(sock, buffer, BUFFER_SIZE, 0)) > 0) {
         fwrite(buffer, 1, bytes, fp);
+        total += bytes;
     }
-
     fclose(fp);
+    return total;
+}
+
+// --- FETCH ---
+
+// Connect and send the GET for url. Returns the socket, or
+// -1 invalid URL, -2 connection failed, -3 send failed, -7 host not resolved.
+static int open_request(const char *url, ReqTiming *t) {
+    memset(t, 0, sizeof(*t));
+    t->start = now_sec();
+
+    Url u;
+    if (parse_url(url, &u) < 0) return -1;
+
+    int sock = connect_to(&u, t);
+    if (sock == -1) return -7;
+    if (sock < 0) return -2;
+
+    // HTTP/1.0 keeps the body free of chunked encoding, so it can be
+    // spliced straight into the file without being decoded first
+    char request[2048];
+    int len = snprintf(request, sizeof(request),
+                       "GET /%s HTTP/1.0\r\n"
+                       "Host: %s\r\n"
+                       "Connection: close\r\n\r\n",
+                       u.path, u.host);
+    if (send(sock, request, (size_t)len, 0) != len) {
+        close(sock);
+        return -3;
+    }
+    return sock;
+}
+
+// Fetch url and store it as output_<key>.hdr (status line + headers)
+// and output_<key>.txt (body only). Returns 0 on success.
+static int fetch_to_files(const char *url, OutputMode mode, FetchResult *res) {
+    memset(res, 0, sizeof(*res));
+    url_key(url, res->key);
+
+    ReqTiming *t = &res->timing;
+    int sock = open_request(url, t);
+    if (sock < 0) return sock;
+
+    char hdr_name[64], body_name[64];
+    snprintf(hdr_name, sizeof(hdr_name), "output_%s.hdr", res->key);
+    snprintf(body_name, sizeof(body_name), "output_%s.txt", res->key);
+
+    if (mode == OUT_LEGACY) {
+        res->body_bytes = stream_legacy(sock, body_name);
+        t->done = now_sec();
+        close(sock);
+        return res->body_bytes < 0 ? -4 : 0;
+    }
+
+    // Read until the end of the headers; whatever follows is the start of the body
+    char *buf = pool_acquire();
+    size_t have = 0;
+    char *body = NULL;
+    while (have < POOL_BUFFER_SIZE) {
+        ssize_t n = recv(sock, buf + have, POOL_BUFFER_SIZE - have, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        if (have == 0) t->first_byte = now_sec();
+        size_t scan_from = have > 3 ? have - 3 : 0;
+        have += (size_t)n;
+        body = memmem(buf + scan_from, have - scan_from, "\r\n\r\n", 4);
+        if (body) {
+            body += 4;
+            break;
+        }
+    }
+    if (!body) body = buf + have;   // no header terminator: treat everything as headers
+
+    res->header_bytes = body - buf;
+    res->is_html = header_is_html(buf, (size_t)res->header_bytes);
+    sscanf(buf, "HTTP/%*d.%*d %d", &res->status);
+
+    int ret = 0;
+    int hfd = open(hdr_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    int bfd = open(body_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (hfd < 0 || bfd < 0) {
+        ret = -4;
+        goto done;
+    }
+    double w0 = now_sec();
+    if (write_all(hfd, buf, (size_t)res->header_bytes) < 0 ||
+        write_all(bfd, body, (size_t)(buf + have - body)) < 0) {
+        ret = -4;
+        goto done;
+    }
+    t->write_sec += now_sec() - w0;
+    res->body_bytes = buf + have - body;
+
+    long long moved = -2;
+    if (mode == OUT_SPLICE) {
+        moved = stream_splice(sock, bfd, &t->write_sec);
+        res->spliced = moved >= 0;
+    }
+    if (moved == -2) moved = stream_buffered(sock, bfd, buf, &t->write_sec);
+    if (moved < 0) ret = -5;
+    else res->body_bytes += moved;
+    t->done = now_sec();
+
+done:
+    if (hfd >= 0) close(hfd);
+    if (bfd >= 0) close(bfd);
+    pool_release(buf);
     close(sock);
+    return ret;
+}
+
+// Fetch url into a malloc'd buffer holding the full response (headers + body).
+// Returns 0 on success; *out must be freed by the caller.
+static int fetch_to_memory(const char *url, char **out, size_t *out_len, int *status,
+                           ReqTiming *t) {
+    int sock = open_request(url, t);
+    if (sock < 0) return sock;
+
+    size_t cap = POOL_BUFFER_SIZE, len = 0;
+    char *buf = malloc(cap);
+    if (!buf) {
+        close(sock);
+        return -4;
+    }
+    for (;;) {
+        if (len + 1 >= cap) {   // keep room for the terminating NUL
+            char *tmp = realloc(buf, cap * 2);
+            if (!tmp) {
+                free(buf);
+                close(sock);
+                return -4;
+            }
+            buf = tmp;
+            cap *= 2;
+        }
+        ssize_t n = recv(sock, buf + len, cap - 1 - len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            free(buf);
+            close(sock);
+            return -5;
+        }
+        if (n == 0) break;
+        if (len == 0) t->first_byte = now_sec();
+        len += (size_t)n;
+    }
+    t->done = now_sec();
+    close(sock);
+
+    *status = 0;
+    buf[len] = '\0';
+    sscanf(buf, "HTTP/%*d.%*d %d", status);
+    *out = buf;
+    *out_len = len;
+    return 0;
+}
+
+// --- ARCHIVE ---
+// Packs many responses into large append-only segment files
+// (DIR/segment-NNNNN.warc). Each record is a WARC-style text header
+// followed by the raw HTTP response. DIR/index.bin is an open-addressing
+// hash table on disk keyed by URL hash, so a lookup is one or two preads.
+// The writer maps the index and doubles it into a new file past 70% full,
+// so puts stay O(1) however many URLs are archived. Hash matches are
+// confirmed against the record's WARC-Target-URI.
+
+#define ARCHIVE_SEGMENT_SIZE (1024LL * 1024 * 1024)  // roll to a new segment past 1 GB
+#define ARCHIVE_MAX_SEGMENTS 4096
+#define ARCHIVE_INDEX_SLOTS (1u << 16)               // initial size, must be a power of two
+#define ARCHIVE_INDEX_LOAD 0.7                       // grow past this fraction of used slots
+#define OFFSET_BITS 40                               // cursor = segment << 40 | offset
+#define OFFSET_MASK ((1ULL << OFFSET_BITS) - 1)
+
+typedef struct {
+    uint64_t key;       // URL hash, 0 = empty slot
+    uint32_t segment;
+    uint32_t length;    // whole record, header included
+    uint64_t offset;
+} IndexSlot;
+
+typedef struct {
+    char magic[8];
+    uint64_t capacity;
+} IndexHeader;
+
+typedef struct {
+    char dir[512];
+    int compress;
+    uint64_t cursor;                        // next free byte, advanced with CAS
+    int seg_fds[ARCHIVE_MAX_SEGMENTS];      // fd + 1, 0 = not opened yet
+    int index_fd;
+    void *index_map;                        // header + slots, shared with the file
+    IndexSlot *slots;
+    uint64_t index_capacity;
+    uint64_t index_used;
+    pthread_mutex_t open_lock;              // only taken to open a new segment
+    pthread_mutex_t index_lock;
+} Archive;
+
+static Archive *archive = NULL;   // set by --archive, otherwise per-URL files are written
+
+static void segment_path(const Archive *a, uint32_t seg, char *out, size_t size) {
+    snprintf(out, size, "%s/segment-%05u.warc", a->dir, seg);
+}
+
+static int archive_segment_fd(Archive *a, uint32_t seg) {
+    int fd = __atomic_load_n(&a->seg_fds[seg], __ATOMIC_ACQUIRE);
+    if (fd) return fd - 1;
+
+    pthread_mutex_lock(&a->open_lock);
+    fd = a->seg_fds[seg];
+    if (!fd) {
+        char path[600];
+        segment_path(a, seg, path, sizeof(path));
+        int nfd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (nfd >= 0) {
+            fd = nfd + 1;
+            __atomic_store_n(&a->seg_fds[seg], fd, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&a->open_lock);
+    return fd - 1;
+}
+
+static size_t index_bytes(uint64_t capacity) {
+    return sizeof(IndexHeader) + capacity * sizeof(IndexSlot);
+}
+
+// Open and map PATH as an index, creating it with new_capacity empty slots
+static void *index_map_path(const char *path, int flags, uint64_t new_capacity,
+                            int *fd_out, uint64_t *capacity) {
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC | flags, 0644);
+    if (fd < 0) return NULL;
+    IndexHeader h;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, "SCRAPIDX", 8) != 0) {
+        // New index: the slot area stays sparse until it is written
+        memcpy(h.magic, "SCRAPIDX", 8);
+        h.capacity = new_capacity;
+        if (pwrite(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+            ftruncate(fd, (off_t)index_bytes(h.capacity)) < 0) {
+            close(fd);
+            return NULL;
+        }
+    }
+    void *map = mmap(NULL, index_bytes(h.capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    *fd_out = fd;
+    *capacity = h.capacity;
+    return map;
+}
+
+static int index_map_file(Archive *a, uint64_t new_capacity) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/index.bin", a->dir);
+    a->index_map = index_map_path(path, 0, new_capacity, &a->index_fd, &a->index_capacity);
+    if (!a->index_map) return -1;
+    a->slots = (IndexSlot *)((char *)a->index_map + sizeof(IndexHeader));
+    return 0;
+}
+
+static Archive *archive_open(const char *dir, int compress) {
+    mkdir(dir, 0755);
+
+    Archive *a = calloc(1, sizeof(Archive));
+    if (!a) return NULL;
+    snprintf(a->dir, sizeof(a->dir), "%s", dir);
+    a->compress = compress;
+    pthread_mutex_init(&a->open_lock, NULL);
+    pthread_mutex_init(&a->index_lock, NULL);
+
+    // Continue after the last existing segment
+    uint32_t seg = 0;
+    uint64_t size = 0;
+    for (;;) {
+        char path[600];
+        struct stat st;
+        segment_path(a, seg, path, sizeof(path));
+        if (stat(path, &st) < 0) break;
+        size = (uint64_t)st.st_size;
+        seg++;
+    }
+    if (seg > 0) seg--;
+    a->cursor = ((uint64_t)seg << OFFSET_BITS) | size;
+
+    if (index_map_file(a, ARCHIVE_INDEX_SLOTS) < 0) {
+        free(a);
+        return NULL;
+    }
+    for (uint64_t i = 0; i < a->index_capacity; i++)
+        if (a->slots[i].key) a->index_used++;
+    return a;
+}
+
+static void archive_close(Archive *a) {
+    for (int i = 0; i < ARCHIVE_MAX_SEGMENTS; i++)
+        if (a->seg_fds[i]) close(a->seg_fds[i] - 1);
+    munmap(a->index_map, index_bytes(a->index_capacity));
+    close(a->index_fd);
+    pthread_mutex_destroy(&a->open_lock);
+    pthread_mutex_destroy(&a->index_lock);
+    free(a);
+}
+
+// Reserve len bytes; records never straddle segments
+static void archive_reserve(Archive *a, uint64_t len, uint32_t *seg, uint64_t *off) {
+    uint64_t cur = __atomic_load_n(&a->cursor, __ATOMIC_RELAXED);
+    uint64_t next;
+    do {
+        *seg = (uint32_t)(cur >> OFFSET_BITS);
+        *off = cur & OFFSET_MASK;
+        if (*off > 0 && *off + len > ARCHIVE_SEGMENT_SIZE) {
+            (*seg)++;
+            *off = 0;
+        }
+        next = ((uint64_t)*seg << OFFSET_BITS) | (*off + len);
+    } while (!__atomic_compare_exchange_n(&a->cursor, &cur, next, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static uint64_t index_probe_start(uint64_t key, uint64_t capacity) {
+    return (key * 0x9E3779B97F4A7C15ULL) >> 1 & (capacity - 1);
+}
+
+static off_t index_slot_pos(uint64_t i) {
+    return (off_t)(sizeof(IndexHeader) + i * sizeof(IndexSlot));
+}
+
+// 1 if the record a slot points at was written for url
+static int record_has_uri(int fd, const IndexSlot *s, const char *url) {
+    char head[2048];
+    size_t want = s->length < sizeof(head) - 1 ? s->length : sizeof(head) - 1;
+    ssize_t n = pread(fd, head, want, (off_t)s->offset);
+    if (n <= 0) return 0;
+    head[n] = '\0';
+    const char *p = strstr(head, "\r\nWARC-Target-URI: ");
+    if (!p) return 0;
+    p += 19;
+    size_t ul = strlen(url);
+    return strncmp(p, url, ul) == 0 && p[ul] == '\r';
+}
+
+// Rehash into a file twice the size, then swap it in with rename()
+static int archive_index_grow(Archive *a) {
+    char path[600], tmp[610];
+    snprintf(path, sizeof(path), "%s/index.bin", a->dir);
+    snprintf(tmp, sizeof(tmp), "%s.new", path);
+    int fd;
+    uint64_t cap;
+    void *map = index_map_path(tmp, O_TRUNC, a->index_capacity * 2, &fd, &cap);
+    if (!map) return -1;
+    IndexSlot *slots = (IndexSlot *)((char *)map + sizeof(IndexHeader));
+    for (uint64_t j = 0; j < a->index_capacity; j++) {
+        if (a->slots[j].key == 0) continue;
+        uint64_t i = index_probe_start(a->slots[j].key, cap);
+        while (slots[i].key != 0) i = (i + 1) & (cap - 1);
+        slots[i] = a->slots[j];
+    }
+    if (rename(tmp, path) < 0) {
+        munmap(map, index_bytes(cap));
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    munmap(a->index_map, index_bytes(a->index_capacity));
+    close(a->index_fd);
+    a->index_fd = fd;
+    a->index_map = map;
+    a->slots = slots;
+    a->index_capacity = cap;
+    return 0;
+}
+
+// Insert or replace the slot for url; the newest record for a URL wins
+static int archive_index_put(Archive *a, const IndexSlot *slot, const char *url) {
+    int ret = -1;
+    pthread_mutex_lock(&a->index_lock);
+    if ((double)(a->index_used + 1) > a->index_capacity * ARCHIVE_INDEX_LOAD &&
+        archive_index_grow(a) < 0) {
+        pthread_mutex_unlock(&a->index_lock);
+        return -1;
+    }
+    uint64_t i = index_probe_start(slot->key, a->index_capacity);
+    for (uint64_t n = 0; n < a->index_capacity; n++, i = (i + 1) & (a->index_capacity - 1)) {
+        IndexSlot *s = &a->slots[i];
+        if (s->key == 0) a->index_used++;
+        else if (s->key != slot->key) continue;
+        else if (!record_has_uri(archive_segment_fd(a, s->segment), s, url)) continue;
+        *s = *slot;
+        ret = 0;
+        break;
+    }
+    pthread_mutex_unlock(&a->index_lock);
+    return ret;
+}
+
+// Append one response record. Returns 0 on success.
+static int archive_append(Archive *a, const char *url, int status,
+                          const char *data, size_t len, time_t fetched, double secs) {
+    const char *payload = data;
+    size_t payload_len = len;
+    char *packed = NULL;
+
+#ifdef USE_ZLIB
+    if (a->compress) {
+        uLongf clen = compressBound((uLong)len);
+        packed = malloc(clen);
+        if (packed && compress2((Bytef *)packed, &clen, (const Bytef *)data, (uLong)len, 6) == Z_OK) {
+            payload = packed;
+            payload_len = clen;
+        }
+    }
+#endif
+
+    char date[32];
+    struct tm tm;
+    gmtime_r(&fetched, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+    char key[17];
+    url_key(url, key);
+
+    char header[2048];
+    int hl = snprintf(header, sizeof(header),
+                      "WARC/1.0\r\n"
+                      "WARC-Type: response\r\n"
+                      "WARC-Target-URI: %s\r\n"
+                      "WARC-Date: %s\r\n"
+                      "WARC-Record-ID: <urn:scraper:%s>\r\n"
+                      "X-HTTP-Status: %d\r\n"
+                      "X-Fetch-Millis: %.0f\r\n"
+                      "%s"
+                      "X-Uncompressed-Length: %zu\r\n"
+                      "Content-Length: %zu\r\n\r\n",
+                      url, date, key, status, secs * 1000.0,
+                      payload != data ? "Content-Encoding: deflate\r\n" : "",
+                      len, payload_len);
+    if (hl < 0 || hl >= (int)sizeof(header)) {
+        free(packed);
+        return -1;
+    }
+
+    struct iovec iov[3] = {
+        { header, (size_t)hl },
+        { (void *)payload, payload_len },
+        { "\r\n\r\n", 4 }
+    };
+    uint64_t total = (uint64_t)hl + payload_len + 4;
+
+    uint32_t seg;
+    uint64_t off;
+    archive_reserve(a, total, &seg, &off);
+    int ret = -1;
+    if (seg < ARCHIVE_MAX_SEGMENTS) {
+        int fd = archive_segment_fd(a, seg);
+        if (fd >= 0 && pwritev(fd, iov, 3, (off_t)off) == (ssize_t)total) {
+            IndexSlot slot = { url_hash(url), seg, (uint32_t)total, off };
+            if (slot.key == 0) slot.key = 1;
+            ret = archive_index_put(a, &slot, url);
+        }
+    }
+    free(packed);
+    return ret;
+}
+
+// ./multithread --lookup DIR URL : print the archived response for URL
+static int archive_lookup(const char *dir, const char *url) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/index.bin", dir);
+    int ifd = open(path, O_RDONLY | O_CLOEXEC);
+    IndexHeader h;
+    if (ifd < 0 || pread(ifd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+        memcmp(h.magic, "SCRAPIDX", 8) != 0) {
+        printf("No archive index in %s.\n", dir);
+        if (ifd >= 0) close(ifd);
+        return 1;
+    }
+
+    uint64_t key = url_hash(url);
+    if (key == 0) key = 1;
+    IndexSlot s = { 0, 0, 0, 0 };
+    int fd = -1;
+    uint64_t i = index_probe_start(key, h.capacity);
+    for (uint64_t n = 0; n < h.capacity; n++, i = (i + 1) & (h.capacity - 1)) {
+        if (pread(ifd, &s, sizeof(s), index_slot_pos(i)) != (ssize_t)sizeof(s) || s.key == 0) {
+            s.key = 0;
+            break;
+        }
+        if (s.key != key) continue;
+        // Same hash; only the URL in the record itself says it is ours
+        snprintf(path, sizeof(path), "%s/segment-%05u.warc", dir, s.segment);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0 && record_has_uri(fd, &s, url)) break;
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+    close(ifd);
+    if (fd < 0) {
+        printf("URL not in archive.\n");
+        return 1;
+    }
+
+    char *rec = malloc(s.length + 1);
+    if (!rec || pread(fd, rec, s.length, (off_t)s.offset) != (ssize_t)s.length) {
+        printf("Cannot read record from %s.\n", path);
+        if (fd >= 0) close(fd);
+        free(rec);
+        return 1;
+    }
+    close(fd);
+    rec[s.length] = '\0';
+
+    char *payload = strstr(rec, "\r\n\r\n");
+    size_t payload_len = 0, raw_len = 0;
+    char *p;
+    if ((p = strstr(rec, "Content-Length: "))) payload_len = strtoull(p + 16, NULL, 10);
+    if ((p = strstr(rec, "X-Uncompressed-Length: "))) raw_len = strtoull(p + 23, NULL, 10);
+    int deflated = strstr(rec, "Content-Encoding: deflate") != NULL;
+    if (!payload || payload + 4 + payload_len > rec + s.length) {
+        printf("Corrupt record.\n");
+        free(rec);
+        return 1;
+    }
+    payload += 4;
+    fwrite(rec, 1, (size_t)(payload - rec), stderr);   // record header
+
+    int ret = 0;
+    if (!deflated) {
+        fwrite(payload, 1, payload_len, stdout);
+    } else {
+#ifdef USE_ZLIB
+        uLongf out_len = raw_len;
+        char *out = malloc(raw_len ? raw_len : 1);
+        if (out && uncompress((Bytef *)out, &out_len, (const Bytef *)payload, payload_len) == Z_OK) {
+            fwrite(out, 1, out_len, stdout);
+        } else {
+            printf("Decompression failed.\n");
+            ret = 1;
+        }
+        free(out);
+#else
+        (void)raw_len;
+        printf("Record is compressed; rebuild with -DUSE_ZLIB -lz to read it.\n");
+        ret = 1;
+#endif
+    }
+    free(rec);
+    return ret;
+}
+
+// --- SCHEDULER ---
+// Workers never pick URLs themselves; they ask the scheduler for the next job.
+// Each host has a token bucket (rate/burst) and a cap on requests in flight.
+// Hosts with queued work sit in a min-heap ordered by the time they may send
+// their next request, so workers always serve whichever host is ready first.
+
+#define HOST_BUCKETS 1024
+#define DEFAULT_HOST_RATE 2.0      // requests per second per host
+#define DEFAULT_HOST_BURST 2.0
+#define DEFAULT_HOST_IN_FLIGHT 2
+
+struct Host;
+
+typedef struct Job {
+    char *url;
+    int depth;
+    struct Host *host;
+    struct Job *next;
+} Job;
+
+typedef struct Host {
+    char name[272];        // host:port
+    double tokens;
+    double last_refill;
+    double next_eligible;
+    int in_flight;
+    int heap_pos;          // -1 when not in the heap
+    Job *head, *tail;      // queued jobs, FIFO
+    struct Host *next;     // hash chain
+} Host;
+
+typedef struct {
+    double rate;
+    double burst;
+    int max_in_flight;
+    Host *buckets[HOST_BUCKETS];
+    Host **heap;
+    int heap_len, heap_cap;
+    int hosts;             // heap_cap never falls below this
+    int pending;           // queued jobs
+    int running;           // handed to a worker and not finished yet
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} Scheduler;
+
+static Scheduler sched;
+
+static void heap_swap(Scheduler *s, int i, int j) {
+    Host *t = s->heap[i];
+    s->heap[i] = s->heap[j];
+    s->heap[j] = t;
+    s->heap[i]->heap_pos = i;
+    s->heap[j]->heap_pos = j;
+}
+
+static void heap_fix(Scheduler *s, int i) {
+    while (i > 0 && s->heap[(i - 1) / 2]->next_eligible > s->heap[i]->next_eligible) {
+        heap_swap(s, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < s->heap_len && s->heap[l]->next_eligible < s->heap[m]->next_eligible) m = l;
+        if (r < s->heap_len && s->heap[r]->next_eligible < s->heap[m]->next_eligible) m = r;
+        if (m == i) break;
+        heap_swap(s, i, m);
+        i = m;
+    }
+}
+
+static void heap_remove(Scheduler *s, Host *h) {
+    int i = h->heap_pos;
+    heap_swap(s, i, --s->heap_len);
+    h->heap_pos = -1;
+    if (i < s->heap_len) heap_fix(s, i);
+}
+
+static void host_refill(Scheduler *s, Host *h, double now) {
+    h->tokens += (now - h->last_refill) * s->rate;
+    if (h->tokens > s->burst) h->tokens = s->burst;
+    h->last_refill = now;
+}
+
+// Put h in the heap at its next eligible time, or take it out if it cannot send
+static void host_reschedule(Scheduler *s, Host *h, double now) {
+    host_refill(s, h, now);
+    if (!h->head || h->in_flight >= s->max_in_flight) {
+        if (h->heap_pos >= 0) heap_remove(s, h);
+        return;
+    }
+    h->next_eligible = h->tokens >= 1.0 ? now : now + (1.0 - h->tokens) / s->rate;
+    if (h->heap_pos < 0) {
+        // sched_add made room for every host, so this cannot fail
+        h->heap_pos = s->heap_len;
+        s->heap[s->heap_len++] = h;
+    }
+    heap_fix(s, h->heap_pos);
+}
+
+static void sched_init(Scheduler *s, double rate, double burst, int max_in_flight) {
+    memset(s, 0, sizeof(*s));
+    s->rate = rate;
+    s->burst = burst < 1.0 ? 1.0 : burst;
+    s->max_in_flight = max_in_flight < 1 ? 1 : max_in_flight;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s->wake, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void sched_destroy(Scheduler *s) {
+    for (int b = 0; b < HOST_BUCKETS; b++) {
+        Host *h = s->buckets[b];
+        while (h) {
+            Host *next = h->next;
+            while (h->head) {
+                Job *j = h->head;
+                h->head = j->next;
+                free(j->url);
+                free(j);
+            }
+            free(h);
+            h = next;
+        }
+    }
+    free(s->heap);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->wake);
+}
+
+// Queue url for fetching; returns 0 on success
+static int sched_add(Scheduler *s, const char *url, int depth) {
+    Url u;
+    char name[272] = "";
+    if (parse_url(url, &u) == 0) snprintf(name, sizeof(name), "%s:%d", u.host, u.port);
+
+    Job *job = malloc(sizeof(Job));
+    if (!job) return -1;
+    job->url = strdup(url);
+    job->depth = depth;
+    job->next = NULL;
+    if (!job->url) {
+        free(job);
+        return -1;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    uint64_t b = url_hash(name) % HOST_BUCKETS;
+    Host *h = s->buckets[b];
+    while (h && strcmp(h->name, name) != 0) h = h->next;
+    if (!h) {
+        // Grow the heap now, while the failure can still be reported
+        if (s->hosts == s->heap_cap) {
+            int cap = s->heap_cap ? s->heap_cap * 2 : 64;
+            Host **tmp = realloc(s->heap, sizeof(Host *) * (size_t)cap);
+            if (tmp) {
+                s->heap = tmp;
+                s->heap_cap = cap;
+            }
+        }
+        h = s->hosts < s->heap_cap ? calloc(1, sizeof(Host)) : NULL;
+        if (!h) {
+            pthread_mutex_unlock(&s->lock);
+            printf("Memory allocation error, not fetching %s.\n", url);
+            free(job->url);
+            free(job);
+            return -1;
+        }
+        s->hosts++;
+        snprintf(h->name, sizeof(h->name), "%s", name);
+        h->tokens = s->burst;
+        h->last_refill = now_sec();
+        h->heap_pos = -1;
+        h->next = s->buckets[b];
+        s->buckets[b] = h;
+    }
+    job->host = h;
+    if (h->tail) h->tail->next = job;
+    else h->head = job;
+    h->tail = job;
+    s->pending++;
+    host_reschedule(s, h, now_sec());
+    pthread_cond_broadcast(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    return 0;
+}
+
+// Block until a job may be sent. Returns 0 once all work is finished.
+static int sched_next(Scheduler *s, Job **out) {
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        if (s->heap_len == 0) {
+            if (s->pending == 0 && s->running == 0) {
+                pthread_cond_broadcast(&s->wake);
+                pthread_mutex_unlock(&s->lock);
+                return 0;
+            }
+            pthread_cond_wait(&s->wake, &s->lock);
+            continue;
+        }
+
+        Host *h = s->heap[0];
+        double now = now_sec();
+        if (h->next_eligible > now) {
+            struct timespec ts;
+            double t = h->next_eligible;
+            ts.tv_sec = (time_t)t;
+            ts.tv_nsec = (long)((t - (double)ts.tv_sec) * 1e9);
+            pthread_cond_timedwait(&s->wake, &s->lock, &ts);
+            continue;
+        }
+
+        Job *job = h->head;
+        h->head = job->next;
+        if (!h->head) h->tail = NULL;
+        job->next = NULL;
+        host_refill(s, h, now);
+        h->tokens -= 1.0;
+        h->in_flight++;
+        s->pending--;
+        s->running++;
+        host_reschedule(s, h, now);
+
+        pthread_mutex_unlock(&s->lock);
+        *out = job;
+        return 1;
+    }
+}
+
+static void sched_done(Scheduler *s, Job *job) {
+    pthread_mutex_lock(&s->lock);
+    job->host->in_flight--;
+    s->running--;
+    host_reschedule(s, job->host, now_sec());
+    pthread_cond_broadcast(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    free(job->url);
+    free(job);
+}
+
+// Keep the scheduler from reporting "done" while a parser may still add URLs
+static void sched_retain(Scheduler *s) {
+    pthread_mutex_lock(&s->lock);
+    s->running++;
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void sched_release(Scheduler *s) {
+    pthread_mutex_lock(&s->lock);
+    s->running--;
+    pthread_cond_broadcast(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+}
+
+// --- LINK EXTRACTION ---
+
+typedef void (*LinkCallback)(const char *href, size_t len, void *ctx);
+
+static const char *skip_to_tag_end(const char *p, const char *end) {
+    const char *q = memchr(p, '>', (size_t)(end - p));
+    return q ? q + 1 : end;
+}
+
+// Single pass over an HTML buffer, calling emit for the href of every
+// <a> and <area> tag. Comments and <script>/<style> bodies are skipped.
+static void extract_links(const char *p, size_t len, LinkCallback emit, void *ctx) {
+    const char *end = p + len;
+    while (p < end) {
+        p = memchr(p, '<', (size_t)(end - p));
+        if (!p) return;
+        p++;
+
+        if (end - p >= 3 && memcmp(p, "!--", 3) == 0) {
+            const char *c = memmem(p + 3, (size_t)(end - p - 3), "-->", 3);
+            p = c ? c + 3 : end;
+            continue;
+        }
+
+        const char *name = p;
+        while (p < end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')))
+            p++;
+        size_t nlen = (size_t)(p - name);
+
+        if ((nlen == 6 && strncasecmp(name, "script", 6) == 0) ||
+            (nlen == 5 && strncasecmp(name, "style", 5) == 0)) {
+            // Jump to the matching close tag
+            const char *q = p;
+            while ((q = memchr(q, '<', (size_t)(end - q))) != NULL) {
+                if (end - q >= (long)nlen + 2 && q[1] == '/' && strncasecmp(q + 2, name, nlen) == 0)
+                    break;
+                q++;
+            }
+            p = q ? skip_to_tag_end(q, end) : end;
+            continue;
+        }
+
+        int wanted = (nlen == 1 && (*name == 'a' || *name == 'A')) ||
+                     (nlen == 4 && strncasecmp(name, "area", 4) == 0);
+        if (!wanted) {
+            p = skip_to_tag_end(p, end);
+            continue;
+        }
+
+        // Attributes: name[=value] where value is "..", '..' or bare
+        while (p < end && *p != '>') {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '/'))
+                p++;
+            const char *attr = p;
+            while (p < end && *p != '=' && *p != '>' && *p != ' ' && *p != '\t' &&
+                   *p != '\n' && *p != '\r')
+                p++;
+            size_t alen = (size_t)(p - attr);
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                p++;
+            if (p >= end || *p != '=') {
+                if (alen == 0 && p < end && *p != '>') p++;
+                continue;
+            }
+            p++;
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                p++;
+
+            const char *val = p;
+            if (p < end && (*p == '"' || *p == '\'')) {
+                char quote = *p++;
+                val = p;
+                const char *q = memchr(p, quote, (size_t)(end - p));
+                p = q ? q : end;
+                if (alen == 4 && strncasecmp(attr, "href", 4) == 0) emit(val, (size_t)(p - val), ctx);
+                if (p < end) p++;
+            } else {
+                while (p < end && *p != '>' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+                    p++;
+                if (alen == 4 && strncasecmp(attr, "href", 4) == 0) emit(val, (size_t)(p - val), ctx);
+            }
+        }
+        if (p < end) p++;
+    }
+}
+
+// Collapse "." and ".." segments of a path (no leading '/', query kept as is)
+static void remove_dot_segments(char *path) {
+    char *query = strchr(path, '?');
+    char tail[1024] = "";
+    if (query) {
+        snprintf(tail, sizeof(tail), "%s", query);
+        *query = '\0';
+    }
+
+    char out[1024];
+    size_t olen = 0;
+    size_t starts[256];
+    int depth = 0;
+    for (char *seg = path; ; ) {
+        char *slash = strchr(seg, '/');
+        size_t slen = slash ? (size_t)(slash - seg) : strlen(seg);
+        if (slen == 1 && seg[0] == '.') {
+            // current directory: drop
+        } else if (slen == 2 && seg[0] == '.' && seg[1] == '.') {
+            if (depth > 0) olen = starts[--depth];
+        } else if (slen > 0 || slash) {
+            if (depth < 256 && olen + slen + 1 < sizeof(out)) {
+                starts[depth++] = olen;
+                memcpy(out + olen, seg, slen);
+                olen += slen;
+                if (slash) out[olen++] = '/';
+            }
+        }
+        if (!slash) break;
+        seg = slash + 1;
+    }
+    out[olen] = '\0';
+    snprintf(path, 1024, "%s%s", out, tail);
+}
+
+// Resolve href against base into an absolute http:// URL without fragment,
+// lowercase host and no default port. Returns -1 for links to skip
+// (other schemes, empty or fragment-only links, oversized URLs).
+static int normalize_url(const char *base, const char *href, size_t href_len,
+                         char *out, size_t out_size) {
+    char link[1024];
+    size_t n = 0;
+    while (href_len > 0 && (*href == ' ' || *href == '\t' || *href == '\n' || *href == '\r')) {
+        href++;
+        href_len--;
+    }
+    for (size_t i = 0; i < href_len && n < sizeof(link) - 1; i++) {
+        char c = href[i];
+        if (c == '#') break;
+        if (c == '\n' || c == '\r' || c == '\t') continue;
+        if (c == '&' && href_len - i >= 5 && strncmp(href + i, "&amp;", 5) == 0) i += 4;
+        link[n++] = c;
+    }
+    while (n > 0 && link[n - 1] == ' ') n--;
+    link[n] = '\0';
+    if (n == 0) return -1;
+
+    // Any scheme other than http: is skipped
+    size_t sl = strspn(link, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789+.-");
+    char abs[1100];
+    Url u;
+    if (sl > 0 && link[sl] == ':') {
+        if (sl != 4 || strncasecmp(link, "http", 4) != 0) return -1;
+        if (parse_url(link, &u) < 0) {
+            // http:host without slashes is not worth guessing at
+            if (strncasecmp(link, "http://", 7) != 0) return -1;
+            snprintf(abs, sizeof(abs), "http://%s", link + 7);
+            if (parse_url(abs, &u) < 0) return -1;
+        }
+    } else if (link[0] == '/' && link[1] == '/') {
+        snprintf(abs, sizeof(abs), "http:%s", link);
+        if (parse_url(abs, &u) < 0) return -1;
+    } else {
+        if (parse_url(base, &u) < 0) return -1;
+        if (link[0] == '/') {
+            snprintf(u.path, sizeof(u.path), "%s", link + 1);
+        } else if (link[0] == '?') {
+            u.path[strcspn(u.path, "?")] = '\0';
+            size_t pl = strlen(u.path);
+            snprintf(u.path + pl, sizeof(u.path) - pl, "%s", link);
+        } else {
+            u.path[strcspn(u.path, "?")] = '\0';
+            char *dir_end = strrchr(u.path, '/');
+            size_t dl = dir_end ? (size_t)(dir_end - u.path) + 1 : 0;
+            u.path[dl] = '\0';
+            if (dl + strlen(link) >= sizeof(u.path)) return -1;
+            memcpy(u.path + dl, link, strlen(link) + 1);
+        }
+    }
+
+    for (char *h = u.host; *h; h++)
+        if (*h >= 'A' && *h <= 'Z') *h = (char)(*h - 'A' + 'a');
+    remove_dot_segments(u.path);
+
+    int w;
+    if (u.port == 80) w = snprintf(out, out_size, "http://%s/%s", u.host, u.path);
+    else w = snprintf(out, out_size, "http://%s:%d/%s", u.host, u.port, u.path);
+    return (w < 0 || (size_t)w >= out_size) ? -1 : 0;
+}
+
+// --- CRAWL ---
+// Fetched HTML goes to a queue served by parser threads, so link extraction
+// never holds up a fetch worker. Every discovered URL is checked against a
+// Bloom filter first; only when the filter says "maybe seen" is the exact
+// set searched, otherwise the URL is just stored there without comparing
+// against anything. New URLs go back to the scheduler with depth + 1.
+
+#define BLOOM_HASHES 7
+#define DEFAULT_CRAWL_CAPACITY (1 << 20)   // expected distinct URLs, ~1% false positives
+#define DEFAULT_PARSERS 2
+
+typedef struct ParseJob {
+    char *url;
+    int depth;
+    char *data;           // response in memory (archive mode), or NULL
+    size_t len;
+    size_t body_offset;
+    char path[64];        // body file written by fetch_to_files otherwise
+    struct ParseJob *next;
+} ParseJob;
+
+typedef struct SeenUrl {
+    uint64_t hash;
+    char *url;
+} SeenUrl;
+
+typedef struct DomainCount {
+    char host[256];
+    int count;
+    int seed;
+    struct DomainCount *next;
+} DomainCount;
+
+typedef struct {
+    int enabled;
+    int max_depth;
+    int same_domain;          // only follow links to hosts of the seed URLs
+    int max_per_domain;       // 0 = unlimited
+    int nparsers;
+
+    // visited set
+    uint64_t *bloom;
+    uint64_t bloom_mask;      // number of bits - 1
+    SeenUrl *seen;
+    size_t seen_cap, seen_count;
+    DomainCount *domains[HOST_BUCKETS];
+    long long links_found, bloom_new, bloom_maybe, bloom_false_pos, queued;
+    pthread_mutex_t lock;
+
+    // parse queue
+    ParseJob *head, *tail;
+    int closed;
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_ready;
+} Crawl;
+
+static Crawl crawl;
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static int crawl_init(Crawl *c, int max_depth, int same_domain, int max_per_domain,
+                      int nparsers, long capacity) {
+    memset(c, 0, sizeof(*c));
+    c->enabled = 1;
+    c->max_depth = max_depth;
+    c->same_domain = same_domain;
+    c->max_per_domain = max_per_domain;
+    c->nparsers = nparsers;
+
+    uint64_t bits = 64;
+    while (bits < (uint64_t)capacity * 10) bits <<= 1;   // ~10 bits per URL
+    c->bloom = calloc(bits / 64, sizeof(uint64_t));
+    c->bloom_mask = bits - 1;
+    c->seen_cap = 1024;
+    c->seen = calloc(c->seen_cap, sizeof(SeenUrl));
+    if (!c->bloom || !c->seen) return -1;
+
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_mutex_init(&c->queue_lock, NULL);
+    pthread_cond_init(&c->queue_ready, NULL);
+    return 0;
+}
+
+static void crawl_destroy(Crawl *c) {
+    for (size_t i = 0; i < c->seen_cap; i++) free(c->seen[i].url);
+    free(c->seen);
+    free(c->bloom);
+    for (int b = 0; b < HOST_BUCKETS; b++) {
+        DomainCount *d = c->domains[b];
+        while (d) {
+            DomainCount *next = d->next;
+            free(d);
+            d = next;
+        }
+    }
+    pthread_mutex_destroy(&c->lock);
+    pthread_mutex_destroy(&c->queue_lock);
+    pthread_cond_destroy(&c->queue_ready);
+}
+
+// Exact-set insert; returns 1 if url was new. With known_new the set is not
+// searched for url, only for a free slot. Caller holds c->lock.
+static int seen_insert(Crawl *c, const char *url, uint64_t h, int known_new) {
+    if ((c->seen_count + 1) * 10 > c->seen_cap * 7) {
+        size_t cap = c->seen_cap * 2;
+        SeenUrl *t = calloc(cap, sizeof(SeenUrl));
+        if (!t) return 0;
+        for (size_t i = 0; i < c->seen_cap; i++) {
+            if (!c->seen[i].url) continue;
+            size_t j = c->seen[i].hash & (cap - 1);
+            while (t[j].url) j = (j + 1) & (cap - 1);
+            t[j] = c->seen[i];
+        }
+        free(c->seen);
+        c->seen = t;
+        c->seen_cap = cap;
+    }
+    size_t i = h & (c->seen_cap - 1);
+    while (c->seen[i].url) {
+        if (!known_new && c->seen[i].hash == h && strcmp(c->seen[i].url, url) == 0) return 0;
+        i = (i + 1) & (c->seen_cap - 1);
+    }
+    c->seen[i].url = strdup(url);
+    if (!c->seen[i].url) return 0;
+    c->seen[i].hash = h;
+    c->seen_count++;
+    return 1;
+}
+
+// Mark url visited; returns 1 if it had not been seen before. Caller holds c->lock.
+static int visited_add(Crawl *c, const char *url) {
+    uint64_t h1 = url_hash(url), h2 = mix64(h1) | 1;
+    int maybe = 1;
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) & c->bloom_mask;
+        uint64_t m = 1ULL << (bit & 63);
+        if (!(c->bloom[bit >> 6] & m)) {
+            maybe = 0;
+            c->bloom[bit >> 6] |= m;
+        }
+    }
+    if (!maybe) {
+        c->bloom_new++;
+        seen_insert(c, url, h1, 1);
+        return 1;
+    }
+    c->bloom_maybe++;
+    if (seen_insert(c, url, h1, 0)) {
+        c->bloom_false_pos++;
+        return 1;
+    }
+    return 0;
+}
+
+static DomainCount *domain_get(Crawl *c, const char *host) {
+    uint64_t b = url_hash(host) % HOST_BUCKETS;
+    DomainCount *d = c->domains[b];
+    while (d && strcmp(d->host, host) != 0) d = d->next;
+    if (!d) {
+        d = calloc(1, sizeof(DomainCount));
+        if (!d) return NULL;
+        snprintf(d->host, sizeof(d->host), "%s", host);
+        d->next = c->domains[b];
+        c->domains[b] = d;
+    }
+    return d;
+}
+
+// Queue url unless it was seen already or breaks the depth/domain limits
+static int crawl_submit(Crawl *c, const char *url, int depth, int seed) {
+    Url u;
+    if (parse_url(url, &u) < 0) return -1;
+
+    pthread_mutex_lock(&c->lock);
+    DomainCount *d = domain_get(c, u.host);
+    int ok = d != NULL;
+    if (ok && seed) d->seed = 1;
+    if (ok && !seed) {
+        if (depth > c->max_depth) ok = 0;
+        else if (c->same_domain && !d->seed) ok = 0;
+        else if (c->max_per_domain > 0 && d->count >= c->max_per_domain) ok = 0;
+    }
+    if (ok) ok = visited_add(c, url);
+    if (ok) {
+        d->count++;
+        c->queued++;
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    if (!ok) return 1;
+    if (sched_add(&sched, url, depth) < 0) {
+        pthread_mutex_lock(&c->lock);
+        c->queued--;
+        pthread_mutex_unlock(&c->lock);
+        return -1;
+    }
+    return 0;
+}
+
+// Hand a fetched page to the parsers; takes ownership of data
+static void crawl_enqueue(Crawl *c, const char *url, int depth, char *data, size_t len,
+                          size_t body_offset, const char *path) {
+    ParseJob *pj = calloc(1, sizeof(ParseJob));
+    if (!pj || !(pj->url = strdup(url))) {
+        free(pj);
+        free(data);
+        return;
+    }
+    pj->depth = depth;
+    pj->data = data;
+    pj->len = len;
+    pj->body_offset = body_offset;
+    if (path) snprintf(pj->path, sizeof(pj->path), "%s", path);
+
+    sched_retain(&sched);
+    pthread_mutex_lock(&c->queue_lock);
+    if (c->tail) c->tail->next = pj;
+    else c->head = pj;
+    c->tail = pj;
+    pthread_cond_signal(&c->queue_ready);
+    pthread_mutex_unlock(&c->queue_lock);
+}
+
+typedef struct {
+    const char *base;
+    int depth;
+} LinkContext;
+
+static void on_link(const char *href, size_t len, void *arg) {
+    LinkContext *lc = arg;
+    char url[1100];
+    __atomic_fetch_add(&crawl.links_found, 1, __ATOMIC_RELAXED);
+    if (normalize_url(lc->base, href, len, url, sizeof(url)) == 0)
+        crawl_submit(&crawl, url, lc->depth + 1, 0);
+}
+
+static void *parser_thread(void *arg) {
+    Crawl *c = arg;
+    for (;;) {
+        pthread_mutex_lock(&c->queue_lock);
+        while (!c->head && !c->closed)
+            pthread_cond_wait(&c->queue_ready, &c->queue_lock);
+        ParseJob *pj = c->head;
+        if (pj) {
+            c->head = pj->next;
+            if (!c->head) c->tail = NULL;
+        }
+        pthread_mutex_unlock(&c->queue_lock);
+        if (!pj) break;
+
+        LinkContext lc = { pj->url, pj->depth };
+        if (pj->data) {
+            extract_links(pj->data + pj->body_offset, pj->len - pj->body_offset, on_link, &lc);
+        } else {
+            int fd = open(pj->path, O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+                void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (m != MAP_FAILED) {
+                    extract_links(m, (size_t)st.st_size, on_link, &lc);
+                    munmap(m, (size_t)st.st_size);
+                }
+            }
+            if (fd >= 0) close(fd);
+        }
+
+        free(pj->data);
+        free(pj->url);
+        free(pj);
+        sched_release(&sched);
+    }
+    return NULL;
+}
+
+// --- METRICS ---
+// Every worker owns one ThreadMetrics block and is its only writer, so
+// recording a request is a handful of plain relaxed stores, no locks and no
+// shared cache lines. The reporter sums all blocks with relaxed loads.
+// Latencies go into log-linear (HDR-style) histograms of microseconds:
+// 8 sub-buckets per power of two, so every bucket is within 12.5%.
+
+enum { PH_DNS, PH_CONNECT, PH_TTFB, PH_TRANSFER, PH_WRITE, PHASES };
+enum { E_URL, E_DNS, E_CONNECT, E_SEND, E_RECV, E_WRITE, E_HTTP_4XX, E_HTTP_5XX, ERR_CLASSES };
+
+static const char *phase_names[PHASES] = { "dns", "connect", "ttfb", "transfer", "write" };
+static const char *error_names[ERR_CLASSES] = {
+    "bad_url", "dns", "connect", "send", "recv", "write", "http_4xx", "http_5xx"
+};
+
+#define HIST_SUB_BITS 3
+#define HIST_BUCKETS 256
+#define METRICS_CLIENT_TIMEOUT 2    // seconds a metrics client may stall the server
+
+typedef struct {
+    uint64_t hist[PHASES][HIST_BUCKETS];
+    uint64_t max_us[PHASES];
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t errors[ERR_CLASSES];
+} __attribute__((aligned(64))) ThreadMetrics;
+
+typedef struct {
+    ThreadMetrics *threads;
+    int nthreads;
+    int in_flight;
+    double started;
+    double interval;
+    const char *dump_path;      // JSON snapshot rewritten every interval
+    int listen_fd;              // --metrics-port, -1 if off
+    int client_fd;              // connection being served, -1 if none
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} Metrics;
+
+static Metrics metrics;
+
+static int hist_index(uint64_t v) {
+    if (v < (1u << (HIST_SUB_BITS + 1))) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    int sub = (int)((v >> (e - HIST_SUB_BITS)) & ((1u << HIST_SUB_BITS) - 1));
+    int idx = (1 << (HIST_SUB_BITS + 1)) + ((e - HIST_SUB_BITS - 1) << HIST_SUB_BITS) + sub;
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+// Smallest value that lands in bucket idx
+static uint64_t hist_value(int idx) {
+    if (idx < (1 << (HIST_SUB_BITS + 1))) return (uint64_t)idx;
+    int rel = idx - (1 << (HIST_SUB_BITS + 1));
+    int e = (rel >> HIST_SUB_BITS) + HIST_SUB_BITS + 1;
+    uint64_t sub = (uint64_t)(rel & ((1 << HIST_SUB_BITS) - 1));
+    return ((1ULL << HIST_SUB_BITS) + sub) << (e - HIST_SUB_BITS);
+}
+
+// Single-writer increment: the owning worker is the only thread that stores here
+static void bump(uint64_t *p, uint64_t by) {
+    __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + by, __ATOMIC_RELAXED);
+}
+
+static void record_phase(ThreadMetrics *m, int phase, double from, double to) {
+    if (from <= 0 || to < from) return;
+    uint64_t us = (uint64_t)((to - from) * 1e6);
+    bump(&m->hist[phase][hist_index(us)], 1);
+    if (us > __atomic_load_n(&m->max_us[phase], __ATOMIC_RELAXED))
+        __atomic_store_n(&m->max_us[phase], us, __ATOMIC_RELAXED);
+}
+
+static void metrics_record(int thread_id, const ReqTiming *t, uint64_t bytes, int err, int status) {
+    if (!metrics.threads || thread_id >= metrics.nthreads) return;
+    ThreadMetrics *m = &metrics.threads[thread_id];
+
+    bump(&m->requests, 1);
+    bump(&m->bytes, bytes);
+    record_phase(m, PH_DNS, t->start, t->resolved);
+    record_phase(m, PH_CONNECT, t->resolved, t->connected);
+    record_phase(m, PH_TTFB, t->connected, t->first_byte);
+    record_phase(m, PH_TRANSFER, t->first_byte, t->done);
+    if (t->write_sec > 0) record_phase(m, PH_WRITE, 1.0, 1.0 + t->write_sec);
+
+    int cls = -1;
+    switch (err) {
+        case 0:  cls = status >= 500 ? E_HTTP_5XX : status >= 400 ? E_HTTP_4XX : -1; break;
+        case -1: cls = E_URL; break;
+        case -7: cls = E_DNS; break;
+        case -2: cls = E_CONNECT; break;
+        case -3: cls = E_SEND; break;
+        case -5: cls = E_RECV; break;
+        default: cls = E_WRITE; break;
+    }
+    if (cls >= 0) bump(&m->errors[cls], 1);
+}
+
+typedef struct {
+    uint64_t hist[PHASES][HIST_BUCKETS];
+    uint64_t count[PHASES];
+    uint64_t max_us[PHASES];
+    uint64_t requests, bytes, errors[ERR_CLASSES], error_total;
+    int in_flight, queued, parse_backlog;
+    double elapsed;
+} MetricsSnapshot;
+
+static void metrics_snapshot(MetricsSnapshot *s) {
+    memset(s, 0, sizeof(*s));
+    for (int i = 0; i < metrics.nthreads; i++) {
+        ThreadMetrics *m = &metrics.threads[i];
+        for (int p = 0; p < PHASES; p++) {
+            for (int b = 0; b < HIST_BUCKETS; b++) {
+                uint64_t c = __atomic_load_n(&m->hist[p][b], __ATOMIC_RELAXED);
+                s->hist[p][b] += c;
+                s->count[p] += c;
+            }
+            uint64_t mx = __atomic_load_n(&m->max_us[p], __ATOMIC_RELAXED);
+            if (mx > s->max_us[p]) s->max_us[p] = mx;
+        }
+        s->requests += __atomic_load_n(&m->requests, __ATOMIC_RELAXED);
+        s->bytes += __atomic_load_n(&m->bytes, __ATOMIC_RELAXED);
+        for (int e = 0; e < ERR_CLASSES; e++) {
+            uint64_t c = __atomic_load_n(&m->errors[e], __ATOMIC_RELAXED);
+            s->errors[e] += c;
+            s->error_total += c;
+        }
+    }
+    s->in_flight = __atomic_load_n(&metrics.in_flight, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&sched.lock);
+    s->queued = sched.pending;
+    pthread_mutex_unlock(&sched.lock);
+    if (crawl.enabled) {
+        pthread_mutex_lock(&crawl.queue_lock);
+        for (ParseJob *pj = crawl.head; pj; pj = pj->next) s->parse_backlog++;
+        pthread_mutex_unlock(&crawl.queue_lock);
+    }
+    s->elapsed = now_sec() - metrics.started;
+}
+
+static uint64_t snapshot_quantile(const MetricsSnapshot *s, int phase, double q) {
+    if (s->count[phase] == 0) return 0;
+    uint64_t want = (uint64_t)(q * (double)s->count[phase] + 0.5);
+    if (want == 0) want = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += s->hist[phase][b];
+        if (seen >= want) {
+            uint64_t v = b + 1 < HIST_BUCKETS ? hist_value(b + 1) : s->max_us[phase];
+            return v < s->max_us[phase] ? v : s->max_us[phase];
+        }
+    }
+    return s->max_us[phase];
+}
+
+// JSON rendering shared by the dump file and the HTTP endpoint
+static int metrics_json(const MetricsSnapshot *s, char *out, size_t size) {
+    size_t n = 0;
+#define EMIT(...) do { \
+        int w = snprintf(out + n, n < size ? size - n : 0, __VA_ARGS__); \
+        if (w > 0) n += (size_t)w; \
+    } while (0)
+
+    EMIT("{\"elapsed_sec\":%.3f,\"requests\":%llu,\"bytes\":%llu,\"bytes_per_sec\":%.1f,",
+         s->elapsed, (unsigned long long)s->requests, (unsigned long long)s->bytes,
+         s->elapsed > 0 ? (double)s->bytes / s->elapsed : 0.0);
+    EMIT("\"in_flight\":%d,\"queued\":%d,\"parse_backlog\":%d,\"errors\":{",
+         s->in_flight, s->queued, s->parse_backlog);
+    for (int e = 0; e < ERR_CLASSES; e++)
+        EMIT("%s\"%s\":%llu", e ? "," : "", error_names[e], (unsigned long long)s->errors[e]);
+    EMIT("},\"latency_us\":{");
+    for (int p = 0; p < PHASES; p++) {
+        EMIT("%s\"%s\":{\"count\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+             p ? "," : "", phase_names[p], (unsigned long long)s->count[p],
+             (unsigned long long)snapshot_quantile(s, p, 0.50),
+             (unsigned long long)snapshot_quantile(s, p, 0.90),
+             (unsigned long long)snapshot_quantile(s, p, 0.99),
+             (unsigned long long)s->max_us[p]);
+    }
+    EMIT("}}\n");
+#undef EMIT
+    return n < size ? (int)n : -1;
+}
+
+static void metrics_write_dump(const MetricsSnapshot *s) {
+    if (!metrics.dump_path) return;
+    char json[4096], tmp[600];
+    int len = metrics_json(s, json, sizeof(json));
+    if (len < 0) return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", metrics.dump_path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    int ok = write_all(fd, json, (size_t)len) == 0;
+    close(fd);
+    if (ok) rename(tmp, metrics.dump_path);   // readers never see a half-written file
+}
+
+static void metrics_print(const MetricsSnapshot *s, uint64_t prev_bytes, double prev_elapsed) {
+    double dt = s->elapsed - prev_elapsed;
+    printf("[metrics] %.1fs reqs %llu (%.1f/s) %.2f MB/s in-flight %d queued %d errors %llu |",
+           s->elapsed, (unsigned long long)s->requests,
+           s->elapsed > 0 ? (double)s->requests / s->elapsed : 0.0,
+           dt > 0 ? (double)(s->bytes - prev_bytes) / dt / 1e6 : 0.0,
+           s->in_flight, s->queued, (unsigned long long)s->error_total);
+    for (int p = 0; p < PHASES; p++)
+        printf(" %s %.1f/%.1f", phase_names[p],
+               snapshot_quantile(s, p, 0.50) / 1000.0, snapshot_quantile(s, p, 0.99) / 1000.0);
+    printf(" ms p50/p99\n");
+}
+
+// Reporter thread: periodic summary line plus dump file
+static void *metrics_thread(void *arg) {
+    (void)arg;
+    uint64_t prev_bytes = 0;
+    double prev_elapsed = 0;
+    MetricsSnapshot *s = malloc(sizeof(MetricsSnapshot));
+    if (!s) return NULL;
+
+    pthread_mutex_lock(&metrics.lock);
+    while (!metrics.stop) {
+        struct timespec ts;
+        double t = now_sec() + metrics.interval;
+        ts.tv_sec = (time_t)t;
+        ts.tv_nsec = (long)((t - (double)ts.tv_sec) * 1e9);
+        pthread_cond_timedwait(&metrics.wake, &metrics.lock, &ts);
+        if (metrics.stop) break;
+        pthread_mutex_unlock(&metrics.lock);
+
+        metrics_snapshot(s);
+        metrics_print(s, prev_bytes, prev_elapsed);
+        metrics_write_dump(s);
+        prev_bytes = s->bytes;
+        prev_elapsed = s->elapsed;
+
+        pthread_mutex_lock(&metrics.lock);
+    }
+    pthread_mutex_unlock(&metrics.lock);
+    free(s);
+    return NULL;
+}
 
-    printf("Thread %d: saved to %s\n", thread_id, filename);
+// --metrics-port: every connection gets the current JSON snapshot
+static void *metrics_server(void *arg) {
+    (void)arg;
+    MetricsSnapshot *s = malloc(sizeof(MetricsSnapshot));
+    if (!s) return NULL;
+    for (;;) {
+        int fd = accept(metrics.listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        // A client that connects and never sends must not hold up shutdown
+        struct timeval tv = { METRICS_CLIENT_TIMEOUT, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        pthread_mutex_lock(&metrics.lock);
+        int stop = metrics.stop;
+        metrics.client_fd = fd;
+        pthread_mutex_unlock(&metrics.lock);
+        if (stop) {
+            close(fd);
+            break;
+        }
+        char req[1024];
+        recv(fd, req, sizeof(req), 0);
+
+        char json[4096], head[128];
+        metrics_snapshot(s);
+        int len = metrics_json(s, json, sizeof(json));
+        if (len < 0) len = 0;
+        int hl = snprintf(head, sizeof(head),
+                          "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n"
+                          "Content-Length: %d\r\n\r\n", len);
+        if (send_all(fd, head, (size_t)hl) == 0) send_all(fd, json, (size_t)len);
+        pthread_mutex_lock(&metrics.lock);
+        metrics.client_fd = -1;
+        pthread_mutex_unlock(&metrics.lock);
+        close(fd);
+    }
+    free(s);
+    return NULL;
+}
+
+static int metrics_init(int nthreads, double interval, const char *dump_path, int port) {
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.threads = aligned_alloc(64, sizeof(ThreadMetrics) * (size_t)nthreads);
+    if (!metrics.threads) return -1;
+    memset(metrics.threads, 0, sizeof(ThreadMetrics) * (size_t)nthreads);
+    metrics.nthreads = nthreads;
+    metrics.started = now_sec();
+    metrics.interval = interval;
+    metrics.dump_path = dump_path;
+    metrics.listen_fd = -1;
+    metrics.client_fd = -1;
+    pthread_mutex_init(&metrics.lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&metrics.wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (port > 0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)port);
+        int one = 1;
+        metrics.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (metrics.listen_fd >= 0)
+            setsockopt(metrics.listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (metrics.listen_fd < 0 || bind(metrics.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(metrics.listen_fd, 16) < 0) {
+            perror("Metrics port");
+            if (metrics.listen_fd >= 0) close(metrics.listen_fd);
+            metrics.listen_fd = -1;
+        }
+    }
+    return 0;
+}
+
+static pthread_t metrics_tid, metrics_server_tid;
+
+static void metrics_start(void) {
+    if (metrics.interval > 0) pthread_create(&metrics_tid, NULL, metrics_thread, NULL);
+    if (metrics.listen_fd >= 0) pthread_create(&metrics_server_tid, NULL, metrics_server, NULL);
+}
+
+// Stop the reporter, print the final summary (with --metrics-interval) and write the last dump
+static void metrics_finish(void) {
+    pthread_mutex_lock(&metrics.lock);
+    metrics.stop = 1;
+    pthread_cond_broadcast(&metrics.wake);
+    if (metrics.client_fd >= 0) shutdown(metrics.client_fd, SHUT_RDWR);
+    pthread_mutex_unlock(&metrics.lock);
+    if (metrics.interval > 0) pthread_join(metrics_tid, NULL);
+    if (metrics.listen_fd >= 0) {
+        shutdown(metrics.listen_fd, SHUT_RDWR);
+        pthread_join(metrics_server_tid, NULL);
+        close(metrics.listen_fd);
+    }
+
+    MetricsSnapshot *s = malloc(sizeof(MetricsSnapshot));
+    if (s) {
+        metrics_snapshot(s);
+        if (metrics.interval > 0) metrics_print(s, 0, 0);
+        metrics_write_dump(s);
+        free(s);
+    }
+    free(metrics.threads);
+    metrics.threads = NULL;
+    pthread_mutex_destroy(&metrics.lock);
+    pthread_cond_destroy(&metrics.wake);
+}
+
+static int quiet = 0;   // simulation: drop responses and per-URL messages
+
+// Fetch one URL into the archive or its own files, then pass HTML to the parsers
+static void process_url(int thread_id, const Job *job) {
+    const char *url = job->url;
+    int follow = crawl.enabled && job->depth < crawl.max_depth;
+    if (!quiet) printf("Thread %d: fetching %s...\n", thread_id, url);
+
+    int err, status = 0;
+    uint64_t bytes = 0;
+    ReqTiming timing;
+    __atomic_fetch_add(&metrics.in_flight, 1, __ATOMIC_RELAXED);
+    if (archive || quiet) {
+        char *data = NULL;
+        size_t len = 0;
+        time_t fetched = time(NULL);
+        err = fetch_to_memory(url, &data, &len, &status, &timing);
+        if (err == 0) {
+            bytes = len;
+            double w0 = now_sec();
+            if (archive && archive_append(archive, url, status, data, len, fetched,
+                                          timing.done - timing.start) < 0)
+                err = -6;
+            timing.write_sec = archive ? now_sec() - w0 : 0;
+            const char *body = memmem(data, len, "\r\n\r\n", 4);
+            if (err == 0 && follow && body && header_is_html(data, (size_t)(body - data))) {
+                crawl_enqueue(&crawl, url, job->depth, data, len, (size_t)(body + 4 - data), NULL);
+                data = NULL;
+            }
+            free(data);
+        }
+        if (err == 0 && !quiet)
+            printf("Thread %d: HTTP %d, %zu bytes archived in %s\n",
+                   thread_id, status, len, archive->dir);
+    } else {
+        FetchResult res;
+        err = fetch_to_files(url, OUT_SPLICE, &res);
+        timing = res.timing;
+        status = res.status;
+        bytes = (uint64_t)(res.header_bytes + res.body_bytes);
+        if (err == 0) {
+            printf("Thread %d: HTTP %d, %lld body bytes saved to output_%s.txt%s\n",
+                   thread_id, res.status, res.body_bytes, res.key,
+                   res.spliced ? " (zero-copy)" : "");
+            if (follow && res.is_html) {
+                char path[64];
+                snprintf(path, sizeof(path), "output_%s.txt", res.key);
+                crawl_enqueue(&crawl, url, job->depth, NULL, 0, 0, path);
+            }
+        }
+    }
+    __atomic_fetch_sub(&metrics.in_flight, 1, __ATOMIC_RELAXED);
+    metrics_record(thread_id, &timing, bytes, err, status);
+
+    if (err == -1) printf("Thread %d: Invalid URL %s.\n", thread_id, url);
+    else if (err == -7) printf("Thread %d: Failed to resolve host for %s.\n", thread_id, url);
+    else if (err == -2) printf("Thread %d: Connection failed for %s.\n", thread_id, url);
+    else if (err == -6) printf("Thread %d: Archive write failed.\n", thread_id);
+    else if (err < 0) printf("Thread %d: Transfer failed for %s.\n", thread_id, url);
+}
+
+// Worker thread: fetch whatever the scheduler hands out until the queue drains
+void *fetch_url(void *arg) {
+    int thread_id = *(int *)arg;
+    Job *job;
+
+    while (sched_next(&sched, &job)) {
+        process_url(thread_id, job);
+        sched_done(&sched, job);
+    }
     pthread_exit(NULL);
 }
 
-int main() {
-    pthread_t threads[NUM_THREADS];
-    int ids[NUM_THREADS];
+static int run_workers(int nthreads) {
+    pthread_t *threads = malloc(sizeof(pthread_t) * (size_t)nthreads);
+    int *ids = malloc(sizeof(int) * (size_t)nthreads);
+    if (!threads || !ids) {
+        free(threads);
+        free(ids);
+        return -1;
+    }
 
-    for (int i = 0; i < NUM_THREADS; i++) {
+    for (int i = 0; i < nthreads; i++) {
         ids[i] = i;
         pthread_create(&threads[i], NULL, fetch_url, &ids[i]);
     }
-
-    for (int i = 0; i < NUM_THREADS; i++)
+    for (int i = 0; i < nthreads; i++)
         pthread_join(threads[i], NULL);
 
+    free(threads);
+    free(ids);
     return 0;
 }
+
+// Queue a start URL; in crawl mode it is also marked visited
+static int queue_seed(const char *url) {
+    if (crawl.enabled) return crawl_submit(&crawl, url, 0, 1);
+    return sched_add(&sched, url, 0);
+}
+
+// Queue every http:// line of a URL file; returns the number queued
+static int load_url_file(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        printf("Cannot open %s.\n", filename);
+        return 0;
+    }
+    char line[2048];
+    int n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+        if (strncmp(line, "http://", 7) != 0) {
+            printf("Skipping %s (only http:// is supported).\n", line);
+            continue;
+        }
+        if (queue_seed(line) == 0) n++;
+    }
+    fclose(f);
+    return n;
+}
+
+// --- POLITENESS SIMULATION ---
+// ./multithread --simulate [hosts] [urls_per_host]
+// Starts local stand-in servers (one per port, each port is its own host),
+// crawls them through the scheduler and checks, from the servers' own
+// arrival timestamps, that no host saw more than burst + rate * t requests
+// in any window of length t, nor more than the in-flight cap at once.
+
+#define SIM_LATENCY_MS 30
+#define SIM_SLACK_SEC 0.005   // allowance for loopback and wakeup jitter
+
+typedef struct {
+    int listen_fd;
+    int port;
+    double *stamps;
+    int nstamps, cap;
+    int active, max_active;
+    pthread_mutex_t lock;
+} SimServer;
+
+typedef struct {
+    SimServer *server;
+    int fd;
+} SimConn;
+
+static void *sim_conn(void *arg) {
+    SimConn *c = arg;
+    SimServer *s = c->server;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->nstamps == s->cap) {
+        int cap = s->cap ? s->cap * 2 : 64;
+        double *tmp = realloc(s->stamps, sizeof(double) * (size_t)cap);
+        if (tmp) {
+            s->stamps = tmp;
+            s->cap = cap;
+        }
+    }
+    if (s->nstamps < s->cap) s->stamps[s->nstamps++] = now_sec();
+    if (++s->active > s->max_active) s->max_active = s->active;
+    pthread_mutex_unlock(&s->lock);
+
+    char req[2048];
+    size_t got = 0;
+    while (got < sizeof(req) - 1) {
+        ssize_t n = recv(c->fd, req + got, sizeof(req) - 1 - got, 0);
+        if (n <= 0) break;
+        got += (size_t)n;
+        req[got] = '\0';
+        if (strstr(req, "\r\n\r\n")) break;
+    }
+    usleep(SIM_LATENCY_MS * 1000);
+    const char *resp = "HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n<html>ok</html>";
+    write_all(c->fd, resp, strlen(resp));
+
+    pthread_mutex_lock(&s->lock);
+    s->active--;
+    pthread_mutex_unlock(&s->lock);
+    close(c->fd);
+    free(c);
+    return NULL;
+}
+
+static void *sim_accept(void *arg) {
+    SimServer *s = arg;
+    for (;;) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        SimConn *c = malloc(sizeof(SimConn));
+        pthread_t tid;
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->server = s;
+        c->fd = fd;
+        if (pthread_create(&tid, NULL, sim_conn, c) != 0) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        pthread_detach(tid);
+    }
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int simulate(int nhosts, int per_host, int nthreads) {
+    SimServer *servers = calloc((size_t)nhosts, sizeof(SimServer));
+    pthread_t *acceptors = calloc((size_t)nhosts, sizeof(pthread_t));
+    if (!servers || !acceptors) {
+        free(servers);
+        free(acceptors);
+        return 1;
+    }
+
+    for (int h = 0; h < nhosts; h++) {
+        SimServer *s = &servers[h];
+        struct sockaddr_in addr;
+        socklen_t alen = sizeof(addr);
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        pthread_mutex_init(&s->lock, NULL);
+        s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (s->listen_fd < 0 || bind(s->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(s->listen_fd, 128) < 0 ||
+            getsockname(s->listen_fd, (struct sockaddr *)&addr, &alen) < 0) {
+            perror("Simulation server");
+            return 1;
+        }
+        s->port = ntohs(addr.sin_port);
+        pthread_create(&acceptors[h], NULL, sim_accept, s);
+    }
+
+    // Interleave hosts so the queue order alone would hammer each one
+    for (int i = 0; i < per_host; i++) {
+        for (int h = 0; h < nhosts; h++) {
+            char url[128];
+            snprintf(url, sizeof(url), "http://127.0.0.1:%d/page%d", servers[h].port, i);
+            sched_add(&sched, url, 0);
+        }
+    }
+
+    printf("Simulating %d hosts x %d URLs, %d workers, rate %.1f/s, burst %.0f, %d in flight per host\n",
+           nhosts, per_host, nthreads, sched.rate, sched.burst, sched.max_in_flight);
+    quiet = 1;
+    double t0 = now_sec();
+    metrics_start();
+    run_workers(nthreads);
+    double elapsed = now_sec() - t0;
+    metrics_finish();
+
+    int failures = 0;
+    printf("%-6s %-7s %-10s %-12s %s\n", "host", "reqs", "max conc", "min gap ms", "result");
+    for (int h = 0; h < nhosts; h++) {
+        SimServer *s = &servers[h];
+        shutdown(s->listen_fd, SHUT_RDWR);
+        close(s->listen_fd);
+        pthread_join(acceptors[h], NULL);
+        for (;;) {
+            pthread_mutex_lock(&s->lock);
+            int active = s->active;
+            pthread_mutex_unlock(&s->lock);
+            if (active == 0) break;
+            usleep(1000);
+        }
+
+        qsort(s->stamps, (size_t)s->nstamps, sizeof(double), cmp_double);
+        int ok = s->nstamps == per_host && s->max_active <= sched.max_in_flight;
+        double min_gap = 1e9;
+        for (int i = 0; i < s->nstamps; i++) {
+            if (i > 0 && s->stamps[i] - s->stamps[i - 1] < min_gap)
+                min_gap = s->stamps[i] - s->stamps[i - 1];
+            for (int j = i + 1; j < s->nstamps; j++) {
+                double allowed = sched.burst + sched.rate * (s->stamps[j] - s->stamps[i] + SIM_SLACK_SEC);
+                if (j - i + 1 > allowed + 1e-9) ok = 0;
+            }
+        }
+        printf("%-6d %-7d %-10d %-12.1f %s\n", h, s->nstamps, s->max_active,
+               s->nstamps > 1 ? min_gap * 1000.0 : 0.0, ok ? "PASS" : "FAIL");
+        failures += !ok;
+        free(s->stamps);
+        pthread_mutex_destroy(&s->lock);
+    }
+
+    double bound = (per_host - sched.burst) / sched.rate;
+    printf("Elapsed %.2fs (rate limit floor %.2fs), %.1f req/s overall\n",
+           elapsed, bound > 0 ? bound : 0.0, nhosts * per_host / elapsed);
+    printf("%s\n", failures ? "Simulation FAILED" : "Simulation passed");
+
+    free(servers);
+    free(acceptors);
+    return failures ? 1 : 0;
+}
+
+// --- STREAMING BENCHMARK ---
+// ./multithread --bench-stream [MB] [rounds]
+// Serves an MB-sized body from a loopback server and times each output path.
+
+typedef struct {
+    int listen_fd;
+    long long body_size;
+    int connections;
+} BenchServer;
+
+static void *bench_server(void *arg) {
+    BenchServer *s = arg;
+    static char chunk[POOL_BUFFER_SIZE];
+    memset(chunk, 'x', sizeof(chunk));
+
+    for (int c = 0; c < s->connections; c++) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) break;
+
+        char req[2048];
+        size_t got = 0;
+        while (got < sizeof(req) - 1) {
+            ssize_t n = recv(fd, req + got, sizeof(req) - 1 - got, 0);
+            if (n <= 0) break;
+            got += (size_t)n;
+            req[got] = '\0';
+            if (strstr(req, "\r\n\r\n")) break;
+        }
+
+        char header[128];
+        int hl = snprintf(header, sizeof(header),
+                          "HTTP/1.0 200 OK\r\nContent-Length: %lld\r\n\r\n", s->body_size);
+        write_all(fd, header, (size_t)hl);
+        for (long long left = s->body_size; left > 0; ) {
+            size_t n = left < (long long)sizeof(chunk) ? (size_t)left : sizeof(chunk);
+            if (write_all(fd, chunk, n) < 0) break;
+            left -= (long long)n;
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+static int bench_stream(int mb, int rounds) {
+    const OutputMode modes[] = { OUT_LEGACY, OUT_BUFFERED, OUT_SPLICE };
+    const char *names[] = { "legacy 4KB fwrite", "pooled 256KB buffer", "splice" };
+    const int nmodes = 3;
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(lfd, 16) < 0 || getsockname(lfd, (struct sockaddr *)&addr, &alen) < 0) {
+        perror("Bench server");
+        return 1;
+    }
+
+    BenchServer server = { lfd, (long long)mb * 1024 * 1024, nmodes * rounds };
+    pthread_t tid;
+    pthread_create(&tid, NULL, bench_server, &server);
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/bench", ntohs(addr.sin_port));
+    double *secs = malloc(sizeof(double) * (size_t)rounds);
+
+    printf("Streaming %d MB bodies over loopback, %d rounds per mode\n", mb, rounds);
+    printf("%-22s %12s %12s\n", "mode", "median MB/s", "best MB/s");
+    for (int m = 0; m < nmodes; m++) {
+        FetchResult res;
+        for (int r = 0; r < rounds; r++) {
+            double t0 = now_sec();
+            if (fetch_to_files(url, modes[m], &res) < 0) {
+                printf("%s: fetch failed\n", names[m]);
+                secs[r] = 1e9;
+                continue;
+            }
+            secs[r] = now_sec() - t0;
+            char name[64];
+            snprintf(name, sizeof(name), "output_%s.txt", res.key);
+            unlink(name);
+            snprintf(name, sizeof(name), "output_%s.hdr", res.key);
+            unlink(name);
+        }
+        qsort(secs, (size_t)rounds, sizeof(double), cmp_double);
+        printf("%-22s %12.1f %12.1f\n", names[m], mb / secs[rounds / 2], mb / secs[0]);
+    }
+
+    pthread_join(tid, NULL);
+    close(lfd);
+    free(secs);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2 && strcmp(argv[1], "--lookup") == 0)
+        return archive_lookup(argv[2], argc > 3 ? argv[3] : "");
+
+    if (argc > 1 && strcmp(argv[1], "--bench-stream") == 0) {
+        int mb = argc > 2 ? atoi(argv[2]) : 64;
+        int rounds = argc > 3 ? atoi(argv[3]) : 5;
+        if (mb <= 0) mb = 64;
+        if (rounds <= 0) rounds = 5;
+        if (pool_init(2) < 0) {
+            printf("Memory allocation error.\n");
+            return 1;
+        }
+        int ret = bench_stream(mb, rounds);
+        pool_destroy();
+        return ret;
+    }
+
+    // ./multithread [--urls FILE] [--threads N] [--rate R] [--burst B] [--per-host N]
+    //               [--archive DIR [--compress]] [--simulate [hosts] [urls_per_host]]
+    //               [--crawl DEPTH [--same-domain] [--max-per-domain N] [--parsers N]]
+    //               [--metrics-interval SEC] [--metrics-file FILE] [--metrics-port PORT]
+    const char *archive_dir = NULL;
+    const char *url_file = NULL;
+    int compress = 0;
+    int nthreads = NUM_THREADS;
+    double rate = DEFAULT_HOST_RATE, burst = DEFAULT_HOST_BURST;
+    int per_host = DEFAULT_HOST_IN_FLIGHT;
+    int sim_hosts = 0, sim_urls = 20;
+    double metrics_interval = 0;        // no summary lines unless asked for
+    const char *metrics_file = NULL;
+    int metrics_port = 0;
+    int crawl_depth = -1, same_domain = 0, max_per_domain = 0, nparsers = DEFAULT_PARSERS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc) archive_dir = argv[++i];
+        else if (strcmp(argv[i], "--compress") == 0) compress = 1;
+        else if (strcmp(argv[i], "--urls") == 0 && i + 1 < argc) url_file = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) nthreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) burst = atof(argv[++i]);
+        else if (strcmp(argv[i], "--per-host") == 0 && i + 1 < argc) per_host = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--crawl") == 0 && i + 1 < argc) crawl_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--same-domain") == 0) same_domain = 1;
+        else if (strcmp(argv[i], "--max-per-domain") == 0 && i + 1 < argc) max_per_domain = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--parsers") == 0 && i + 1 < argc) nparsers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) metrics_interval = atof(argv[++i]);
+        else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) metrics_file = argv[++i];
+        else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) metrics_port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--simulate") == 0) {
+            sim_hosts = 4;
+            if (i + 1 < argc && argv[i + 1][0] != '-') sim_hosts = atoi(argv[++i]);
+            if (i + 1 < argc && argv[i + 1][0] != '-') sim_urls = atoi(argv[++i]);
+        } else {
+            printf("Unknown option %s.\n", argv[i]);
+            return 1;
+        }
+    }
+    if (nthreads < 1 || nthreads > MAX_THREADS) nthreads = NUM_THREADS;
+    if (rate <= 0) rate = DEFAULT_HOST_RATE;
+    if (nparsers < 1 || nparsers > MAX_THREADS) nparsers = DEFAULT_PARSERS;
+    if (sim_hosts < 0 || sim_urls < 1) {
+        printf("Invalid simulation size.\n");
+        return 1;
+    }
+#ifndef USE_ZLIB
+    if (compress) {
+        printf("Compression not built in (compile with -DUSE_ZLIB -lz), storing records raw.\n");
+        compress = 0;
+    }
+#endif
+
+    if (pool_init(nthreads) < 0) {
+        printf("Memory allocation error.\n");
+        return 1;
+    }
+    sched_init(&sched, rate, burst, per_host);
+    if (metrics_init(nthreads, metrics_interval, metrics_file, metrics_port) < 0) {
+        printf("Memory allocation error.\n");
+        return 1;
+    }
+
+    int ret = 0;
+    if (sim_hosts > 0) {
+        ret = simulate(sim_hosts, sim_urls, nthreads);
+        sched_destroy(&sched);
+        pool_destroy();
+        return ret;
+    }
+
+    if (archive_dir) {
+        archive = archive_open(archive_dir, compress);
+        if (!archive) {
+            printf("Cannot open archive in %s.\n", archive_dir);
+            sched_destroy(&sched);
+            pool_destroy();
+            return 1;
+        }
+    }
+
+    if (crawl_depth >= 0 &&
+        crawl_init(&crawl, crawl_depth, same_domain, max_per_domain, nparsers, DEFAULT_CRAWL_CAPACITY) < 0) {
+        printf("Memory allocation error.\n");
+        return 1;
+    }
+
+    if (url_file) {
+        load_url_file(url_file);
+    } else {
+        for (int i = 0; i < NUM_DEFAULT_URLS; i++)
+            queue_seed(urls[i]);
+    }
+
+    pthread_t parsers[MAX_THREADS];
+    for (int i = 0; crawl.enabled && i < crawl.nparsers; i++)
+        pthread_create(&parsers[i], NULL, parser_thread, &crawl);
+
+    metrics_start();
+    run_workers(nthreads);
+
+    if (crawl.enabled) {
+        // The scheduler only drains once every parse job has finished
+        pthread_mutex_lock(&crawl.queue_lock);
+        crawl.closed = 1;
+        pthread_cond_broadcast(&crawl.queue_ready);
+        pthread_mutex_unlock(&crawl.queue_lock);
+        for (int i = 0; i < crawl.nparsers; i++)
+            pthread_join(parsers[i], NULL);
+
+        printf("Crawl: %lld links seen, %lld URLs queued, %zu distinct URLs visited\n",
+               crawl.links_found, crawl.queued, crawl.seen_count);
+        printf("Bloom filter: %lld definitely new, %lld maybe seen (%lld false positives)\n",
+               crawl.bloom_new, crawl.bloom_maybe, crawl.bloom_false_pos);
+    }
+    metrics_finish();
+    if (crawl.enabled) crawl_destroy(&crawl);
+
+    if (archive) archive_close(archive);
+    sched_destroy(&sched);
+    pool_destroy();
+    return ret;
+}
@@ -0,0 +1,222 @@
+// Host-side stand-in for the Arduino core.
+// Provides just enough of the API for smarttraffic.cpp to build and run on
+// Linux against a simulated clock. Time only moves when the simulator
+// advances it, or when the sketch calls a stub with a modelled AVR cost
+// (pin reads and writes, bytes handed to Serial) or waits for room in the
+// (modelled) 9600 baud serial port. The sketch's own code takes no time.
+
+#pragma once
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define NOT_AN_INTERRUPT -1
+
+typedef uint8_t byte;
+
+// Strings stay in RAM on the host, but F() keeps its own type so the
+// sketch's print overloads resolve as they do on AVR
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+namespace sim {
+
+const int NUM_PINS = 64;
+const uint32_t POLL_COST_US = 10;     // cost of one digitalRead
+const uint32_t WRITE_COST_US = 5;     // cost of one digitalWrite
+const uint32_t SERIAL_COST_US = 6;    // CPU cost of handing one byte to Serial
+const int SERIAL_TX_BUFFER = 64;      // AVR HardwareSerial TX buffer size
+
+inline uint64_t now_us = 0;
+inline int pins[NUM_PINS];
+inline int modes[NUM_PINS];
+
+// Called after time moves forward, so the simulator can apply due events
+inline void (*on_time)() = nullptr;
+// Called on every digitalWrite
+inline void (*on_write)(int pin, int value) = nullptr;
+
+// External interrupts, as on the Uno: INT0 on pin 2, INT1 on pin 3
+const int NUM_INTERRUPTS = 2;
+inline void (*isr[NUM_INTERRUPTS])() = {nullptr, nullptr};
+inline int isr_mode[NUM_INTERRUPTS];
+inline uint64_t isr_calls = 0;
+inline bool in_isr = false;
+
+inline bool echo_serial = false;      // copy serial output to stdout
+inline FILE *tx_capture = nullptr;    // copy serial output to a file
+inline std::string *tx_wire = nullptr; // copy serial output here (the corridor bus)
+inline uint32_t baud = 9600;
+inline uint64_t tx_done_us = 0;       // when the last queued byte finishes sending
+inline uint64_t tx_bytes = 0;
+inline uint64_t tx_blocked_us = 0;    // time the sketch spent waiting for TX space
+inline std::string serial_in;         // bytes waiting to be read by the sketch
+
+inline uint64_t byte_time_us() { return 10000000ULL / baud; }   // 8N1 = 10 bits
+
+inline void advance_to(uint64_t t) {
+  if (t > now_us) {
+    now_us = t;
+    if (on_time) on_time();
+  }
+}
+
+inline int tx_queued() {
+  if (tx_done_us <= now_us) return 0;
+  return (int)((tx_done_us - now_us + byte_time_us() - 1) / byte_time_us());
+}
+
+// Queue one byte; blocks (advances time) while the TX buffer is full, like AVR Serial
+inline void tx_byte(char c) {
+  if (!in_isr) advance_to(now_us + SERIAL_COST_US);
+  if (tx_queued() >= SERIAL_TX_BUFFER) {
+    uint64_t t = tx_done_us - (uint64_t)(SERIAL_TX_BUFFER - 1) * byte_time_us();
+    tx_blocked_us += t - now_us;
+    advance_to(t);
+  }
+  uint64_t start = tx_done_us > now_us ? tx_done_us : now_us;
+  tx_done_us = start + byte_time_us();
+  tx_bytes++;
+  if (echo_serial) putchar(c);
+  if (tx_capture) fputc(c, tx_capture);
+  if (tx_wire) tx_wire->push_back(c);
+}
+
+inline int pin_to_interrupt(int pin) {
+  return pin == 2 ? 0 : pin == 3 ? 1 : NOT_AN_INTERRUPT;
+}
+
+// Drive an input pin from outside the sketch, firing its ISR on a matching edge
+inline void set_pin(int pin, int value) {
+  int old = pins[pin];
+  pins[pin] = value ? HIGH : LOW;
+  int n = pin_to_interrupt(pin);
+  if (n == NOT_AN_INTERRUPT || !isr[n] || old == pins[pin]) return;
+  bool fire = isr_mode[n] == CHANGE ||
+              (isr_mode[n] == FALLING && pins[pin] == LOW) ||
+              (isr_mode[n] == RISING && pins[pin] == HIGH);
+  if (fire) {
+    isr_calls++;
+    in_isr = true;
+    isr[n]();
+    in_isr = false;
+  }
+}
+
+inline void reset() {
+  now_us = 0;
+  for (int i = 0; i < NUM_PINS; i++) {
+    pins[i] = LOW;
+    modes[i] = INPUT;
+  }
+  for (int i = 0; i < NUM_INTERRUPTS; i++) isr[i] = nullptr;
+  isr_calls = 0;
+  tx_done_us = 0;
+  tx_bytes = 0;
+  tx_blocked_us = 0;
+  serial_in.clear();
+}
+
+}  // namespace sim
+
+inline unsigned long millis() { return (unsigned long)(sim::now_us / 1000); }
+inline unsigned long micros() { return (unsigned long)sim::now_us; }
+
+inline void pinMode(int pin, int mode) {
+  sim::modes[pin] = mode;
+  if (mode == INPUT_PULLUP) sim::pins[pin] = HIGH;
+}
+
+inline void digitalWrite(int pin, int value) {
+  if (!sim::in_isr) sim::advance_to(sim::now_us + sim::WRITE_COST_US);
+  sim::pins[pin] = value ? HIGH : LOW;
+  if (sim::on_write) sim::on_write(pin, sim::pins[pin]);
+}
+
+inline int digitalRead(int pin) {
+  if (!sim::in_isr) sim::advance_to(sim::now_us + sim::POLL_COST_US);
+  return sim::pins[pin];
+}
+
+inline int digitalPinToInterrupt(int pin) { return sim::pin_to_interrupt(pin); }
+
+inline void attachInterrupt(int num, void (*fn)(), int mode) {
+  if (num < 0 || num >= sim::NUM_INTERRUPTS) return;
+  sim::isr[num] = fn;
+  sim::isr_mode[num] = mode;
+}
+
+inline void detachInterrupt(int num) {
+  if (num >= 0 && num < sim::NUM_INTERRUPTS) sim::isr[num] = nullptr;
+}
+
+// ISRs run synchronously inside set_pin(), so there is nothing to mask
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+class HostSerial {
+ public:
+  void begin(unsigned long rate) { sim::baud = (uint32_t)rate; }
+
+  int available() { return (int)sim::serial_in.size(); }
+  int read() {
+    if (sim::serial_in.empty()) return -1;
+    int c = (unsigned char)sim::serial_in[0];
+    sim::serial_in.erase(0, 1);
+    return c;
+  }
+  int availableForWrite() { return sim::SERIAL_TX_BUFFER - sim::tx_queued(); }
+
+  size_t write(uint8_t c) {
+    sim::tx_byte((char)c);
+    return 1;
+  }
+  size_t write(const uint8_t *buf, size_t n) {
+    for (size_t i = 0; i < n; i++) sim::tx_byte((char)buf[i]);
+    return n;
+  }
+
+  size_t print(const char *s) {
+    size_t n = strlen(s);
+    for (size_t i = 0; i < n; i++) sim::tx_byte(s[i]);
+    return n;
+  }
+  size_t print(const __FlashStringHelper *s) { return print(reinterpret_cast<const char *>(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf_("%d", v); }
+  size_t print(unsigned int v) { return printf_("%u", v); }
+  size_t print(long v) { return printf_("%ld", v); }
+  size_t print(unsigned long v) { return printf_("%lu", v); }
+  size_t print(double v, int digits = 2) { return printf_("%.*f", digits, v); }
+
+  size_t println() { return print("\r\n"); }
+  template <typename T>
+  size_t println(T v) { return print(v) + println(); }
+  size_t println(double v, int digits) { return print(v, digits) + println(); }
+
+ private:
+  size_t printf_(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+inline size_t HostSerial::printf_(const char *fmt, ...) {
+  char buf[64];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  return print(buf);
+}
+
+inline HostSerial Serial;
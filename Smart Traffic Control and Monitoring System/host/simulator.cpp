@@ -0,0 +1,692 @@
+// Accelerated-time host simulator for smarttraffic.cpp
+//
+// Builds the unmodified sketch against host/Arduino.h and drives it with a
+// discrete-event clock: between loop() calls the clock jumps straight to
+// the next thing that can change the outcome (an arrival, a detector
+// press/release, a vehicle discharge, a phase deadline or the next log).
+//
+// Traffic model: vehicles arrive per lane (Poisson or from a trace), press
+// the lane's detector button for PRESS_MS (lanes without a button count the
+// vehicle directly), queue, and leave one every HEADWAY_MS while the lane
+// shows GREEN (the first after STARTUP_MS).
+//
+// Build: g++ -O2 -std=c++17 -I host host/simulator.cpp -o traffic_sim
+// Run:   ./traffic_sim [--duration SEC] [--rates A,B,...] [--runs N] [--seed S]
+//                      [--plan two|four] [--trace FILE] [--verbose]
+//                      [--text] [--serial-out FILE]
+//                      [--timing adaptive|formula] [--compare] [--profile]
+//        ./traffic_sim --bench N [--duration SEC]   controller steps/sec
+//        ./traffic_sim --corridor N [--travel SEC] [--cycle SEC] [--rates MAIN,SIDE]
+//                      isolated vs green-wave operation of a chain of N nodes
+
+#include "Arduino.h"
+#include "../smarttraffic.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+const uint64_t PRESS_US = 150000;      // detector held per vehicle
+const uint64_t PRESS_GAP_US = 50000;   // minimum gap between two presses
+const uint64_t HEADWAY_US = 2000000;   // saturation headway
+const uint64_t STARTUP_US = 2000000;   // start-up lost time at the start of green
+const uint64_t GAP_TICK_US = 100000;   // loop() rate while a GREEN may gap out
+const int BOUNCES = 3;             // edges per press or release
+const int SIM_LANES = MAX_LANES;
+
+// Corridor node: lane 0 is the main street (phase 0, carries the platoons),
+// lane 1 the side street
+const Phase CORRIDOR_PLAN[] = {
+  { 0x01, 10000, 40000, 3000, 1000 },
+  { 0x02, 5000, 20000, 3000, 1000 }
+};
+const uint64_t BOOT_STAGGER_MS = 13000;   // nodes power up at different times
+
+// Four approaches with protected left turns and 1 s all-red clearance.
+// Lanes 0-3: N, S, E, W through; lanes 4-7: N, S, E, W left turn.
+const Phase FOUR_WAY_PLAN[] = {
+  { 0x30, 5000, 12000, 3000, 1000 },   // N/S protected left
+  { 0x03, 8000, 30000, 3000, 1000 },   // N/S through
+  { 0xC0, 5000, 12000, 3000, 1000 },   // E/W protected left
+  { 0x0C, 8000, 30000, 3000, 1000 }    // E/W through
+};
+
+int simLanes = 2;
+Intersection *simIx = &intersections[0];
+
+struct LaneSim {
+  TrafficLane *lane = nullptr;
+  int buttonPin = NO_PIN;
+
+  std::vector<uint64_t> arrivals;      // trace for this lane, sorted
+  size_t nextArrival = 0;
+
+  std::deque<uint64_t> queue;          // arrival times of waiting vehicles
+  std::deque<uint64_t> presses;        // detector presses not yet started
+  bool pressed = false;
+  uint64_t releaseAt = 0, lastRelease = 0;
+
+  bool green = false;
+  unsigned long greenSince = 0;
+  uint64_t nextDischarge = 0;
+
+  // statistics
+  uint64_t served = 0, stopped = 0;
+  double waitSum = 0, waitMax = 0;
+  uint64_t greens = 0, lastGreenStart = 0;
+  double cycleSum = 0, cycleMin = 1e18, cycleMax = 0;
+  uint64_t cycles = 0;
+};
+
+LaneSim sims[SIM_LANES];
+
+// Track GREEN starts from the controller's own lane state
+void watchSignal(LaneSim &ls) {
+  bool on = ls.lane->currentState == GREEN;
+  if (on && (!ls.green || ls.lane->startTime != ls.greenSince)) {
+    uint64_t start = (uint64_t)ls.lane->startTime * 1000;
+    ls.nextDischarge = start + STARTUP_US;
+    if (ls.greens > 0) {
+      double c = (double)(start - ls.lastGreenStart) / 1e6;
+      ls.cycleSum += c;
+      ls.cycleMin = std::min(ls.cycleMin, c);
+      ls.cycleMax = std::max(ls.cycleMax, c);
+      ls.cycles++;
+    }
+    ls.greens++;
+    ls.lastGreenStart = start;
+    ls.greenSince = ls.lane->startTime;
+  }
+  ls.green = on;
+}
+
+// Mechanical contacts chatter: every press and release crosses the
+// threshold three times before settling, all well inside DEBOUNCE_TIME
+void bounce(int pin, int level) {
+  for (int i = 0; i < BOUNCES; i++) sim::set_pin(pin, i % 2 ? !level : level);
+}
+
+// Apply every event that is due at sim::now_us
+void processEvents() {
+  uint64_t now = sim::now_us;
+  for (int i = 0; i < simLanes; i++) {
+    LaneSim &ls = sims[i];
+    watchSignal(ls);
+    while (ls.nextArrival < ls.arrivals.size() && ls.arrivals[ls.nextArrival] <= now) {
+      uint64_t t = ls.arrivals[ls.nextArrival++];
+      ls.queue.push_back(t);
+      if (ls.buttonPin == NO_PIN) {
+        vehicleDetected(ls.lane, millis());   // ideal detector
+        continue;
+      }
+      uint64_t earliest = ls.presses.empty() ? ls.lastRelease + PRESS_GAP_US
+                                             : ls.presses.back() + PRESS_US + PRESS_GAP_US;
+      if (ls.pressed) earliest = std::max(earliest, ls.releaseAt + PRESS_GAP_US);
+      ls.presses.push_back(std::max(t, earliest));
+    }
+    if (ls.pressed && now >= ls.releaseAt) {
+      ls.pressed = false;
+      ls.lastRelease = ls.releaseAt;
+      bounce(ls.buttonPin, HIGH);
+    }
+    if (!ls.pressed && !ls.presses.empty() && ls.presses.front() <= now) {
+      ls.pressed = true;
+      ls.releaseAt = ls.presses.front() + PRESS_US;
+      ls.presses.pop_front();
+      bounce(ls.buttonPin, LOW);
+    }
+    while (ls.green && !ls.queue.empty()) {
+      uint64_t depart = std::max(ls.nextDischarge, ls.queue.front());
+      if (depart > now) break;
+      double wait = (double)(depart - ls.queue.front()) / 1e6;
+      ls.queue.pop_front();
+      ls.served++;
+      if (wait > 0) ls.stopped++;
+      ls.waitSum += wait;
+      ls.waitMax = std::max(ls.waitMax, wait);
+      ls.nextDischarge = depart + HEADWAY_US;
+    }
+  }
+}
+
+// Earliest time at which the controller's own timers can fire
+uint64_t controllerDeadline() {
+  uint64_t next = (uint64_t)nextLogTime * 1000;
+  return std::min(next, (uint64_t)(simIx->stageStart + simIx->stageDuration) * 1000);
+}
+
+uint64_t nextEventTime() {
+  uint64_t next = controllerDeadline();
+  // Gap-out is polled: on hardware loop() spins, here it ticks every 100 ms
+  if (adaptiveTiming && simIx->stage == STAGE_GREEN) next = std::min(next, sim::now_us + GAP_TICK_US);
+  // Queued telemetry: wake up once the UART buffer is half empty
+  if (txHead != txTail)
+    next = std::min(next, sim::tx_done_us - (uint64_t)(sim::SERIAL_TX_BUFFER / 2) * sim::byte_time_us());
+  for (int i = 0; i < simLanes; i++) {
+    const LaneSim &ls = sims[i];
+    if (ls.nextArrival < ls.arrivals.size()) next = std::min(next, ls.arrivals[ls.nextArrival]);
+    if (ls.pressed) next = std::min(next, ls.releaseAt);
+    else if (!ls.presses.empty()) next = std::min(next, ls.presses.front());
+    if (ls.green && !ls.queue.empty())
+      next = std::min(next, std::max(ls.nextDischarge, ls.queue.front()));
+  }
+  return std::max(next, sim::now_us + 1);
+}
+
+struct RunResult {
+  uint64_t loops = 0;
+  uint64_t maxLoopUs = 0;
+  LaneSim lanes[SIM_LANES];
+};
+
+// setup() builds the Tinkercad two-lane intersection; the four-way plan
+// replaces it with eight lanes that have no pins
+void setupPlan(bool fourWay) {
+  setup();
+  if (fourWay) {
+    setupIntersection(simIx, 0, FOUR_WAY_PLAN, sizeof(FOUR_WAY_PLAN) / sizeof(FOUR_WAY_PLAN[0]));
+    for (int i = 0; i < 8; i++) addLane(simIx, NO_PIN, NO_PIN, NO_PIN, NO_PIN);
+    startPhase(simIx, 0);
+  }
+  simLanes = simIx->laneCount;
+}
+
+RunResult runOnce(const std::vector<uint64_t> (&trace)[SIM_LANES], uint64_t durationUs, bool fourWay) {
+  sim::reset();
+  sim::on_time = nullptr;
+  eventHead = eventTail = 0;
+  droppedEvents = 0;
+  maxDetectLatency = 0;
+  txHead = txTail = 0;
+  lastFrameTime = 0;
+  droppedFrames = 0;
+  setupPlan(fourWay);
+  for (int i = 0; i < SIM_LANES; i++) {
+    sims[i] = LaneSim();
+    sims[i].arrivals = trace[i];
+    if (i < simLanes) {
+      sims[i].lane = &simIx->lanes[i];
+      sims[i].buttonPin = simIx->lanes[i].buttonPin;
+    }
+  }
+  sim::on_time = processEvents;
+  processEvents();
+
+  RunResult r;
+  while (sim::now_us < durationUs) {
+    uint64_t before = sim::now_us;
+    loop();
+    r.loops++;
+    r.maxLoopUs = std::max(r.maxLoopUs, sim::now_us - before);
+    processEvents();
+    uint64_t next = nextEventTime();
+    if (next > durationUs) break;
+    sim::advance_to(next);
+  }
+  for (int i = 0; i < SIM_LANES; i++) r.lanes[i] = sims[i];
+  return r;
+}
+
+// Steps many independent intersections in lockstep and reports how many
+// controller updates per second the host manages
+int benchmark(int count, double durationSec) {
+  std::vector<Intersection> ixs((size_t)count);
+  sim::reset();
+  traceTransitions = false;
+  for (int n = 0; n < count; n++) {
+    setupIntersection(&ixs[n], (uint8_t)n, FOUR_WAY_PLAN, sizeof(FOUR_WAY_PLAN) / sizeof(FOUR_WAY_PLAN[0]));
+    for (int i = 0; i < 8; i++) addLane(&ixs[n], NO_PIN, NO_PIN, NO_PIN, NO_PIN);
+    startPhase(&ixs[n], 0);
+  }
+
+  // ~600 veh/h per lane on 100 ms steps
+  const uint32_t arrivalThreshold = (uint32_t)(0xFFFFFFFFu / 60);
+  uint32_t rng = 2463534242u;
+  uint64_t steps = 0, phaseChanges = 0;
+  const uint64_t stepUs = 100000;
+  uint64_t end = (uint64_t)(durationSec * 1e6);
+
+  auto wall0 = std::chrono::steady_clock::now();
+  for (sim::now_us = 0; sim::now_us < end; sim::now_us += stepUs) {
+    for (Intersection &ix : ixs) {
+      for (uint8_t i = 0; i < ix.laneCount; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        if (rng < arrivalThreshold) vehicleDetected(&ix.lanes[i], millis());
+      }
+      uint8_t before = ix.currentPhase;
+      updateSignals(&ix);
+      phaseChanges += ix.currentPhase != before;
+      steps++;
+    }
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+
+  printf("%d intersections x %.0f s at 100 ms steps: %llu controller steps in %.3f s\n",
+         count, durationSec, (unsigned long long)steps, wall);
+  printf("%.1f M steps/s, %.0f ns/step, %llu phase changes, %zu bytes per intersection\n",
+         wall > 0 ? steps / wall / 1e6 : 0.0, wall > 0 ? wall * 1e9 / steps : 0.0,
+         (unsigned long long)phaseChanges, sizeof(Intersection));
+  return 0;
+}
+
+void poissonTrace(std::vector<uint64_t> &out, double perHour, uint64_t durationUs, std::mt19937_64 &rng) {
+  out.clear();
+  if (perHour <= 0) return;
+  std::exponential_distribution<double> gap(perHour / 3600.0);
+  for (double t = gap(rng); t * 1e6 < (double)durationUs; t += gap(rng))
+    out.push_back((uint64_t)(t * 1e6));
+}
+
+// --- CORRIDOR ---
+// A chain of controllers on one main street, stepped every 100 ms. Main
+// street vehicles enter at node 0 and reach node k+1 travelTime after
+// leaving node k; side street traffic is local to each node. Each node
+// takes its turn as the sketch's intersections[0], with its own serial
+// state, and node k's TX is wired to node k+1's RX as on the bench: the
+// syncs and each node's light-change trace (frames, or text with --text)
+// go through Serial and checkSerialInterface().
+
+struct CorridorQueue {
+  struct Entry {
+    int vehicle;         // main street vehicle id, -1 = side street
+    uint64_t arrival;    // ms
+  };
+  std::deque<Entry> q;
+  bool green = false;
+  uint64_t flowFrom = 0, nextGo = 0;
+};
+
+struct CorridorStats {
+  double through = 0, stops = 0, delaySum = 0, sideServed = 0, sideWait = 0, syncs = 0;
+};
+
+// One board's sketch globals, swapped in while the node runs
+struct CorridorNode {
+  Intersection ix;
+  uint8_t tx[sizeof(txRing)];
+  uint8_t txHead = 0, txTail = 0;
+  uint8_t rx[FRAME_SIZE];
+  uint8_t rxLen = 0;
+  unsigned long lastFrameTime = 0;
+  uint64_t txDoneUs = 0;
+  std::string in, out;   // bytes waiting on RX, bytes sent on TX this step
+};
+
+void enterNode(CorridorNode &n) {
+  intersections[0] = n.ix;
+  memcpy(txRing, n.tx, sizeof(txRing));
+  txHead = n.txHead;
+  txTail = n.txTail;
+  memcpy(rxFrame, n.rx, sizeof(rxFrame));
+  rxLen = n.rxLen;
+  lastFrameTime = n.lastFrameTime;
+  sim::tx_done_us = n.txDoneUs;
+  sim::serial_in.swap(n.in);
+  sim::tx_wire = &n.out;
+}
+
+void leaveNode(CorridorNode &n) {
+  n.ix = intersections[0];
+  memcpy(n.tx, txRing, sizeof(txRing));
+  n.txHead = txHead;
+  n.txTail = txTail;
+  memcpy(n.rx, rxFrame, sizeof(rxFrame));
+  n.rxLen = rxLen;
+  n.lastFrameTime = lastFrameTime;
+  n.txDoneUs = sim::tx_done_us;
+  n.in.swap(sim::serial_in);
+  sim::serial_in.clear();
+  sim::tx_wire = nullptr;
+}
+
+CorridorStats runCorridor(int nodes, bool coordinated, uint64_t durationMs, uint64_t travelMs,
+                          uint16_t cycleMs, const std::vector<uint64_t> &mainTrace,
+                          const std::vector<std::vector<uint64_t>> &sideTrace) {
+  std::vector<CorridorNode> board((size_t)nodes);
+  std::vector<CorridorQueue> approach((size_t)nodes * 2);
+  std::vector<std::deque<std::pair<uint64_t, int>>> inFlight((size_t)nodes);   // arrival ms, vehicle
+  std::vector<size_t> nextSide((size_t)nodes, 0);
+  std::vector<uint64_t> enterMs;
+  std::vector<int> stops;
+  size_t nextMain = 0;
+  CorridorStats st;
+
+  sim::reset();
+  traceTransitions = true;    // every light change goes down the wire, as on the bench
+  adaptiveTiming = true;
+  Intersection *ix = &intersections[0];
+  for (int k = 0; k < nodes; k++) {
+    setupIntersection(ix, (uint8_t)k, CORRIDOR_PLAN, 2);
+    addLane(ix, NO_PIN, NO_PIN, NO_PIN, NO_PIN);
+    addLane(ix, NO_PIN, NO_PIN, NO_PIN, NO_PIN);
+    board[k].ix = *ix;
+  }
+
+  for (uint64_t t = 0; t < durationMs; t += 100) {
+    sim::now_us = t * 1000;
+
+    for (int k = 0; k < nodes; k++) {
+      uint64_t boot = (uint64_t)k * BOOT_STAGGER_MS;
+      if (t < boot) continue;
+      enterNode(board[k]);
+      if (t == boot) {
+        if (coordinated) setCorridor(ix, (uint8_t)k, cycleMs, (uint16_t)travelMs);
+        startPhase(ix, 0);
+      }
+
+      // Arrivals: a vehicle joins the queue; it stops unless it can roll straight on
+      auto arrive = [&](int lane, int vehicle, uint64_t when) {
+        CorridorQueue &a = approach[k * 2 + lane];
+        if (vehicle >= 0 && !(a.green && a.q.empty())) stops[vehicle]++;
+        a.q.push_back({vehicle, when});
+        vehicleDetected(&ix->lanes[lane], (unsigned long)when);
+      };
+      if (k == 0) {
+        while (nextMain < mainTrace.size() && mainTrace[nextMain] <= t) {
+          enterMs.push_back(mainTrace[nextMain]);
+          stops.push_back(0);
+          arrive(0, (int)enterMs.size() - 1, mainTrace[nextMain++]);
+        }
+      }
+      while (!inFlight[k].empty() && inFlight[k].front().first <= t) {
+        arrive(0, inFlight[k].front().second, inFlight[k].front().first);
+        inFlight[k].pop_front();
+      }
+      while (nextSide[k] < sideTrace[k].size() && sideTrace[k][nextSide[k]] <= t)
+        arrive(1, -1, sideTrace[k][nextSide[k]++]);
+
+      // The sketch's loop() order: signals and the master's sync, the serial
+      // interface (which relays syncs from upstream), then the UART
+      uint8_t queued = txHead;
+      updateSignals(ix);
+      if (checkCoordination(ix)) sendSync(ix);
+      while (Serial.available() > 0) checkSerialInterface();
+      flushTelemetry();
+      for (uint8_t i = queued; k + 1 < nodes && i != txHead; i += FRAME_SIZE)
+        st.syncs += txRing[(uint8_t)(i + 1)] == FRAME_CYCLE_SYNC;
+
+      // Discharge at the saturation headway while GREEN
+      for (int lane = 0; lane < 2; lane++) {
+        CorridorQueue &a = approach[k * 2 + lane];
+        bool green = ix->lanes[lane].currentState == GREEN;
+        if (green && !a.green) a.flowFrom = t + STARTUP_US / 1000;
+        a.green = green;
+        while (green && !a.q.empty() && t >= std::max(a.flowFrom, a.nextGo)) {
+          CorridorQueue::Entry e = a.q.front();
+          a.q.pop_front();
+          a.nextGo = t + HEADWAY_US / 1000;
+          if (e.vehicle < 0) {
+            st.sideServed++;
+            st.sideWait += (t - e.arrival) / 1000.0;
+          } else if (k + 1 < nodes) {
+            inFlight[k + 1].push_back({t + travelMs, e.vehicle});
+          } else {
+            st.through++;
+            st.stops += stops[e.vehicle];
+            st.delaySum += (t - enterMs[e.vehicle] - (uint64_t)(nodes - 1) * travelMs) / 1000.0;
+          }
+        }
+      }
+      leaveNode(board[k]);
+    }
+
+    // The wires: what a node sent this step reaches the next node's RX by
+    // the next step, unless that node has not powered up yet
+    for (int k = 0; k < nodes; k++) {
+      bool wired = coordinated && k + 1 < nodes && t >= (uint64_t)(k + 1) * BOOT_STAGGER_MS;
+      if (wired) board[k + 1].in += board[k].out;
+      board[k].out.clear();
+    }
+  }
+  return st;
+}
+
+int corridor(int nodes, double durationSec, const double *rates, double travelSec, double cycleSec,
+             int runs, unsigned long long seed) {
+  uint64_t durationMs = (uint64_t)(durationSec * 1000);
+  uint64_t travelMs = (uint64_t)(travelSec * 1000);
+  uint16_t cycleMs = (uint16_t)std::min(cycleSec * 1000, 65000.0);
+  CorridorStats total[2];
+  std::mt19937_64 rng(seed);
+
+  for (int r = 0; r < runs; r++) {
+    std::vector<uint64_t> mainTrace;
+    std::vector<std::vector<uint64_t>> sideTrace((size_t)nodes);
+    poissonTrace(mainTrace, rates[0], durationMs * 1000, rng);
+    for (uint64_t &t : mainTrace) t /= 1000;
+    for (auto &side : sideTrace) {
+      poissonTrace(side, rates[1], durationMs * 1000, rng);
+      for (uint64_t &t : side) t /= 1000;
+    }
+    for (int m = 0; m < 2; m++) {
+      CorridorStats s = runCorridor(nodes, m == 1, durationMs, travelMs, cycleMs, mainTrace, sideTrace);
+      total[m].through += s.through;
+      total[m].stops += s.stops;
+      total[m].delaySum += s.delaySum;
+      total[m].sideServed += s.sideServed;
+      total[m].sideWait += s.sideWait;
+      total[m].syncs += s.syncs;
+    }
+  }
+
+  double hours = durationSec * runs / 3600.0;
+  printf("Corridor of %d nodes, %.0f s apart, cycle %.0f s, main %.0f veh/h, side %.0f veh/h, %d run(s) x %.0f s\n",
+         nodes, travelSec, cycleMs / 1000.0, rates[0], rates[1], runs, durationSec);
+  printf("%-12s %12s %12s %14s %12s %10s\n", "mode", "through/h", "stops/veh", "corridor delay",
+         "side wait", "syncs");
+  const char *names[2] = {"isolated", "green wave"};
+  for (int m = 0; m < 2; m++) {
+    const CorridorStats &t = total[m];
+    printf("%-12s %12.1f %12.2f %13.1fs %11.1fs %10.0f\n", names[m], t.through / hours,
+           t.through ? t.stops / t.through : 0.0, t.through ? t.delaySum / t.through : 0.0,
+           t.sideServed ? t.sideWait / t.sideServed : 0.0, t.syncs / runs);
+  }
+  return 0;
+}
+
+// Trace file: one arrival per line, "<time_ms> <lane>"; '#' starts a comment
+bool loadTrace(const char *path, std::vector<uint64_t> (&trace)[SIM_LANES]) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    unsigned long long ms;
+    int lane;
+    if (sscanf(line, "%llu %d", &ms, &lane) == 2 && lane >= 0 && lane < SIM_LANES)
+      trace[lane].push_back(ms * 1000);
+  }
+  fclose(f);
+  for (auto &t : trace) std::sort(t.begin(), t.end());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  double durationSec = 3600;
+  double rates[SIM_LANES] = {400, 300, 400, 300, 120, 90, 120, 90};   // vehicles per hour
+  int runs = 1;
+  unsigned long long seed = 1;
+  const char *tracePath = nullptr;
+  bool fourWay = false;
+  int benchCount = 0;
+  bool compare = false;
+  bool rateList = false;
+  bool profile = false;
+  int corridorNodes = 0;
+  double travelSec = 20, cycleSec = 60;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--duration") && i + 1 < argc) durationSec = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--rates") && i + 1 < argc) {
+      rateList = true;
+      char *p = argv[++i];
+      for (int l = 0; l < SIM_LANES && *p; l++) {
+        rates[l] = strtod(p, &p);
+        if (*p == ',') p++;
+      }
+    }
+    else if (!strcmp(argv[i], "--plan") && i + 1 < argc) fourWay = !strcmp(argv[++i], "four");
+    else if (!strcmp(argv[i], "--bench") && i + 1 < argc) benchCount = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--runs") && i + 1 < argc) runs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--trace") && i + 1 < argc) tracePath = argv[++i];
+    else if (!strcmp(argv[i], "--verbose")) sim::echo_serial = true;
+    else if (!strcmp(argv[i], "--text")) binaryTelemetry = false;
+    else if (!strcmp(argv[i], "--timing") && i + 1 < argc) adaptiveTiming = strcmp(argv[++i], "formula") != 0;
+    else if (!strcmp(argv[i], "--compare")) compare = true;
+    else if (!strcmp(argv[i], "--profile")) profile = true;
+    else if (!strcmp(argv[i], "--corridor") && i + 1 < argc) corridorNodes = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--travel") && i + 1 < argc) travelSec = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--cycle") && i + 1 < argc) cycleSec = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--serial-out") && i + 1 < argc) {
+      sim::tx_capture = fopen(argv[++i], "wb");
+      if (!sim::tx_capture) {
+        printf("Cannot write %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else {
+      printf("Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (runs < 1) runs = 1;
+  if (benchCount > 0) return benchmark(benchCount, durationSec);
+  if (corridorNodes > 0) {
+    if (!rateList) {   // corridor default: busy main street, light side streets
+      rates[0] = 600;
+      rates[1] = 150;
+    }
+    return corridor(corridorNodes, durationSec, rates, travelSec, cycleSec, runs, seed);
+  }
+  uint64_t durationUs = (uint64_t)(durationSec * 1e6);
+
+  std::vector<uint64_t> trace[SIM_LANES];
+  if (tracePath && !loadTrace(tracePath, trace)) {
+    printf("Cannot read trace %s\n", tracePath);
+    return 1;
+  }
+
+  struct Totals {
+    double served = 0, arrived = 0, waitSum = 0, waitMax = 0, stopped = 0;
+    double cycleSum = 0, cycleMin = 1e18, cycleMax = 0, cycles = 0;
+  } tot[SIM_LANES];
+  uint64_t loops = 0, maxLoopUs = 0, isrCalls = 0, dropped = 0;
+  unsigned long maxLatency = 0;
+  uint64_t droppedTelemetry = 0;
+  // --compare: the same arrivals under the other timing mode
+  struct Compare {
+    double served = 0, stopped = 0, waitSum = 0;
+  } cmp[2][SIM_LANES];
+  bool mode = adaptiveTiming;
+
+  auto wall0 = std::chrono::steady_clock::now();
+  std::mt19937_64 rng(seed);
+  for (int r = 0; r < runs; r++) {
+    if (!tracePath)
+      for (int i = 0; i < SIM_LANES; i++) poissonTrace(trace[i], rates[i], durationUs, rng);
+
+    if (compare) {
+      for (int m = 0; m < 2; m++) {
+        adaptiveTiming = m == 1;
+        RunResult other = runOnce(trace, durationUs, fourWay);
+        for (int i = 0; i < simLanes; i++) {
+          cmp[m][i].served += other.lanes[i].served;
+          cmp[m][i].stopped += other.lanes[i].stopped;
+          cmp[m][i].waitSum += other.lanes[i].waitSum;
+        }
+      }
+      adaptiveTiming = mode;
+    }
+
+    RunResult res = runOnce(trace, durationUs, fourWay);
+    loops += res.loops;
+    maxLoopUs = std::max(maxLoopUs, res.maxLoopUs);
+    isrCalls += sim::isr_calls;
+    dropped += droppedEvents;
+    maxLatency = std::max(maxLatency, maxDetectLatency);
+    droppedTelemetry += droppedFrames;
+    for (int i = 0; i < simLanes; i++) {
+      const LaneSim &ls = res.lanes[i];
+      Totals &t = tot[i];
+      t.served += ls.served;
+      t.arrived += ls.arrivals.size();
+      t.stopped += ls.stopped;
+      t.waitSum += ls.waitSum;
+      t.waitMax = std::max(t.waitMax, ls.waitMax);
+      t.cycleSum += ls.cycleSum;
+      t.cycles += ls.cycles;
+      if (ls.cycles) {
+        t.cycleMin = std::min(t.cycleMin, ls.cycleMin);
+        t.cycleMax = std::max(t.cycleMax, ls.cycleMax);
+      }
+    }
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+  double simulated = durationSec * runs;
+
+  printf("Simulated %d run(s) x %.0f s in %.3f s wall (%.0fx real time), %llu loop() calls, %s timing\n",
+         runs, durationSec, wall, wall > 0 ? simulated / wall : 0.0, (unsigned long long)loops,
+         adaptiveTiming ? "adaptive" : "formula");
+  printf("%-5s %10s %10s %10s %10s %10s %10s %10s %10s\n", "lane", "arrived", "served",
+         "veh/h", "mean wait", "max wait", "cycle avg", "cycle min", "cycle max");
+  for (int i = 0; i < simLanes; i++) {
+    const Totals &t = tot[i];
+    printf("%-5d %10.0f %10.0f %10.1f %9.1fs %9.1fs %9.1fs %9.1fs %9.1fs\n", i,
+           t.arrived / runs, t.served / runs, t.served / simulated * 3600.0,
+           t.served ? t.waitSum / t.served : 0.0, t.waitMax,
+           t.cycles ? t.cycleSum / t.cycles : 0.0, t.cycles ? t.cycleMin : 0.0, t.cycleMax);
+  }
+  printf("Longest single loop() (stub costs only): %.1f ms, serial bytes sent: %llu, time blocked on serial: %.1f ms (last run)\n",
+         maxLoopUs / 1000.0, (unsigned long long)sim::tx_bytes, sim::tx_blocked_us / 1000.0);
+  printf("Button interrupts: %llu, detections dropped: %llu, worst press-to-count latency: %lu ms\n",
+         (unsigned long long)isrCalls, (unsigned long long)dropped, maxLatency);
+  printf("Telemetry: %s, frames dropped: %llu\n", binaryTelemetry ? "binary" : "text",
+         (unsigned long long)droppedTelemetry);
+  if (profile) {
+    // Ask the sketch itself, as over the serial port ('p'), after the last run
+    printf("Loop profile on the host: stage times are the modelled costs of pin and serial\n"
+           "calls (host/Arduino.h) plus waits for the serial port. The sketch's own code\n"
+           "takes no simulated time, so a stage without such calls reads 0.\n");
+    txTail = txHead;
+    sim::echo_serial = true;
+    sim::serial_in = "p";
+    checkSerialInterface();
+    sim::echo_serial = false;
+  }
+  if (compare) {
+    printf("\nSame arrivals, formula vs adaptive timing:\n");
+    printf("%-5s %12s %12s %12s %12s %12s %12s\n", "lane", "formula wait", "adapt wait",
+           "formula stop", "adapt stop", "formula veh", "adapt veh");
+    Compare all[2];
+    for (int i = 0; i < simLanes; i++) {
+      const Compare &f = cmp[0][i], &a = cmp[1][i];
+      printf("%-5d %11.1fs %11.1fs %11.0f%% %11.0f%% %12.0f %12.0f\n", i,
+             f.served ? f.waitSum / f.served : 0.0, a.served ? a.waitSum / a.served : 0.0,
+             f.served ? 100.0 * f.stopped / f.served : 0.0, a.served ? 100.0 * a.stopped / a.served : 0.0,
+             f.served / runs, a.served / runs);
+      for (int m = 0; m < 2; m++) {
+        all[m].served += cmp[m][i].served;
+        all[m].stopped += cmp[m][i].stopped;
+        all[m].waitSum += cmp[m][i].waitSum;
+      }
+    }
+    printf("%-5s %11.1fs %11.1fs %11.0f%% %11.0f%% %12.0f %12.0f\n", "all",
+           all[0].served ? all[0].waitSum / all[0].served : 0.0,
+           all[1].served ? all[1].waitSum / all[1].served : 0.0,
+           all[0].served ? 100.0 * all[0].stopped / all[0].served : 0.0,
+           all[1].served ? 100.0 * all[1].stopped / all[1].served : 0.0,
+           all[0].served / runs, all[1].served / runs);
+  }
+  if (sim::tx_capture) fclose(sim::tx_capture);
+  return 0;
+}
@@ -0,0 +1,96 @@
+// Decoder for the controller's binary telemetry stream.
+// Reads raw serial bytes (a capture file, or stdin) and prints one CSV row
+// per valid frame. Bytes that are not part of a frame with a good CRC, such
+// as the boot banner or replies to serial commands, are skipped.
+//
+// Build: g++ -O2 -std=c++17 host/teldecode.cpp -o teldecode
+// Run:   ./teldecode [FILE] > telemetry.csv
+//        ./traffic_sim --serial-out tel.bin && ./teldecode tel.bin
+
+#include <cstdint>
+#include <cstdio>
+
+// Frame layout; must match the TELEMETRY constants in smarttraffic.cpp
+const uint8_t FRAME_SYNC = 0xA5;
+const int FRAME_SIZE = 15;
+const uint8_t FRAME_CLOCK = 0;
+const uint8_t FRAME_SNAPSHOT = 1;
+const uint8_t FRAME_TRANSITION = 2;
+const uint8_t FRAME_CYCLE_SYNC = 3;
+
+static uint8_t crc8(const uint8_t *data, int len) {
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
+
+static const char *stateName(int s) {
+  return s == 0 ? "GREEN" : s == 1 ? "YELLOW" : s == 2 ? "RED" : "?";
+}
+
+int main(int argc, char **argv) {
+  FILE *in = stdin;
+  if (argc > 1) {
+    in = fopen(argv[1], "rb");
+    if (!in) {
+      fprintf(stderr, "Cannot open %s\n", argv[1]);
+      return 1;
+    }
+  }
+
+  printf("Timestamp(ms),Type,Intersection,LaneID,Phase,State,VehicleCount,GreenDuration(ms),Value(ms)\n");
+
+  uint8_t f[FRAME_SIZE];
+  int have = 0;
+  unsigned long long now = 0, frames = 0, skipped = 0;
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    f[have++] = (uint8_t)c;
+    if (f[0] != FRAME_SYNC) {
+      have = 0;
+      skipped++;
+      continue;
+    }
+    if (have < FRAME_SIZE) continue;
+
+    if (crc8(f, FRAME_SIZE - 1) != f[FRAME_SIZE - 1]) {
+      // Not a frame after all: drop the sync byte and rescan the rest
+      int i = 1;
+      while (i < FRAME_SIZE && f[i] != FRAME_SYNC) i++;
+      skipped += i;
+      for (int j = i; j < FRAME_SIZE; j++) f[j - i] = f[j];
+      have = FRAME_SIZE - i;
+      continue;
+    }
+    have = 0;
+    frames++;
+
+    unsigned dt = f[2] | f[3] << 8;
+    unsigned count = f[6] | f[7] << 8;
+    unsigned duration = f[8] | f[9] << 8;
+    unsigned long value = (unsigned long)f[10] | (unsigned long)f[11] << 8 |
+                          (unsigned long)f[12] << 16 | (unsigned long)f[13] << 24;
+
+    now += dt;
+    if (f[1] == FRAME_CLOCK) {
+      now = value;
+      printf("%llu,CLOCK,,,,,,,%lu\n", now, value);
+      continue;
+    }
+    if (f[1] == FRAME_CYCLE_SYNC) {
+      // Corridor sync: sending node, common cycle, sender's offset
+      printf("%llu,SYNC,,%d,,,,%u,%lu\n", now, f[4], duration, value);
+      continue;
+    }
+    const char *type = f[1] == FRAME_SNAPSHOT ? "SNAPSHOT" : f[1] == FRAME_TRANSITION ? "TRANSITION" : "UNKNOWN";
+    printf("%llu,%s,%d,%d,%d,%s,%u,%u,%lu\n", now, type, f[4] >> 4, f[4] & 0x0F,
+           f[5] >> 4, stateName(f[5] & 0x0F), count, duration, value);
+  }
+
+  fprintf(stderr, "%llu frames decoded, %llu bytes skipped\n", frames, skipped);
+  if (in != stdin) fclose(in);
+  return 0;
+}
@@ -14,116 +14,370 @@
 #define BTN_A        2
 #define BTN_B        3
 
+// Lanes without physical lights or a button (used by the host simulator)
+#define NO_PIN     0xFF
+
 // Timing constants
 const int MIN_GREEN_TIME = 4000;  // Minimum time for a green light (ms)
 const int MAX_GREEN_TIME = 15000; // Maximum time for a green light (ms)
 const int YELLOW_TIME    = 2000;  // Standard yellow light time (ms)
+const int ALL_RED_TIME   = 0;     // All-red clearance between phases (ms)
 const int TIME_PER_VEHICLE = 500; // Additional green time per waiting vehicle (ms)
 const int LOGGING_INTERVAL = 10000; // Log data every 10 seconds (ms)
+const int DEBOUNCE_TIME = 50;     // Button must be quiet this long before an edge counts (ms)
+
+// Adaptive timing (queue estimation + Webster splits)
+const int SAT_HEADWAY  = 2000;    // Time between queued vehicles leaving on GREEN (ms)
+const int LOST_TIME    = 2000;    // Start-up time lost at the beginning of each GREEN (ms)
+const int PASSAGE_TIME = 3000;    // GREEN ends (gap-out) after this long without an arrival (ms)
+const uint16_t MAX_GAP = 60000;   // Arrival gaps are capped here: "no traffic" (ms)
+
+// Corridor coordination (green wave). Controllers are chained TX -> RX;
+// node 0 is the master. CORRIDOR_CYCLE 0 = this controller runs alone.
+#define CORRIDOR_NODE      0
+#define CORRIDOR_CYCLE     0       // common cycle length (ms)
+#define CORRIDOR_TRAVEL    0       // travel time from the upstream node (ms)
+const int SYNC_DELAY = 16;        // one frame at 9600 baud (ms)
+const int SYNC_TIMEOUT_CYCLES = 3; // run free after this many cycles without a sync
+
+// Controller limits (a lane set is a bit mask, so MAX_LANES <= 8)
+#define MAX_LANES          8
+#define NUM_INTERSECTIONS  1
+#define MAX_IRQ_LANES      2   // external interrupts on the Uno (pins 2 and 3)
+#define EVENT_RING_SIZE   16   // detection events in flight; power of two
+
+// Binary telemetry frame (little-endian, FRAME_SIZE bytes):
+//   0xA5 | type | dt u16 | lane u8 | state u8 | count u16 | duration u16 | value u32 | crc8
+// lane packs intersection id (high nibble) and lane id (low nibble); state
+// packs the phase (high nibble) and SignalState (low nibble). dt is ms since
+// the previous frame; FRAME_CLOCK carries absolute millis() in value so a
+// reader can join mid-stream. The CRC-8 (poly 0x07) covers every byte before it.
+#define FRAME_SYNC        0xA5
+#define FRAME_SIZE        15
+#define FRAME_CLOCK       0   // value = millis()
+#define FRAME_SNAPSHOT    1   // value = total wait (ms), every LOGGING_INTERVAL
+#define FRAME_TRANSITION  2   // value = time spent in the previous state (ms)
+#define FRAME_CYCLE_SYNC  3   // lane = sender node, duration = cycle, value = sender offset (ms)
+
+// Loop profiler: log2 histogram buckets; bucket 0 = 0, bucket k = [2^(k-1), 2^k)
+#define HIST_BUCKETS      16
 
 // Enums and Structs for Dynamic Data Handling
 
 // Signal states for the FSM
-enum SignalState {
+enum SignalState : uint8_t {
   GREEN,
   YELLOW,
   RED
 };
 
-// Structure to hold lane/intersection data
+// Where the intersection is inside its current phase
+enum PhaseStage : uint8_t {
+  STAGE_GREEN,
+  STAGE_YELLOW,
+  STAGE_ALL_RED
+};
+
+// One row of a signal plan: the lanes that move together and their timing.
+// Protected turns are just lanes of their own; all-red clearance is the
+// allRedTime that follows the yellow.
+struct Phase {
+  uint8_t greenMask;    // bit i set = lane i is GREEN in this phase
+  uint16_t minGreen;    // ms
+  uint16_t maxGreen;    // ms
+  uint16_t yellowTime;  // ms
+  uint16_t allRedTime;  // ms
+};
+
+// Structure to hold lane data (kept small: hundreds are simulated at once)
 struct TrafficLane {
-  int laneID;
-  int redPin, yellowPin, greenPin;
-  int buttonPin;
-  volatile long vehicleCount; // volatile for button ISR/non-blocking read
+  uint8_t laneID;
+  uint8_t redPin, yellowPin, greenPin;
+  uint8_t buttonPin;
+  uint8_t buttonIrq;           // interrupt number, or NO_PIN when the button is polled
+  uint8_t lastLevel;           // last polled button level
   SignalState currentState;
-  unsigned long greenDuration; // Dynamically calculated duration
-  unsigned long startTime;     // Time when the current phase started
+  uint16_t vehicleCount;       // only changed by loop(), from drained detection events
+                               // (adaptive: queue estimate on RED, arrivals on GREEN)
+  uint16_t queueAtGreen;       // estimated queue when the lane last turned GREEN
+  uint16_t meanGap;            // EWMA of time between arrivals (ms)
+  unsigned long lastArrival;   // time of the last detection (ms)
+  volatile unsigned long lastEdge; // last button edge (ms), for debouncing
+  uint16_t greenDuration;      // Dynamically calculated duration
+  unsigned long startTime;     // Time when the current state started
   unsigned long totalWaitTime; // Cumulative wait time (simulated)
 };
 
+// An intersection runs its phase table in order, forever
+struct Intersection {
+  uint8_t id;
+  uint8_t laneCount;
+  uint8_t phaseCount;
+  uint8_t currentPhase;
+  PhaseStage stage;
+  uint16_t stageDuration;      // ms the current stage lasts
+  unsigned long stageStart;
+  const Phase *plan;
+
+  // Corridor coordination; phase 0 is the coordinated (platoon) phase
+  uint8_t node;                // position in the corridor, 0 = master
+  bool synced;                 // cycleRef follows the corridor
+  uint16_t cycleLength;        // common cycle (ms), 0 = free running
+  uint16_t offset;             // phase 0 starts this long after a corridor cycle start (ms)
+  uint16_t travelTime;         // from the upstream node (ms)
+  unsigned long cycleRef;      // local time of a corridor cycle start
+  unsigned long lastSync;      // when the last sync arrived
+
+  TrafficLane lanes[MAX_LANES];
+};
+
+// Plan for the Tinkercad circuit: A green, then B green
+const Phase TWO_LANE_PLAN[] = {
+  { 0x01, MIN_GREEN_TIME, MAX_GREEN_TIME, YELLOW_TIME, ALL_RED_TIME },
+  { 0x02, MIN_GREEN_TIME, MAX_GREEN_TIME, YELLOW_TIME, ALL_RED_TIME }
+};
+
+// A debounced button press, stamped by the ISR and counted by loop()
+struct DetectionEvent {
+  TrafficLane *lane;
+  unsigned long time;          // millis() at the press
+};
+
 // --- GLOBAL VARIABLES ---
-TrafficLane lanes[2]; // Array of two TrafficLane structures (Intersection A & B)
-int currentLaneIndex = 0; // Index of the lane currently in a GREEN/YELLOW phase
+Intersection intersections[NUM_INTERSECTIONS];
 unsigned long nextLogTime = 0; // Timer for the logging function
+bool traceTransitions = true;  // Print every light change ('t' toggles)
+bool adaptiveTiming = true;    // Webster splits + gap-out; false = count formula ('a' toggles)
+
+// Single-producer/single-consumer ring: ISRs (which never nest on AVR) only
+// write eventHead, loop() only writes eventTail. One-byte indices are read
+// and written atomically, so no interrupt masking is needed.
+volatile DetectionEvent eventRing[EVENT_RING_SIZE];
+volatile uint8_t eventHead = 0;
+volatile uint8_t eventTail = 0;
+volatile uint16_t droppedEvents = 0;       // presses lost to a full ring
+TrafficLane *irqLanes[MAX_IRQ_LANES];      // lane served by each interrupt
+unsigned long maxDetectLatency = 0;        // press -> counted (ms)
+
+// Telemetry goes out through a 256-byte TX ring that loop() trickles into
+// the UART only as fast as it has room, so logging never blocks. uint8_t
+// indices wrap on their own.
+bool binaryTelemetry = true;   // false = readable CSV for the Serial Monitor ('b' toggles)
+uint8_t txRing[256];
+uint8_t txHead = 0, txTail = 0;
+unsigned long lastFrameTime = 0;
+uint16_t droppedFrames = 0;    // frames lost to a full TX ring
+uint8_t rxFrame[FRAME_SIZE];   // sync frame being received from upstream
+uint8_t rxLen = 0;
+
+// Loop profiler ('p' prints and resets): ~130 bytes in total
+enum ProfileStage : uint8_t {
+  PS_DETECT,      // drainDetectionEvents
+  PS_SIGNALS,     // updateSignals
+  PS_SENSORS,     // checkTrafficSensors
+  PS_LOG,         // logData
+  PS_SERIAL,      // checkSerialInterface
+  PS_TELEMETRY,   // flushTelemetry
+  PS_COUNT
+};
+
+struct StageProfile {
+  uint32_t totalUs;
+  uint32_t maxUs;
+  uint32_t calls;
+};
+
+StageProfile stageProfile[PS_COUNT];
+uint16_t loopPeriodHist[HIST_BUCKETS];   // time between loop() starts (us)
+uint16_t latenessHist[HIST_BUCKETS];     // stage change after its deadline (ms)
+unsigned long lastLoopStart = 0;
+bool loopStarted = false;
 
 // --- FUNCTION PROTOTYPES ---
-void setupLane(TrafficLane *lane, int id, int rP, int yP, int gP, int bP);
-void updateSignals();
-void transitionState(TrafficLane *lane, SignalState newState);
-void checkTrafficSensors();
-void dynamicTiming(TrafficLane *lane);
+void setupIntersection(Intersection *ix, uint8_t id, const Phase *plan, uint8_t phaseCount);
+TrafficLane *addLane(Intersection *ix, uint8_t rP, uint8_t yP, uint8_t gP, uint8_t bP);
+void startPhase(Intersection *ix, uint8_t phase);
+void updateSignals(Intersection *ix);
+void transitionState(Intersection *ix, TrafficLane *lane, SignalState newState);
+void checkTrafficSensors(Intersection *ix);
+void drainDetectionEvents();
+void vehicleDetected(TrafficLane *lane, unsigned long t);
+void dynamicTiming(Intersection *ix, TrafficLane *lane, uint8_t phaseIndex);
+unsigned long websterGreen(Intersection *ix, uint8_t phase);
 void logData();
+void sendFrame(uint8_t type, const Intersection *ix, const TrafficLane *lane, uint32_t value);
+void queueFrame(uint8_t type, uint8_t id, uint8_t state, uint16_t count, uint16_t duration, uint32_t value);
+void setCorridor(Intersection *ix, uint8_t node, uint16_t cycleLength, uint16_t travelTime);
+bool checkCoordination(Intersection *ix);
+bool receiveSync(Intersection *ix, uint8_t fromNode, uint16_t cycleLength, uint16_t fromOffset);
+void sendSync(const Intersection *ix);
+unsigned long coordinatedGreen(Intersection *ix, uint8_t phase, unsigned long adaptive);
+void flushTelemetry();
+unsigned long profileStage(uint8_t stage, unsigned long start);
+void histAdd(uint16_t *hist, unsigned long value);
+void printProfile();
 void checkSerialInterface();
 
 // --- SETUP ---
 void setup() {
   Serial.begin(9600);
   Serial.println("--- Smart Traffic System Initialized ---");
-  
-  // Initialize Lane A
-  setupLane(&lanes[0], 0, A_RED, A_YELLOW, A_GREEN, BTN_A);
-  // Initialize Lane B
-  setupLane(&lanes[1], 1, B_RED, B_YELLOW, B_GREEN, BTN_B);
-
-  // Initial State: A is GREEN, B is RED
-  transitionState(&lanes[0], GREEN);
-  transitionState(&lanes[1], RED);
-  
+
+  Intersection *ix = &intersections[0];
+  setupIntersection(ix, 0, TWO_LANE_PLAN, sizeof(TWO_LANE_PLAN) / sizeof(TWO_LANE_PLAN[0]));
+  addLane(ix, A_RED, A_YELLOW, A_GREEN, BTN_A); // Lane A
+  addLane(ix, B_RED, B_YELLOW, B_GREEN, BTN_B); // Lane B
+
+  if (CORRIDOR_CYCLE > 0) setCorridor(ix, CORRIDOR_NODE, CORRIDOR_CYCLE, CORRIDOR_TRAVEL);
+
+  // Initial State: first phase (A GREEN, B RED)
+  sendFrame(FRAME_CLOCK, NULL, NULL, millis());
+  startPhase(ix, 0);
+
   nextLogTime = millis() + LOGGING_INTERVAL;
 }
 
-// Helper to set up a lane struct and pins
-void setupLane(TrafficLane *lane, int id, int rP, int yP, int gP, int bP) {
-  lane->laneID = id;
+// Pin helpers that ignore lanes with no hardware
+static void writePin(uint8_t pin, uint8_t value) {
+  if (pin != NO_PIN) digitalWrite(pin, value);
+}
+
+void setupIntersection(Intersection *ix, uint8_t id, const Phase *plan, uint8_t phaseCount) {
+  ix->id = id;
+  ix->laneCount = 0;
+  ix->phaseCount = phaseCount;
+  ix->currentPhase = 0;
+  ix->stage = STAGE_ALL_RED;
+  ix->stageDuration = 0;
+  ix->stageStart = 0;
+  ix->plan = plan;
+  ix->node = 0;
+  ix->synced = false;
+  ix->cycleLength = 0;
+  ix->offset = 0;
+  ix->travelTime = 0;
+  ix->cycleRef = millis();
+  ix->lastSync = millis();
+
+  // Release button interrupts held by this intersection's old lanes
+  for (uint8_t irq = 0; irq < MAX_IRQ_LANES; irq++) {
+    TrafficLane *lane = irqLanes[irq];
+    if (lane >= ix->lanes && lane < ix->lanes + MAX_LANES) {
+      detachInterrupt(irq);
+      irqLanes[irq] = NULL;
+    }
+  }
+}
+
+// Button ISRs: one per external interrupt, since ISRs take no arguments
+void onButtonEdge(uint8_t irq);
+void buttonIsr0() { onButtonEdge(0); }
+void buttonIsr1() { onButtonEdge(1); }
+void (*const BUTTON_ISRS[MAX_IRQ_LANES])() = { buttonIsr0, buttonIsr1 };
+
+// Helper to set up a lane struct and pins; returns NULL if the intersection is full
+TrafficLane *addLane(Intersection *ix, uint8_t rP, uint8_t yP, uint8_t gP, uint8_t bP) {
+  if (ix->laneCount >= MAX_LANES) return NULL;
+  TrafficLane *lane = &ix->lanes[ix->laneCount];
+  lane->laneID = ix->laneCount++;
   lane->redPin = rP;
   lane->yellowPin = yP;
   lane->greenPin = gP;
   lane->buttonPin = bP;
-  
+
   // Pin setup
-  pinMode(rP, OUTPUT);
-  pinMode(yP, OUTPUT);
-  pinMode(gP, OUTPUT);
-  pinMode(bP, INPUT_PULLUP);
-  
-  // Initial values
+  if (rP != NO_PIN) pinMode(rP, OUTPUT);
+  if (yP != NO_PIN) pinMode(yP, OUTPUT);
+  if (gP != NO_PIN) pinMode(gP, OUTPUT);
+  if (bP != NO_PIN) pinMode(bP, INPUT_PULLUP);
+
+  // Initial values: every lane starts on RED
   lane->vehicleCount = 0;
+  lane->queueAtGreen = 0;
+  lane->meanGap = MAX_GAP;
+  lane->lastArrival = millis() - MAX_GAP;
   lane->currentState = RED;
   lane->greenDuration = MIN_GREEN_TIME;
-  lane->startTime = 0;
+  lane->startTime = millis();
   lane->totalWaitTime = 0;
+  lane->lastEdge = millis() - DEBOUNCE_TIME;
+  lane->lastLevel = HIGH;
+  writePin(rP, HIGH);
+
+  // Buttons on interrupt pins report through the ISR; the rest are polled
+  lane->buttonIrq = NO_PIN;
+  if (bP != NO_PIN) {
+    int irq = digitalPinToInterrupt(bP);
+    if (irq >= 0 && irq < MAX_IRQ_LANES && irqLanes[irq] == NULL) {
+      irqLanes[irq] = lane;
+      lane->buttonIrq = irq;
+      attachInterrupt(irq, BUTTON_ISRS[irq], CHANGE);
+    }
+  }
+  return lane;
 }
 
 // --- MAIN LOOP (Simulated Multithreading / Concurrency) ---
 void loop() {
-  // 1. Signal Control (FSM) - Non-Blocking
-  updateSignals(); 
+  unsigned long t = micros();
+  if (loopStarted) histAdd(loopPeriodHist, t - lastLoopStart);
+  lastLoopStart = t;
+  loopStarted = true;
+
+  // 1. Vehicle Detection - count presses queued by the button ISRs
+  drainDetectionEvents();
+  t = profileStage(PS_DETECT, t);
+
+  for (int i = 0; i < NUM_INTERSECTIONS; i++) {
+    // 2. Signal Control (FSM) - Non-Blocking; the corridor master announces each cycle
+    updateSignals(&intersections[i]);
+    if (checkCoordination(&intersections[i])) sendSync(&intersections[i]);
+    t = profileStage(PS_SIGNALS, t);
+
+    // 3. Vehicle Detection for polled buttons - Non-Blocking
+    checkTrafficSensors(&intersections[i]);
+    t = profileStage(PS_SENSORS, t);
+  }
 
-  // 2. Vehicle Detection - Non-Blocking
-  checkTrafficSensors(); 
-  
-  // 3. Logging and Monitoring - Non-Blocking Timer
+  // 4. Logging and Monitoring - Non-Blocking Timer
   if (millis() >= nextLogTime) {
     logData();
     nextLogTime = millis() + LOGGING_INTERVAL;
+    t = profileStage(PS_LOG, t);
   }
 
-  // 4. System Interface (Manual Override, Stats) - Non-Blocking
+  // 5. System Interface (Manual Override, Stats) - Non-Blocking
   checkSerialInterface();
+  t = profileStage(PS_SERIAL, t);
+
+  // 6. Telemetry - hand queued frames to the UART without waiting
+  flushTelemetry();
+  profileStage(PS_TELEMETRY, t);
 }
 
 // --- IMPLEMENTATIONS ---
 
 // Manages the state transition for a lane
-void transitionState(TrafficLane *lane, SignalState newState) {
+void transitionState(Intersection *ix, TrafficLane *lane, SignalState newState) {
   // Error Handling: Ensure safe memory access
-  if (lane == NULL) return; 
+  if (lane == NULL) return;
+  unsigned long previous = millis() - lane->startTime;
+
+  // Queue bookkeeping for adaptive timing: whatever the GREEN could not
+  // discharge at SAT_HEADWAY is carried over as the new RED queue
+  if (adaptiveTiming && newState == GREEN) {
+    lane->queueAtGreen = lane->vehicleCount;
+    lane->vehicleCount = 0;
+  } else if (adaptiveTiming && newState == YELLOW && lane->currentState == GREEN) {
+    unsigned long served = previous > (unsigned long)LOST_TIME ? (previous - LOST_TIME) / SAT_HEADWAY + 1 : 0;
+    unsigned long demand = (unsigned long)lane->queueAtGreen + lane->vehicleCount;
+    lane->vehicleCount = demand > served ? demand - served : 0;
+  }
 
   // Turn off all lights first
-  digitalWrite(lane->redPin, LOW);
-  digitalWrite(lane->yellowPin, LOW);
-  digitalWrite(lane->greenPin, LOW);
+  writePin(lane->redPin, LOW);
+  writePin(lane->yellowPin, LOW);
+  writePin(lane->greenPin, LOW);
 
   // Set the new state
   lane->currentState = newState;
@@ -131,145 +385,586 @@ void transitionState(TrafficLane *lane, SignalState newState) {
 
   switch (newState) {
     case GREEN:
-      dynamicTiming(lane);
-      digitalWrite(lane->greenPin, HIGH);
-      Serial.print(F("Lane ")); Serial.print(lane->laneID); Serial.println(F(" -> GREEN"));
-      // The opposing lane must be RED, this is FSM robustness
-      if (lane->laneID == lanes[0].laneID) {
-          digitalWrite(lanes[1].redPin, HIGH);
-          lanes[1].currentState = RED;
-      } else {
-          digitalWrite(lanes[0].redPin, HIGH);
-          lanes[0].currentState = RED;
-      }
+      writePin(lane->greenPin, HIGH);
       break;
     case YELLOW:
-      digitalWrite(lane->yellowPin, HIGH);
-      Serial.print(F("Lane ")); Serial.print(lane->laneID); Serial.println(F(" -> YELLOW"));
+      writePin(lane->yellowPin, HIGH);
       break;
     case RED:
-      digitalWrite(lane->redPin, HIGH);
-      Serial.print(F("Lane ")); Serial.print(lane->laneID); Serial.println(F(" -> RED"));
-      // Reset vehicle count after the lane has cleared
-      lane->vehicleCount = 0; 
+      writePin(lane->redPin, HIGH);
+      // Reset vehicle count after the lane has cleared (adaptive mode keeps the residual queue)
+      if (!adaptiveTiming) lane->vehicleCount = 0;
       break;
   }
+
+  if (traceTransitions && binaryTelemetry) {
+    sendFrame(FRAME_TRANSITION, ix, lane, previous);
+  } else if (traceTransitions) {
+    Serial.print(F("Lane ")); Serial.print(lane->laneID);
+    if (newState == GREEN) Serial.println(F(" -> GREEN"));
+    else if (newState == YELLOW) Serial.println(F(" -> YELLOW"));
+    else Serial.println(F(" -> RED"));
+  }
 }
 
-// FSM logic for signal cycling
-void updateSignals() {
-  TrafficLane *currentLane = &lanes[currentLaneIndex];
-  unsigned long duration = 0;
+// --- CORRIDOR COORDINATION ---
+
+// Join a corridor. The master (node 0) owns the cycle; other nodes wait for
+// its sync and place phase 0 travelTime after their upstream neighbour's.
+void setCorridor(Intersection *ix, uint8_t node, uint16_t cycleLength, uint16_t travelTime) {
+  ix->node = node;
+  ix->cycleLength = cycleLength;
+  ix->travelTime = travelTime;
+  ix->offset = 0;
+  ix->synced = node == 0 && cycleLength > 0;
+  ix->cycleRef = millis();
+  ix->lastSync = millis();
+}
 
-  switch (currentLane->currentState) {
-    case GREEN:
-      duration = currentLane->greenDuration;
-      if (millis() - currentLane->startTime >= duration) {
-        transitionState(currentLane, YELLOW);
+// Where this node is in the common cycle; 0 = phase 0 is due to turn GREEN
+static unsigned long cyclePosition(const Intersection *ix) {
+  unsigned long c = ix->cycleLength;
+  return (millis() - ix->cycleRef + c - ix->offset % c) % c;
+}
+
+// Master: true once per cycle, when a sync should go downstream.
+// Others: fall back to free running if the syncs stop.
+bool checkCoordination(Intersection *ix) {
+  if (!ix->cycleLength) return false;
+  unsigned long now = millis();
+  if (ix->node > 0) {
+    if (ix->synced && now - ix->lastSync > (unsigned long)SYNC_TIMEOUT_CYCLES * ix->cycleLength)
+      ix->synced = false;
+    return false;
+  }
+  if (now - ix->cycleRef < ix->cycleLength) return false;
+  ix->cycleRef += ix->cycleLength * ((now - ix->cycleRef) / ix->cycleLength);
+  return true;
+}
+
+// A sync from upstream marks a corridor cycle start SYNC_DELAY ago. Returns
+// true if it was meant for this node, which then relays its own sync.
+bool receiveSync(Intersection *ix, uint8_t fromNode, uint16_t cycleLength, uint16_t fromOffset) {
+  if (ix->node == 0 || fromNode + 1 != ix->node || cycleLength == 0) return false;
+  unsigned long now = millis();
+  ix->cycleLength = cycleLength;
+  ix->offset = (uint16_t)(((unsigned long)fromOffset + ix->travelTime) % cycleLength);
+  ix->cycleRef = now - SYNC_DELAY;
+  ix->lastSync = now;
+  ix->synced = true;
+  return true;
+}
+
+void sendSync(const Intersection *ix) {
+  queueFrame(FRAME_CYCLE_SYNC, ix->node, 0xFF, 0, ix->cycleLength, ix->offset);
+}
+
+// Green for a phase under coordination. Phase 0 carries the platoon and
+// holds until its force-off point in the common cycle; the other phases
+// keep their adaptive green but are cut so that phase 0 starts on time.
+unsigned long coordinatedGreen(Intersection *ix, uint8_t phase, unsigned long adaptive) {
+  const Phase *ph = &ix->plan[phase];
+  unsigned long c = ix->cycleLength;
+  unsigned long pos = cyclePosition(ix);
+  unsigned long green = adaptive;
+
+  if (phase == 0) {
+    // Side phases get their Webster split of the common cycle
+    unsigned long side = ph->yellowTime + ph->allRedTime;
+    for (uint8_t p = 1; p < ix->phaseCount; p++) {
+      const Phase *q = &ix->plan[p];
+      unsigned long split = websterGreen(ix, p);
+      if (split < q->minGreen) split = q->minGreen;
+      if (split > q->maxGreen) split = q->maxGreen;
+      side += split + q->yellowTime + q->allRedTime;
+    }
+    unsigned long mainEnd = side < c ? c - side : 0;
+    green = (mainEnd + c - pos) % c; // early return to phase 0 just holds it longer
+  } else {
+    unsigned long rest = ph->yellowTime + ph->allRedTime;
+    for (uint8_t p = phase + 1; p < ix->phaseCount; p++) {
+      const Phase *q = &ix->plan[p];
+      rest += q->minGreen + q->yellowTime + q->allRedTime;
+    }
+    unsigned long left = c - pos;
+    if (left > rest && left - rest < green) green = left - rest;
+  }
+
+  if (green < ph->minGreen) green = ph->minGreen;
+  if (green > 0xFFFF) green = 0xFFFF;
+  return green;
+}
+
+// Begin the GREEN stage of a phase. Lanes outside the phase are forced RED
+// first (FSM robustness); lanes that were already GREEN keep running.
+void startPhase(Intersection *ix, uint8_t phase) {
+  const Phase *ph = &ix->plan[phase];
+  ix->currentPhase = phase;
+  ix->stage = STAGE_GREEN;
+  ix->stageStart = millis();
+  ix->stageDuration = ph->minGreen;
+
+  for (uint8_t i = 0; i < ix->laneCount; i++) {
+    TrafficLane *lane = &ix->lanes[i];
+    if (!(ph->greenMask & (1 << i)) && lane->currentState != RED)
+      transitionState(ix, lane, RED);
+  }
+  for (uint8_t i = 0; i < ix->laneCount; i++) {
+    TrafficLane *lane = &ix->lanes[i];
+    if (!(ph->greenMask & (1 << i))) continue;
+    dynamicTiming(ix, lane, phase);
+    if (lane->greenDuration > ix->stageDuration) ix->stageDuration = lane->greenDuration;
+    if (lane->currentState != GREEN) transitionState(ix, lane, GREEN);
+  }
+  if (ix->cycleLength && ix->synced) ix->stageDuration = coordinatedGreen(ix, phase, ix->stageDuration);
+}
+
+// Gap-out: once the estimated queue of every lane in the phase has had time
+// to discharge and nobody has arrived for PASSAGE_TIME, the GREEN is wasted
+static bool phaseGappedOut(Intersection *ix, unsigned long elapsed) {
+  const Phase *ph = &ix->plan[ix->currentPhase];
+  if (elapsed < ph->minGreen) return false;
+  if (ix->cycleLength && ix->synced && ix->currentPhase == 0) return false; // hold for the platoon
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < ix->laneCount; i++) {
+    if (!(ph->greenMask & (1 << i))) continue;
+    TrafficLane *lane = &ix->lanes[i];
+    unsigned long demand = (unsigned long)lane->queueAtGreen + lane->vehicleCount;
+    if (elapsed < LOST_TIME + demand * SAT_HEADWAY) return false;
+    if (now - lane->lastArrival < (unsigned long)PASSAGE_TIME) return false;
+  }
+  return true;
+}
+
+// FSM logic for phase cycling: GREEN -> YELLOW -> ALL RED -> next phase.
+// In adaptive mode GREEN ends at the Webster split (max-out) or earlier on gap-out.
+void updateSignals(Intersection *ix) {
+  unsigned long elapsed = millis() - ix->stageStart;
+  if (elapsed < ix->stageDuration &&
+      !(adaptiveTiming && ix->stage == STAGE_GREEN && phaseGappedOut(ix, elapsed))) return;
+  if (elapsed >= ix->stageDuration) histAdd(latenessHist, elapsed - ix->stageDuration);
+
+  const Phase *ph = &ix->plan[ix->currentPhase];
+  uint8_t next = ix->currentPhase + 1;
+  if (next >= ix->phaseCount) next = 0;
+  // Lanes that are also green in the next phase do not stop
+  uint8_t ending = ph->greenMask & ~ix->plan[next].greenMask;
+
+  switch (ix->stage) {
+    case STAGE_GREEN:
+      if (ending) {
+        for (uint8_t i = 0; i < ix->laneCount; i++)
+          if (ending & (1 << i)) transitionState(ix, &ix->lanes[i], YELLOW);
+        ix->stage = STAGE_YELLOW;
+        ix->stageStart = millis();
+        ix->stageDuration = ph->yellowTime;
+        break;
       }
+      startPhase(ix, next);
       break;
 
-    case YELLOW:
-      duration = YELLOW_TIME;
-      if (millis() - currentLane->startTime >= duration) {
-        // Transition to RED, then switch to the next lane's GREEN
-        transitionState(currentLane, RED); 
-        
-        // Move to the next lane (switching control)
-        currentLaneIndex = 1 - currentLaneIndex; 
-        TrafficLane *nextLane = &lanes[currentLaneIndex];
-        
-        // Ensure the next lane's RED phase is active before switching
-        transitionState(nextLane, GREEN);
+    case STAGE_YELLOW:
+      for (uint8_t i = 0; i < ix->laneCount; i++)
+        if (ending & (1 << i)) transitionState(ix, &ix->lanes[i], RED);
+      if (ph->allRedTime > 0) {
+        ix->stage = STAGE_ALL_RED;
+        ix->stageStart = millis();
+        ix->stageDuration = ph->allRedTime;
+        break;
       }
+      startPhase(ix, next);
       break;
 
-    case RED:
-      // RED phase is controlled by the GREEN/YELLOW time of the *other* lane.
-      // No transition needed here as the next lane's GREEN phase handles the switch.
+    case STAGE_ALL_RED:
+      startPhase(ix, next);
       break;
   }
 }
 
-// Detects vehicle presence (using buttons)
-void checkTrafficSensors() {
-  // Lane A detection
-  if (digitalRead(BTN_A) == LOW) { // Button press (LOW due to INPUT_PULLUP)
-    lanes[0].vehicleCount++;
-    // Simple debouncing: wait until button is released
-    while(digitalRead(BTN_A) == LOW); 
+// Time-based debounce: an edge only counts if the button was quiet for
+// DEBOUNCE_TIME before it. Returns true for a genuine press (HIGH -> LOW).
+static bool debouncedPress(TrafficLane *lane, uint8_t level, unsigned long now) {
+  bool quiet = now - lane->lastEdge >= (unsigned long)DEBOUNCE_TIME;
+  lane->lastEdge = now;
+  return quiet && level == LOW; // LOW due to INPUT_PULLUP
+}
+
+// ISR for both edges of a button: stamp the press and queue it for loop()
+void onButtonEdge(uint8_t irq) {
+  TrafficLane *lane = irqLanes[irq];
+  if (lane == NULL) return;
+  unsigned long now = millis();
+  if (!debouncedPress(lane, digitalRead(lane->buttonPin), now)) return;
+
+  uint8_t head = eventHead;
+  uint8_t next = (head + 1) & (EVENT_RING_SIZE - 1);
+  if (next == eventTail) { // Ring full: loop() is far behind
+    droppedEvents++;
+    return;
   }
+  eventRing[head].lane = lane;
+  eventRing[head].time = now;
+  eventHead = next; // Publish after the slot is written
+}
 
-  // Lane B detection
-  if (digitalRead(BTN_B) == LOW) {
-    lanes[1].vehicleCount++;
-    while(digitalRead(BTN_B) == LOW);
+// Count every queued press. Never waits: an empty ring returns at once.
+void drainDetectionEvents() {
+  uint8_t tail = eventTail;
+  while (tail != eventHead) {
+    TrafficLane *lane = eventRing[tail].lane;
+    unsigned long t = eventRing[tail].time;
+    tail = (tail + 1) & (EVENT_RING_SIZE - 1);
+    eventTail = tail; // Hand the slot back to the ISR
+
+    // A press from before the lane turned RED was traffic that has cleared
+    // (adaptive mode already counted the GREEN arrivals in its queue estimate)
+    if (!adaptiveTiming && lane->currentState == RED && (long)(t - lane->startTime) < 0) continue;
+    vehicleDetected(lane, t);
+
+    unsigned long latency = millis() - t;
+    if (latency > maxDetectLatency) maxDetectLatency = latency;
   }
 }
 
+// Detects vehicle presence on buttons without an interrupt (edge polling)
+void checkTrafficSensors(Intersection *ix) {
+  for (uint8_t i = 0; i < ix->laneCount; i++) {
+    TrafficLane *lane = &ix->lanes[i];
+    if (lane->buttonPin == NO_PIN || lane->buttonIrq != NO_PIN) continue;
+
+    uint8_t level = digitalRead(lane->buttonPin);
+    if (level != lane->lastLevel) {
+      if (debouncedPress(lane, level, millis())) vehicleDetected(lane, millis());
+      lane->lastLevel = level;
+    }
+  }
+}
+
+// One vehicle arrived on a lane at time t: count it and update the EWMA
+// of the arrival gap (weight 1/8)
+void vehicleDetected(TrafficLane *lane, unsigned long t) {
+  unsigned long gap = t - lane->lastArrival;
+  if (gap > MAX_GAP) gap = MAX_GAP;
+  lane->meanGap = (uint16_t)(((unsigned long)lane->meanGap * 7 + gap) / 8);
+  lane->lastArrival = t;
+  lane->vehicleCount++;
+}
+
+// Flow ratio y = arrival rate / saturation flow. A lane that has been quiet
+// for longer than its mean gap is judged by the current gap instead.
+static float flowRatio(const TrafficLane *lane) {
+  unsigned long gap = millis() - lane->lastArrival;
+  if (gap < lane->meanGap) gap = lane->meanGap;
+  if (gap == 0) gap = 1;
+  return (float)SAT_HEADWAY / gap;
+}
+
+// Webster's optimum cycle C = (1.5 L + 5 s) / (1 - Y), with the effective
+// green shared between phases in proportion to their critical flow ratio
+unsigned long websterGreen(Intersection *ix, uint8_t phase) {
+  float Y = 0, yPhase = 0;
+  unsigned long lost = 0, clearance = 0;
+  for (uint8_t p = 0; p < ix->phaseCount; p++) {
+    const Phase *ph = &ix->plan[p];
+    float y = 0;
+    for (uint8_t i = 0; i < ix->laneCount; i++) {
+      if (!(ph->greenMask & (1 << i))) continue;
+      float r = flowRatio(&ix->lanes[i]);
+      if (r > y) y = r;
+    }
+    Y += y;
+    if (p == phase) yPhase = y;
+    lost += LOST_TIME + ph->allRedTime;
+    clearance += ph->yellowTime + ph->allRedTime;
+  }
+  if (Y > 0.9f) Y = 0.9f; // Oversaturated: settle for the longest sensible cycle
+
+  float cycle = (1.5f * lost + 5000.0f) / (1.0f - Y);
+  if (ix->cycleLength && ix->synced) cycle = ix->cycleLength; // corridor cycle is fixed
+  float share = Y > 0 ? yPhase / Y : 1.0f / ix->phaseCount;
+  float green = (cycle - clearance) * share;
+  return green > 0 ? (unsigned long)green : 0;
+}
+
 // Adjust signal timing dynamically based on traffic count
-void dynamicTiming(TrafficLane *lane) {
-  unsigned long dynamicTime = lane->vehicleCount * TIME_PER_VEHICLE;
-  lane->greenDuration = MIN_GREEN_TIME + dynamicTime;
-  
+void dynamicTiming(Intersection *ix, TrafficLane *lane, uint8_t phaseIndex) {
+  const Phase *phase = &ix->plan[phaseIndex];
+  unsigned long duration;
+  if (adaptiveTiming) {
+    // Max-out at the Webster split, but always long enough to clear the estimated queue
+    duration = websterGreen(ix, phaseIndex);
+    unsigned long queueTime = LOST_TIME + (unsigned long)lane->vehicleCount * SAT_HEADWAY;
+    if (duration < queueTime) duration = queueTime;
+  } else {
+    unsigned long dynamicTime = (unsigned long)lane->vehicleCount * TIME_PER_VEHICLE;
+    duration = phase->minGreen + dynamicTime;
+  }
+
+  if (duration < phase->minGreen) duration = phase->minGreen;
+
   // Cap the maximum time (Robustness)
-  if (lane->greenDuration > MAX_GREEN_TIME) {
-    lane->greenDuration = MAX_GREEN_TIME;
+  if (duration > phase->maxGreen) {
+    duration = phase->maxGreen;
+  }
+  lane->greenDuration = (uint16_t)duration;
+
+  if (traceTransitions && !binaryTelemetry) {
+    Serial.print(F("Lane ")); Serial.print(lane->laneID);
+    Serial.print(F(" count: ")); Serial.print(lane->vehicleCount);
+    Serial.print(F(" -> Duration: ")); Serial.print(lane->greenDuration / 1000.0); Serial.println(F("s"));
   }
-  
-  Serial.print(F("Lane ")); Serial.print(lane->laneID); 
-  Serial.print(F(" count: ")); Serial.print(lane->vehicleCount);
-  Serial.print(F(" -> Duration: ")); Serial.print(lane->greenDuration / 1000.0); Serial.println(F("s"));
 }
 
 // Logs data to the Serial port which is the same as file logging
 void logData() {
-  Serial.println(F("\n--- LOG ENTRY ---"));
-  
-  // Header (for easy parsing/redirection)
-  Serial.println(F("Timestamp(ms),LaneID,State,VehicleCount,CurrentGreenDuration(ms),WaitTime(ms)"));
-
-  for (int i = 0; i < 2; i++) {
-    TrafficLane *lane = &lanes[i];
-     
-    // If the lane is RED, its vehicles are waiting.
-    unsigned long currentWait = 0;
-    if (lane->currentState == RED) {
-        currentWait = millis() - lane->startTime;
-        lane->totalWaitTime += currentWait;
+  if (binaryTelemetry) {
+    sendFrame(FRAME_CLOCK, NULL, NULL, millis());
+  } else {
+    Serial.println(F("\n--- LOG ENTRY ---"));
+
+    // Header (for easy parsing/redirection)
+    Serial.println(F("Timestamp(ms),LaneID,State,VehicleCount,CurrentGreenDuration(ms),WaitTime(ms)"));
+  }
+
+  for (int n = 0; n < NUM_INTERSECTIONS; n++) {
+    Intersection *ix = &intersections[n];
+    for (uint8_t i = 0; i < ix->laneCount; i++) {
+      TrafficLane *lane = &ix->lanes[i];
+
+      // If the lane is RED, its vehicles are waiting.
+      unsigned long currentWait = 0;
+      if (lane->currentState == RED) {
+          currentWait = millis() - lane->startTime;
+          lane->totalWaitTime += currentWait;
+      }
+
+      if (binaryTelemetry) {
+        sendFrame(FRAME_SNAPSHOT, ix, lane, lane->totalWaitTime);
+        continue;
+      }
+
+      // Log Traffic Data in CSV format
+      Serial.print(millis()); Serial.print(F(","));
+      Serial.print(lane->laneID); Serial.print(F(","));
+
+      // print State
+      if (lane->currentState == GREEN) Serial.print(F("GREEN"));
+      else if (lane->currentState == YELLOW) Serial.print(F("YELLOW"));
+      else Serial.print(F("RED"));
+      Serial.print(F(","));
+
+      Serial.print(lane->vehicleCount); Serial.print(F(","));
+      Serial.print(lane->greenDuration); Serial.print(F(","));
+      Serial.println(lane->totalWaitTime);
     }
-    
-    // Log Traffic Data in CSV format
-    Serial.print(millis()); Serial.print(F(","));
-    Serial.print(lane->laneID); Serial.print(F(","));
-    
-    // print State
-    if (lane->currentState == GREEN) Serial.print(F("GREEN"));
-    else if (lane->currentState == YELLOW) Serial.print(F("YELLOW"));
-    else Serial.print(F("RED"));
-    Serial.print(F(","));
-
-    Serial.print(lane->vehicleCount); Serial.print(F(","));
-    Serial.print(lane->greenDuration); Serial.print(F(","));
-    Serial.println(lane->totalWaitTime);
   }
-  Serial.println(F("-----------------"));
+  if (!binaryTelemetry) Serial.println(F("-----------------"));
+}
+
+// CRC-8, polynomial 0x07 (no reflection, init 0)
+static uint8_t crc8(const uint8_t *data, uint8_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t b = 0; b < 8; b++) crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+// Queue one telemetry frame. Drops the whole frame rather than block when
+// the TX ring is full.
+void sendFrame(uint8_t type, const Intersection *ix, const TrafficLane *lane, uint32_t value) {
+  if (lane == NULL) {
+    queueFrame(type, 0xFF, 0xFF, 0, 0, value);
+    return;
+  }
+  queueFrame(type, (uint8_t)(ix->id << 4 | lane->laneID), (uint8_t)(ix->currentPhase << 4 | lane->currentState),
+             lane->vehicleCount, lane->greenDuration, value);
+}
+
+void queueFrame(uint8_t type, uint8_t id, uint8_t state, uint16_t count, uint16_t duration, uint32_t value) {
+  if ((uint8_t)(txHead - txTail) > (uint8_t)(sizeof(txRing) - 1 - FRAME_SIZE)) {
+    droppedFrames++;
+    return;
+  }
+
+  unsigned long now = millis();
+  unsigned long dt = now - lastFrameTime;
+  if (dt > 0xFFFF) dt = 0xFFFF; // Readers resync on the next FRAME_CLOCK
+  lastFrameTime = now;
+
+  uint8_t f[FRAME_SIZE];
+  f[0] = FRAME_SYNC;
+  f[1] = type;
+  f[2] = dt & 0xFF;
+  f[3] = dt >> 8;
+  f[4] = id;
+  f[5] = state;
+  f[6] = count & 0xFF;
+  f[7] = count >> 8;
+  f[8] = duration & 0xFF;
+  f[9] = duration >> 8;
+  for (uint8_t i = 0; i < 4; i++) f[10 + i] = (value >> (8 * i)) & 0xFF;
+  f[14] = crc8(f, FRAME_SIZE - 1);
+
+  for (uint8_t i = 0; i < FRAME_SIZE; i++) txRing[txHead++] = f[i];
+}
+
+// Move as many queued bytes as the UART can take right now
+void flushTelemetry() {
+  int room = Serial.availableForWrite();
+  while (room-- > 0 && txTail != txHead) Serial.write(txRing[txTail++]);
+}
+
+// Text replies must not land inside a half-sent frame; commands are rare,
+// so blocking until the ring is empty here is fine
+static void drainTelemetry() {
+  while (txTail != txHead) Serial.write(txRing[txTail++]);
+}
+
+// --- PROFILER ---
+
+// Charge the time since start to a loop stage; returns the current time so
+// calls can be chained through loop()
+unsigned long profileStage(uint8_t stage, unsigned long start) {
+  unsigned long now = micros();
+  unsigned long us = now - start;
+  StageProfile *p = &stageProfile[stage];
+  p->totalUs += us;
+  if (us > p->maxUs) p->maxUs = us;
+  p->calls++;
+  return now;
+}
+
+// Count a value in its log2 bucket; counters stick at their maximum
+void histAdd(uint16_t *hist, unsigned long value) {
+  uint8_t b = 0;
+  while (value && b < HIST_BUCKETS - 1) {
+    value >>= 1;
+    b++;
+  }
+  if (hist[b] != 0xFFFF) hist[b]++;
+}
+
+static void printHist(const uint16_t *hist, const __FlashStringHelper *unit) {
+  for (uint8_t b = 0; b < HIST_BUCKETS; b++) {
+    if (hist[b] == 0) continue;
+    if (b == HIST_BUCKETS - 1) { Serial.print(F("  >= ")); Serial.print(1UL << (b - 1)); }
+    else { Serial.print(F("  < ")); Serial.print(1UL << b); }
+    Serial.print(unit); Serial.print(F(": ")); Serial.println(hist[b]);
+  }
+}
+
+// Per-stage timing and the two histograms, then start a fresh window
+void printProfile() {
+  static const char *const names[PS_COUNT] = {
+    "detect", "signals", "sensors", "log", "serial", "telemetry"
+  };
+  Serial.println(F("\n--- LOOP PROFILE ---"));
+  Serial.println(F("stage,calls,avg(us),max(us)"));
+  for (uint8_t i = 0; i < PS_COUNT; i++) {
+    StageProfile *p = &stageProfile[i];
+    Serial.print(names[i]); Serial.print(F(","));
+    Serial.print(p->calls); Serial.print(F(","));
+    Serial.print(p->calls ? p->totalUs / p->calls : 0UL); Serial.print(F(","));
+    Serial.println(p->maxUs);
+  }
+  Serial.println(F("Loop period:"));
+  printHist(loopPeriodHist, F("us"));
+  Serial.println(F("Transition lateness:"));
+  printHist(latenessHist, F("ms"));
+
+  memset(stageProfile, 0, sizeof(stageProfile));
+  memset(loopPeriodHist, 0, sizeof(loopPeriodHist));
+  memset(latenessHist, 0, sizeof(latenessHist));
+  loopStarted = false;
+}
+
+// Collect a binary frame from the upstream controller; only cycle syncs
+// are acted on. Bytes between frames are skipped, and after a bad CRC the
+// rest of the buffer is rescanned from its next sync byte.
+static void receiveFrameByte(uint8_t c) {
+  if (rxLen == 0 && c != FRAME_SYNC) return;
+  rxFrame[rxLen++] = c;
+  if (rxLen < FRAME_SIZE) return;
+  if (crc8(rxFrame, FRAME_SIZE - 1) != rxFrame[FRAME_SIZE - 1]) {
+    uint8_t i = 1;
+    while (i < FRAME_SIZE && rxFrame[i] != FRAME_SYNC) i++;
+    for (uint8_t j = i; j < FRAME_SIZE; j++) rxFrame[j - i] = rxFrame[j];
+    rxLen = FRAME_SIZE - i;
+    return;
+  }
+  rxLen = 0;
+  if (rxFrame[1] != FRAME_CYCLE_SYNC) return;
+
+  uint16_t cycle = rxFrame[8] | rxFrame[9] << 8;
+  uint16_t offset = rxFrame[10] | rxFrame[11] << 8;
+  for (int n = 0; n < NUM_INTERSECTIONS; n++)
+    if (receiveSync(&intersections[n], rxFrame[4], cycle, offset)) sendSync(&intersections[n]);
+}
+
+// A downstream corridor node's RX is the upstream board's TX: its banner,
+// command replies and CSV text would otherwise run here as commands
+static bool framedInputOnly() {
+  for (int n = 0; n < NUM_INTERSECTIONS; n++)
+    if (intersections[n].node > 0) return true;
+  return false;
 }
 
 // Serial interface for status and manual override
 void checkSerialInterface() {
   if (Serial.available() > 0) {
-    char command = Serial.read();
+    int c = Serial.read();
+    // Sync frames never start with a command letter
+    if (rxLen > 0 || c == FRAME_SYNC || framedInputOnly()) {
+      receiveFrameByte((uint8_t)c);
+      return;
+    }
+    char command = (char)c;
+    drainTelemetry();
     Serial.print(F("Command received: ")); Serial.println(command);
-    
+
     switch (command) {
       case 's': // Display Status
         Serial.println(F("\n--- SYSTEM STATUS ---"));
-        Serial.print(F("Lane A Count: ")); Serial.println(lanes[0].vehicleCount);
-        Serial.print(F("Lane B Count: ")); Serial.println(lanes[1].vehicleCount);
-        
+        for (int n = 0; n < NUM_INTERSECTIONS; n++) {
+          Intersection *ix = &intersections[n];
+          Serial.print(F("Phase: ")); Serial.println(ix->currentPhase);
+          if (ix->cycleLength) {
+            Serial.print(F("Corridor node ")); Serial.print(ix->node);
+            Serial.print(ix->synced ? F(" synced, cycle ") : F(" free, cycle ")); Serial.print(ix->cycleLength);
+            Serial.print(F(" ms, offset ")); Serial.print(ix->offset); Serial.println(F(" ms"));
+          }
+          for (uint8_t i = 0; i < ix->laneCount; i++) {
+            Serial.print(F("Lane ")); Serial.print((char)('A' + i));
+            Serial.print(F(" Count: ")); Serial.println(ix->lanes[i].vehicleCount);
+          }
+        }
+        Serial.print(F("Max detection latency (ms): ")); Serial.println(maxDetectLatency);
+        Serial.print(F("Dropped detections: ")); Serial.println(droppedEvents);
+        Serial.print(F("Dropped telemetry frames: ")); Serial.println(droppedFrames);
+        break;
+
+      case 't': // Toggle the per-transition trace
+        traceTransitions = !traceTransitions;
+        Serial.print(F("Transition trace ")); Serial.println(traceTransitions ? F("on") : F("off"));
+        break;
+
+      case 'p': // Loop profile and jitter histograms
+        printProfile();
+        break;
+
+      case 'a': // Switch between adaptive and count-formula timing
+        adaptiveTiming = !adaptiveTiming;
+        Serial.print(F("Timing ")); Serial.println(adaptiveTiming ? F("adaptive") : F("formula"));
+        break;
+
+      case 'b': // Switch between binary telemetry frames and CSV text
+        binaryTelemetry = !binaryTelemetry;
+        Serial.print(F("Telemetry ")); Serial.println(binaryTelemetry ? F("binary") : F("text"));
+        if (binaryTelemetry) sendFrame(FRAME_CLOCK, NULL, NULL, millis());
         break;
 
     }
   }
-}
\ No newline at end of file
+}
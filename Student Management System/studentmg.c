@@ -1,17 +1,30 @@
 /* student_management.c
    Readable beginner-friendly Student Management System
    Features: dynamic array, file save/load, CRUD, search by name, sort by name,
-             function pointers for menu, auto-save on changes.
+             function pointers for menu, auto-save on changes,
+             ordered grade index (skip list) for range, rank and count-below queries,
+             id hash index, parallel bulk load of large files (mmap + threads).
+   Build: gcc studentmg.c -o studentmg -pthread
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define NAME_LEN 100
 #define FILENAME_DEFAULT "students.txt"
 #define LINE_BUF 512
+#define GRADE_MAX_LEVEL 16      /* skip list levels: plenty for 4^16 students */
+#define LOAD_MAX_THREADS 64
+#define LOAD_MIN_CHUNK (256 * 1024) /* bytes per loader thread; smaller files use fewer threads */
 
 /* Student structure */
 typedef struct {
@@ -52,12 +65,404 @@ static int parse_float(const char *s, float *out) {
     return 1;
 }
 
+/* Id index: open-addressing hash (linear probing) of id -> position in the
+   students array. A slot packs the id and position + 1 into 64 bits, 0 is
+   empty, so the bulk loader's threads can claim slots with one
+   compare-and-swap each. Kept at most half full. */
+typedef struct {
+    uint64_t *slots;
+    int cap;                        /* power of two */
+    int size;
+} IdIndex;
+
+/* one index for the one student array the program works on */
+static IdIndex id_index;
+
+static uint64_t id_slot(int id, int idx) {
+    return (uint64_t)(uint32_t)id << 32 | (uint32_t)(idx + 1);
+}
+
+static int id_slot_id(uint64_t slot) { return (int)(uint32_t)(slot >> 32); }
+static int id_slot_idx(uint64_t slot) { return (int)(uint32_t)slot - 1; }
+
+static int id_hash(int id, int cap) {
+    uint32_t x = (uint32_t)id;
+    x ^= x >> 16; x *= 0x7feb352dU;
+    x ^= x >> 15; x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return (int)(x & (uint32_t)(cap - 1));
+}
+
+static void id_index_clear(void) {
+    free(id_index.slots);
+    id_index.slots = NULL;
+    id_index.cap = id_index.size = 0;
+}
+
+/* Insert or find a clash; safe from several threads at once.
+   When the id is already there, the record earlier in the array keeps the
+   slot and the later one's position is returned; otherwise -1. */
+static int id_index_claim(int id, int idx) {
+    uint64_t mine = id_slot(id, idx);
+    int mask = id_index.cap - 1;
+    for (int h = id_hash(id, id_index.cap); ; h = (h + 1) & mask) {
+        uint64_t cur = __atomic_load_n(&id_index.slots[h], __ATOMIC_ACQUIRE);
+        while (cur == 0 || id_slot_id(cur) == id) {
+            if (cur != 0 && id_slot_idx(cur) < idx) return idx;
+            if (__atomic_compare_exchange_n(&id_index.slots[h], &cur, mine, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                if (cur == 0) {
+                    __atomic_fetch_add(&id_index.size, 1, __ATOMIC_RELAXED);
+                    return -1;
+                }
+                return id_slot_idx(cur);
+            }
+            /* lost the race: cur now holds the winner, look at it again */
+        }
+    }
+}
+
+/* Make room for n ids (single-threaded); 0 on allocation failure */
+static int id_index_reserve(int n) {
+    if (id_index.slots && (long)n * 2 <= id_index.cap) return 1;
+    int cap = 16;
+    while (cap < n * 2) cap *= 2;
+    uint64_t *old = id_index.slots;
+    int old_cap = id_index.cap;
+    id_index.slots = calloc((size_t)cap, sizeof(uint64_t));
+    if (!id_index.slots) {
+        id_index.slots = old;
+        printf("Error: memory allocation failed.\n");
+        return 0;
+    }
+    id_index.cap = cap;
+    id_index.size = 0;
+    for (int i = 0; i < old_cap; ++i) {
+        if (old[i]) id_index_claim(id_slot_id(old[i]), id_slot_idx(old[i]));
+    }
+    free(old);
+    return 1;
+}
+
+static void id_index_insert(int id, int idx) {
+    if (id_index_reserve(id_index.size + 1)) id_index_claim(id, idx);
+}
+
+/* Position of id, or -1 */
+static int id_index_find(int id) {
+    if (!id_index.slots) return -1;
+    int mask = id_index.cap - 1;
+    for (int h = id_hash(id, id_index.cap); id_index.slots[h]; h = (h + 1) & mask) {
+        if (id_slot_id(id_index.slots[h]) == id) return id_slot_idx(id_index.slots[h]);
+    }
+    return -1;
+}
+
+/* Remove id; later slots of the same probe run move back into the gap */
+static void id_index_remove(int id) {
+    if (!id_index.slots) return;
+    int mask = id_index.cap - 1;
+    int h = id_hash(id, id_index.cap);
+    while (id_index.slots[h] && id_slot_id(id_index.slots[h]) != id) h = (h + 1) & mask;
+    if (!id_index.slots[h]) return;
+
+    int gap = h;
+    for (int j = (gap + 1) & mask; id_index.slots[j]; j = (j + 1) & mask) {
+        int home = id_hash(id_slot_id(id_index.slots[j]), id_index.cap);
+        /* move it back unless its home lies cyclically in (gap, j] */
+        if (((j - home) & mask) >= ((j - gap) & mask)) {
+            id_index.slots[gap] = id_index.slots[j];
+            gap = j;
+        }
+    }
+    id_index.slots[gap] = 0;
+    id_index.size--;
+}
+
+/* Point id at a new position (its student moved in the array) */
+static void id_index_move(int id, int idx) {
+    if (!id_index.slots) return;
+    int mask = id_index.cap - 1;
+    for (int h = id_hash(id, id_index.cap); id_index.slots[h]; h = (h + 1) & mask) {
+        if (id_slot_id(id_index.slots[h]) == id) {
+            id_index.slots[h] = id_slot(id, idx);
+            return;
+        }
+    }
+}
+
+static void id_index_rebuild(const Student *students, int count) {
+    id_index_clear();
+    if (!id_index_reserve(count)) return;
+    for (int i = 0; i < count; ++i) id_index_claim(students[i].id, i);
+}
+
 /* Find student index by ID; return -1 if not found */
 static int find_by_id(const Student *arr, int n, int id) {
-    for (int i = 0; i < n; ++i) {
-        if (arr[i].id == id) return i;
+    if (!id_index.slots) {
+        /* no index (allocation failed): scan */
+        for (int i = 0; i < n; ++i) {
+            if (arr[i].id == id) return i;
+        }
+        return -1;
     }
-    return -1;
+    int idx = id_index_find(id);
+    return idx >= 0 && idx < n && arr[idx].id == id ? idx : -1;
+}
+
+/* Grade index: skip list ordered by (grade, id).
+   Each link also stores its span (how many students it jumps over), so the
+   position of a grade is summed on the way down: range scans are
+   O(log n + k), rank and count-below are O(log n).
+   Nodes keep the student's id rather than its array position, so removing
+   a student never touches the other nodes; range results find their
+   student through the id index. */
+typedef struct GradeNode {
+    float grade;
+    int id;
+    struct {
+        struct GradeNode *next;
+        int span;
+    } link[];                       // one per level of this node
+} GradeNode;
+
+typedef struct {
+    GradeNode *head;                // sentinel with GRADE_MAX_LEVEL links
+    int level;
+    int size;
+} GradeIndex;
+
+/* one index for the one student array the program works on */
+static GradeIndex grade_index;
+
+/* Helper: node comes before (grade, id) in index order */
+static int grade_before(const GradeNode *x, float grade, int id) {
+    return x->grade < grade || (x->grade == grade && x->id < id);
+}
+
+/* Helper: level for a new node, each level a quarter as likely as the last */
+static int grade_random_level(void) {
+    int level = 1;
+    while (level < GRADE_MAX_LEVEL && (rand() & 3) == 0) level++;
+    return level;
+}
+
+static GradeNode *grade_node_new(int level) {
+    GradeNode *x = calloc(1, sizeof(GradeNode) + level * sizeof(x->link[0]));
+    if (!x) printf("Error: memory allocation failed.\n");
+    return x;
+}
+
+/* Remove every node (keeps the sentinel) */
+static void grade_index_clear(void) {
+    GradeIndex *gi = &grade_index;
+    if (!gi->head) {
+        gi->head = grade_node_new(GRADE_MAX_LEVEL);
+        if (!gi->head) return;
+    }
+    GradeNode *x = gi->head->link[0].next;
+    while (x) {
+        GradeNode *next = x->link[0].next;
+        free(x);
+        x = next;
+    }
+    memset(gi->head->link, 0, GRADE_MAX_LEVEL * sizeof(gi->head->link[0]));
+    gi->level = 1;
+    gi->size = 0;
+}
+
+static void grade_index_insert(float grade, int id) {
+    GradeIndex *gi = &grade_index;
+    if (!gi->head) grade_index_clear();
+    if (!gi->head) return;
+
+    GradeNode *update[GRADE_MAX_LEVEL];
+    int rank[GRADE_MAX_LEVEL];          /* position of update[i] */
+    GradeNode *x = gi->head;
+    for (int i = gi->level - 1; i >= 0; --i) {
+        rank[i] = i == gi->level - 1 ? 0 : rank[i+1];
+        while (x->link[i].next && grade_before(x->link[i].next, grade, id)) {
+            rank[i] += x->link[i].span;
+            x = x->link[i].next;
+        }
+        update[i] = x;
+    }
+
+    int level = grade_random_level();
+    if (level > gi->level) {
+        for (int i = gi->level; i < level; ++i) {
+            rank[i] = 0;
+            update[i] = gi->head;
+            update[i]->link[i].span = gi->size;
+        }
+        gi->level = level;
+    }
+
+    x = grade_node_new(level);
+    if (!x) return;
+    x->grade = grade;
+    x->id = id;
+    for (int i = 0; i < level; ++i) {
+        x->link[i].next = update[i]->link[i].next;
+        update[i]->link[i].next = x;
+        x->link[i].span = update[i]->link[i].span - (rank[0] - rank[i]);
+        update[i]->link[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (int i = level; i < gi->level; ++i) {
+        update[i]->link[i].span++;
+    }
+    gi->size++;
+}
+
+static void grade_index_remove(float grade, int id) {
+    GradeIndex *gi = &grade_index;
+    if (!gi->head) return;
+
+    GradeNode *update[GRADE_MAX_LEVEL];
+    GradeNode *x = gi->head;
+    for (int i = gi->level - 1; i >= 0; --i) {
+        while (x->link[i].next && grade_before(x->link[i].next, grade, id)) x = x->link[i].next;
+        update[i] = x;
+    }
+    x = x->link[0].next;
+    if (!x || x->grade != grade || x->id != id) return;
+
+    for (int i = 0; i < gi->level; ++i) {
+        if (update[i]->link[i].next == x) {
+            update[i]->link[i].span += x->link[i].span - 1;
+            update[i]->link[i].next = x->link[i].next;
+        } else {
+            update[i]->link[i].span--;
+        }
+    }
+    while (gi->level > 1 && !gi->head->link[gi->level - 1].next) gi->level--;
+    gi->size--;
+    free(x);
+}
+
+/* Rebuild from the array (when there is no memory to build it in bulk) */
+static void grade_index_rebuild(const Student *students, int count) {
+    grade_index_clear();
+    for (int i = 0; i < count; ++i) {
+        grade_index_insert(students[i].grade, students[i].id);
+    }
+}
+
+/* (grade, id) of one student, for building the index in bulk */
+typedef struct {
+    float grade;
+    int id;
+} GradeKey;
+
+static int grade_key_cmp(const void *a, const void *b) {
+    const GradeKey *x = a, *y = b;
+    if (x->grade != y->grade) return x->grade < y->grade ? -1 : 1;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+static int grade_key_before(const GradeKey *x, const GradeKey *y) {
+    return x->grade < y->grade || (x->grade == y->grade && x->id < y->id);
+}
+
+/* Build from runs of keys each already in (grade, id) order.
+   The runs are merged with a small heap and every node is appended at the
+   tail of its levels, so there is no search per student: O(n log runs). */
+static void grade_index_build(GradeKey **runs, const int *lens, int nruns) {
+    grade_index_clear();
+    GradeIndex *gi = &grade_index;
+    if (!gi->head) return;
+
+    int heap[LOAD_MAX_THREADS], pos[LOAD_MAX_THREADS], n = 0;
+    for (int r = 0; r < nruns && r < LOAD_MAX_THREADS; ++r) {
+        if (lens[r] == 0) continue;
+        pos[r] = 0;
+        int i = n++;
+        while (i > 0 && grade_key_before(&runs[r][0], &runs[heap[(i-1)/2]][pos[heap[(i-1)/2]]])) {
+            heap[i] = heap[(i-1)/2];
+            i = (i-1)/2;
+        }
+        heap[i] = r;
+    }
+
+    GradeNode *last[GRADE_MAX_LEVEL];
+    int last_rank[GRADE_MAX_LEVEL];
+    for (int i = 0; i < GRADE_MAX_LEVEL; ++i) {
+        last[i] = gi->head;
+        last_rank[i] = 0;
+    }
+    while (n > 0) {
+        int r = heap[0];
+        const GradeKey *k = &runs[r][pos[r]++];
+        int level = grade_random_level();
+        GradeNode *x = grade_node_new(level);
+        if (!x) break;
+        x->grade = k->grade;
+        x->id = k->id;
+        int rank = ++gi->size;
+        for (int i = 0; i < level; ++i) {
+            last[i]->link[i].next = x;
+            last[i]->link[i].span = rank - last_rank[i];
+            last[i] = x;
+            last_rank[i] = rank;
+        }
+        if (level > gi->level) gi->level = level;
+
+        /* next key of run r, or drop the run, then restore the heap */
+        int top = pos[r] < lens[r] ? r : heap[--n];
+        int i = 0;
+        for (;;) {
+            int c = 2*i + 1;
+            if (c >= n) break;
+            if (c + 1 < n && grade_key_before(&runs[heap[c+1]][pos[heap[c+1]]], &runs[heap[c]][pos[heap[c]]])) c++;
+            if (!grade_key_before(&runs[heap[c]][pos[heap[c]]], &runs[top][pos[top]])) break;
+            heap[i] = heap[c];
+            i = c;
+        }
+        if (n > 0) heap[i] = top;
+    }
+    /* a link without a next node spans the students after it */
+    for (int i = 0; i < gi->level; ++i) last[i]->link[i].span = gi->size - last_rank[i];
+}
+
+/* Number of students ordered before (grade, id); O(log n) */
+static int grade_index_count_before(float grade, int id) {
+    GradeIndex *gi = &grade_index;
+    if (!gi->head) return 0;
+    int rank = 0;
+    GradeNode *x = gi->head;
+    for (int i = gi->level - 1; i >= 0; --i) {
+        while (x->link[i].next && grade_before(x->link[i].next, grade, id)) {
+            rank += x->link[i].span;
+            x = x->link[i].next;
+        }
+    }
+    return rank;
+}
+
+/* Number of students with a grade at or below grade, whatever their id; O(log n) */
+static int grade_index_count_at_most(float grade) {
+    GradeIndex *gi = &grade_index;
+    if (!gi->head) return 0;
+    int rank = 0;
+    GradeNode *x = gi->head;
+    for (int i = gi->level - 1; i >= 0; --i) {
+        while (x->link[i].next && x->link[i].next->grade <= grade) {
+            rank += x->link[i].span;
+            x = x->link[i].next;
+        }
+    }
+    return rank;
+}
+
+/* First student with grade >= lo; O(log n) */
+static GradeNode *grade_index_lower_bound(float lo) {
+    GradeIndex *gi = &grade_index;
+    if (!gi->head) return NULL;
+    GradeNode *x = gi->head;
+    for (int i = gi->level - 1; i >= 0; --i) {
+        while (x->link[i].next && grade_before(x->link[i].next, lo, INT_MIN)) x = x->link[i].next;
+    }
+    return x->link[0].next;
 }
 
 /* Resize student array to newSize; returns new pointer (or old pointer on failure) */
@@ -90,54 +495,249 @@ static int save_to_file(const Student *students, int n, const char *filename) {
     return 1;
 }
 
+/* Bulk load.
+   The file is mapped and cut into one chunk per thread at line breaks.
+   Each thread parses its lines into its own growing buffer; then, at the
+   prefix-sum offsets, each copies its records into the final array, claims
+   their ids in the id index (duplicates across chunks meet in the same
+   slot) and sorts its (grade, id) keys. The sorted runs are merged into
+   the grade index in one pass. */
+
+/* 0 = one thread per CPU (the benchmarks set it to measure scaling) */
+static int load_thread_limit = 0;
+
+typedef struct {
+    const char *begin, *end;        /* whole lines of the mapped file */
+    Student *recs;                  /* parsed records, in file order */
+    int count, cap;
+    int offset;                     /* position of recs[0] in the final array */
+    Student *out;
+    unsigned char *dup;             /* per final position: id seen earlier */
+    GradeKey *keys;
+    int failed;
+} LoadChunk;
+
+/* Parse one id|name|grade line the way the menu's loader always has */
+static int parse_record(const char *line, size_t len, Student *st) {
+    char buf[LINE_BUF];
+    if (len >= LINE_BUF) len = LINE_BUF - 1;
+    memcpy(buf, line, len);
+    buf[len] = '\0';
+
+    char *save = NULL;
+    char *p = strtok_r(buf, "|", &save);
+    if (!p) return 0;
+    st->id = atoi(p);
+    p = strtok_r(NULL, "|", &save);
+    if (!p) return 0;
+    strncpy(st->name, p, NAME_LEN);
+    st->name[NAME_LEN-1] = '\0';
+    p = strtok_r(NULL, "|", &save);
+    if (!p) return 0;
+    st->grade = (float)atof(p);
+    return 1;
+}
+
+static void *load_parse(void *arg) {
+    LoadChunk *c = arg;
+    const char *p = c->begin;
+    while (p < c->end) {
+        const char *nl = memchr(p, '\n', (size_t)(c->end - p));
+        const char *eol = nl ? nl : c->end;
+        if (c->count == c->cap) {
+            int cap = c->cap ? c->cap * 2 : 1024;
+            Student *tmp = realloc(c->recs, (size_t)cap * sizeof(Student));
+            if (!tmp) {
+                c->failed = 1;
+                return NULL;
+            }
+            c->recs = tmp;
+            c->cap = cap;
+        }
+        if (parse_record(p, (size_t)(eol - p), &c->recs[c->count])) c->count++;
+        p = eol + 1;
+    }
+    return NULL;
+}
+
+static void *load_place(void *arg) {
+    LoadChunk *c = arg;
+    if (c->count == 0) return NULL;
+    memcpy(c->out + c->offset, c->recs, (size_t)c->count * sizeof(Student));
+    free(c->recs);
+    c->recs = NULL;
+
+    c->keys = malloc((size_t)c->count * sizeof(GradeKey));
+    if (!c->keys) c->failed = 1;
+    for (int i = 0; i < c->count; ++i) {
+        int idx = c->offset + i;
+        int loser = id_index_claim(c->out[idx].id, idx);
+        if (loser >= 0) c->dup[loser] = 1;
+        if (c->keys) {
+            c->keys[i].grade = c->out[idx].grade;
+            c->keys[i].id = c->out[idx].id;
+        }
+    }
+    if (c->keys) qsort(c->keys, (size_t)c->count, sizeof(GradeKey), grade_key_cmp);
+    return NULL;
+}
+
+/* Runs fn over the chunks, one thread each (the first on this thread) */
+static void load_run(void *(*fn)(void *), LoadChunk *chunks, int nthreads) {
+    pthread_t tids[LOAD_MAX_THREADS];
+    int started[LOAD_MAX_THREADS] = {0};
+    for (int t = 1; t < nthreads; ++t) {
+        started[t] = pthread_create(&tids[t], NULL, fn, &chunks[t]) == 0;
+        if (!started[t]) fn(&chunks[t]);
+    }
+    fn(&chunks[0]);
+    for (int t = 1; t < nthreads; ++t) {
+        if (started[t]) pthread_join(tids[t], NULL);
+    }
+}
+
+static int load_threads(size_t size) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n = load_thread_limit > 0 ? load_thread_limit : (cpus > 0 ? (int)cpus : 1);
+    if (n > LOAD_MAX_THREADS) n = LOAD_MAX_THREADS;
+    size_t by_size = size / LOAD_MIN_CHUNK + 1;
+    if ((size_t)n > by_size) n = (int)by_size;
+    return n;
+}
+
+/* Records that reuse the id of an earlier record (a hand-edited file).
+   They stay in the array and are saved with the rest; the indexes hold the
+   first record of each id, the one find, update, delete and rank act on. */
+static int shadowed_count = 0;
+
+/* Rebuild both indexes from the array, first record of each id only */
+static void indexes_rebuild(const Student *students, int count) {
+    id_index_rebuild(students, count);
+    shadowed_count = 0;
+    GradeKey *keys = malloc((size_t)(count ? count : 1) * sizeof(GradeKey));
+    if (!keys) {
+        grade_index_rebuild(students, count);
+        return;
+    }
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        if (id_index.slots && id_index_find(students[i].id) != i) {
+            shadowed_count++;
+            continue;
+        }
+        keys[n].grade = students[i].grade;
+        keys[n].id = students[i].id;
+        n++;
+    }
+    qsort(keys, (size_t)n, sizeof(GradeKey), grade_key_cmp);
+    grade_index_build(&keys, &n, 1);
+    free(keys);
+}
+
 /* Load students from file saved with save_to_file; returns new array pointer and updates count */
 static Student *load_from_file(Student *students, int *count, const char *filename) {
-    FILE *f = fopen(filename, "r");
-    if (!f) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         /* Not an error if file missing on startup; caller can decide */
         return students;
     }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return students;
+    }
 
     /* free existing array */
-    for (int i = 0; i < *count; ++i) { /* nothing to free inside Student here */ }
     free(students);
     students = NULL;
     *count = 0;
+    grade_index_clear();
+    id_index_clear();
+    shadowed_count = 0;
 
-    char line[LINE_BUF];
-    while (fgets(line, LINE_BUF, f)) {
-        trim_newline(line);
-        /* parse id|name|grade */
-        char *p = strtok(line, "|");
-        if (!p) continue;
-        int id = atoi(p);
-
-        p = strtok(NULL, "|");
-        if (!p) continue;
-        char namebuf[NAME_LEN];
-        strncpy(namebuf, p, NAME_LEN);
-        namebuf[NAME_LEN-1] = '\0';
-
-        p = strtok(NULL, "|");
-        if (!p) continue;
-        float grade = (float)atof(p);
-
-        /* append to array */
-        int newSize = *count + 1;
-        Student *tmp = realloc(students, newSize * sizeof(Student));
-        if (!tmp) {
-            printf("Error: memory allocation failed while loading.\n");
-            fclose(f);
-            return students;
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return NULL;
+    }
+    const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Error: cannot read '%s'.\n", filename);
+        return NULL;
+    }
+    madvise((void *)data, size, MADV_SEQUENTIAL);
+
+    /* chunk t starts after the first line break at or past t/n of the file */
+    int nthreads = load_threads(size);
+    LoadChunk chunks[LOAD_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    const char *end = data + size, *p = data;
+    for (int t = 0; t < nthreads; ++t) {
+        chunks[t].begin = p;
+        const char *cut = t == nthreads - 1 ? end : data + size / (size_t)nthreads * (size_t)(t + 1);
+        if (cut < p) cut = p;
+        if (cut < end) {
+            const char *nl = memchr(cut, '\n', (size_t)(end - cut));
+            cut = nl ? nl + 1 : end;
         }
-        students = tmp;
-        students[*count].id = id;
-        strncpy(students[*count].name, namebuf, NAME_LEN);
-        students[*count].name[NAME_LEN-1] = '\0';
-        students[*count].grade = grade;
-        *count = newSize;
+        chunks[t].end = p = cut;
     }
-    fclose(f);
+    load_run(load_parse, chunks, nthreads);
+
+    long total = 0;
+    int failed = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        chunks[t].offset = (int)total;
+        total += chunks[t].count;
+        failed |= chunks[t].failed;
+    }
+    unsigned char *dup = NULL;
+    if (!failed && total > INT_MAX / 2) failed = 1;
+    if (!failed && total > 0) {
+        students = malloc((size_t)total * sizeof(Student));
+        dup = calloc((size_t)total, 1);
+        if (!students || !dup || !id_index_reserve((int)total)) failed = 1;
+    }
+    if (!failed && total > 0) {
+        for (int t = 0; t < nthreads; ++t) {
+            chunks[t].out = students;
+            chunks[t].dup = dup;
+        }
+        load_run(load_place, chunks, nthreads);
+    }
+
+    GradeKey *runs[LOAD_MAX_THREADS];
+    int lens[LOAD_MAX_THREADS];
+    for (int t = 0; t < nthreads; ++t) {
+        failed |= chunks[t].failed;
+        runs[t] = chunks[t].keys;
+        lens[t] = chunks[t].count;
+    }
+    if (failed) {
+        printf("Error: memory allocation failed while loading.\n");
+        free(students);
+        students = NULL;
+        id_index_clear();
+    } else if (total > 0) {
+        *count = (int)total;
+        int ndup = 0;
+        for (long i = 0; i < total; ++i) ndup += dup[i];
+        if (ndup > 0) {
+            indexes_rebuild(students, *count);
+            printf("Warning: %d record(s) reuse an id from earlier in the file. They are kept,\n"
+                   "but only the first record of each id can be found, updated or ranked.\n", ndup);
+        } else {
+            grade_index_build(runs, lens, nthreads);
+        }
+    }
+
+    for (int t = 0; t < nthreads; ++t) {
+        free(chunks[t].recs);
+        free(chunks[t].keys);
+    }
+    free(dup);
+    munmap((void *)data, size);
     return students;
 }
 
@@ -200,6 +800,8 @@ static Student *add_student(Student *students, int *count) {
     strncpy(students[*count].name, name, NAME_LEN);
     students[*count].name[NAME_LEN-1] = '\0';
     students[*count].grade = grade;
+    grade_index_insert(grade, id);
+    id_index_insert(id, *count);
 
     *count = newSize;
 
@@ -258,7 +860,9 @@ static void update_student(Student *students, int count) {
         if (!parse_float(buf, &g) || g < 0.0f || g > 100.0f) {
             printf("Invalid grade, keeping old value.\n");
         } else {
+            grade_index_remove(students[idx].grade, students[idx].id);
             students[idx].grade = g;
+            grade_index_insert(g, students[idx].id);
         }
     }
 
@@ -284,10 +888,16 @@ static Student *delete_student(Student *students, int *count) {
     int idx = find_by_id(students, *count, id);
     if (idx == -1) { printf("Student not found.\n"); return students; }
 
-    /* shift left */
+    grade_index_remove(students[idx].grade, students[idx].id);
+    id_index_remove(id);
+
+    /* shift left; only the students that moved get a new id index entry */
     for (int i = idx; i < *count - 1; ++i) {
         students[i] = students[i+1];
+        id_index_move(students[i].id, i);
     }
+    /* a later record with the same id takes over the deleted one's place */
+    if (shadowed_count > 0) indexes_rebuild(students, *count - 1);
 
     int newSize = *count - 1;
     if (newSize == 0) {
@@ -357,11 +967,78 @@ static void sort_by_name(Student *students, int count) {
             }
         }
     }
+    /* positions changed: the id index points at array slots; with duplicate
+       ids another record may now come first, so the grade index changes too */
+    if (shadowed_count > 0) indexes_rebuild(students, count);
+    else id_index_rebuild(students, count);
+
     /* autosave after changing order */
     autosave_if_needed(students, count);
     printf("Sorted by name.\n");
 }
 
+/* Students with lo <= grade <= hi, lowest grade first */
+static void grade_range(const Student *students, int count) {
+    if (count == 0) { printf("No students.\n"); return; }
+
+    char buf[LINE_BUF];
+    float lo, hi;
+    printf("Enter lowest grade: ");
+    if (!read_line(buf, LINE_BUF)) return;
+    if (!parse_float(buf, &lo)) { printf("Invalid grade.\n"); return; }
+    printf("Enter highest grade: ");
+    if (!read_line(buf, LINE_BUF)) return;
+    if (!parse_float(buf, &hi)) { printf("Invalid grade.\n"); return; }
+
+    int found = 0;
+    for (GradeNode *x = grade_index_lower_bound(lo); x && x->grade <= hi; x = x->link[0].next) {
+        int idx = find_by_id(students, count, x->id);
+        if (idx < 0) continue;
+        const Student *st = &students[idx];
+        printf("ID:%d | Name:%s | Grade: %.2f\n", st->id, st->name, st->grade);
+        found++;
+    }
+    if (!found) printf("No students in that range.\n");
+    else printf("%d student(s) between %.2f and %.2f.\n", found, lo, hi);
+}
+
+/* How many students are below a pass mark */
+static void count_below(const Student *students, int count) {
+    (void)students;
+    if (count == 0) { printf("No students.\n"); return; }
+
+    char buf[LINE_BUF];
+    float mark;
+    printf("Enter pass mark: ");
+    if (!read_line(buf, LINE_BUF)) return;
+    if (!parse_float(buf, &mark)) { printf("Invalid grade.\n"); return; }
+
+    /* the index holds one record per id */
+    int total = grade_index.size;
+    int below = grade_index_count_before(mark, INT_MIN);
+    printf("%d of %d student(s) below %.2f (%.1f%%).\n", below, total, mark,
+           total > 0 ? 100.0f * below / total : 0.0f);
+}
+
+/* Rank of a student by grade: 1 is the highest, equal grades share a rank */
+static void grade_rank(const Student *students, int count) {
+    if (count == 0) { printf("No students.\n"); return; }
+
+    char buf[LINE_BUF];
+    printf("Enter ID of student: ");
+    if (!read_line(buf, LINE_BUF)) return;
+    int id;
+    if (!parse_int(buf, &id)) { printf("Invalid ID.\n"); return; }
+
+    int idx = find_by_id(students, count, id);
+    if (idx == -1) { printf("Student not found.\n"); return; }
+
+    /* students with a higher grade = all minus those at or below it */
+    int total = grade_index.size;
+    int rank = total - grade_index_count_at_most(students[idx].grade) + 1;
+    printf("%s is ranked %d of %d (grade %.2f).\n", students[idx].name, rank, total, students[idx].grade);
+}
+
 /* Manual save (ask filename) */
 static void manual_save(const Student *students, int count) {
     char fname[LINE_BUF];
@@ -425,6 +1102,24 @@ static void menu_sort(Student **students_ptr, int *count_ptr) {
     sort_by_name(*students_ptr, *count_ptr);
 }
 
+/* wrapper for grade range */
+static void menu_range(Student **students_ptr, int *count_ptr) {
+    (void)students_ptr;
+    grade_range(*students_ptr, *count_ptr);
+}
+
+/* wrapper for count below */
+static void menu_below(Student **students_ptr, int *count_ptr) {
+    (void)students_ptr;
+    count_below(*students_ptr, *count_ptr);
+}
+
+/* wrapper for rank */
+static void menu_rank(Student **students_ptr, int *count_ptr) {
+    (void)students_ptr;
+    grade_rank(*students_ptr, *count_ptr);
+}
+
 /* wrapper for manual save */
 static void menu_save(Student **students_ptr, int *count_ptr) {
     (void)students_ptr;
@@ -447,7 +1142,7 @@ int main(void) {
         printf("Loaded %d records from %s on start.\n", count, FILENAME_DEFAULT);
     }
 
-    /* prepare menu actions (1..9 mapped to array indexes 0..8) */
+    /* prepare menu actions (1..11 mapped to array indexes 0..10) */
     MenuAction actions[] = {
         menu_add,      /* 1 */
         menu_delete,   /* 2 */
@@ -456,7 +1151,10 @@ int main(void) {
         menu_search,   /* 5 */
         menu_sort,     /* 6 */
         menu_save,     /* 7 */
-        menu_load      /* 8 */
+        menu_load,     /* 8 */
+        menu_range,    /* 9 */
+        menu_below,    /* 10 */
+        menu_rank      /* 11 */
     };
     const int ACTION_COUNT = (int)(sizeof(actions) / sizeof(actions[0]));
 
@@ -472,7 +1170,10 @@ int main(void) {
         printf("6 Sort by name\n");        /* sort + autosave */
         printf("7 Save to file (manual)\n");
         printf("8 Load from file (manual)\n");
-        printf("9 Exit\n");
+        printf("9 Students in grade range\n");
+        printf("10 Count below pass mark\n");
+        printf("11 Rank of student\n");
+        printf("12 Exit\n");
         printf("Choice: ");
 
         if (!read_line(line, LINE_BUF)) break;
@@ -492,7 +1193,7 @@ int main(void) {
             continue;
         }
 
-        if (choice == 9) {
+        if (choice == 12) {
             printf("Exiting program.\n");
             break;
         }
@@ -503,6 +1204,9 @@ int main(void) {
     /* final save before exit */
     autosave_if_needed(students, count);
 
+    grade_index_clear();
+    free(grade_index.head);
+    id_index_clear();
     free(students);
     return 0;
 }